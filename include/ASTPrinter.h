@@ -589,6 +589,13 @@ void printAST(ck_ast::ASTNode *localroot) { // XXX: how to save line numbers?
 			}
 			break;
 			
+		case ck_token::SYNCHRONIZED:
+			wprintf(L"synchronized ( ");
+			printAST(localroot->left);
+			wprintf(L") ");
+			printAST(localroot->left->next);
+			break;
+			
 		case ck_token::IN:
 			std::wcout << *(std::wstring*) localroot->objectlist->object << " in ";
 			printAST(localroot->left);
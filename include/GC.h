@@ -3,13 +3,81 @@
 #include <thread>
 #include <mutex>
 #include <atomic>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstdint>
 
 namespace ck_core {		
+	class GC;
+	class gc_object;
+	
+	/*
+	 * Interpreter starts in single-threaded mode and switches to multithreaded 
+	 *  mode on the first GIL::spawn_thread call. Never switches back.
+	 * While single-threaded, object locks, GC locks and GIL synchronization are skipped.
+	 */
+	extern std::atomic<bool> multithreaded;
+	
+	inline bool is_multithreaded() { 
+		return multithreaded.load(std::memory_order_relaxed); 
+	};
+	
+	/*
+	 * Visitor passed to gc_object::gc_trace.
+	 * Receives every reference held by traced object.
+	 */
+	class gc_visitor {
+		
+	public:
+		
+		virtual ~gc_visitor() {};
+		
+		// Called for each object referenced by the traced object. Accepts nullptr.
+		virtual void visit(gc_object *o) = 0;
+	};
+	
+	/*
+	 * Explicit mark stack used by GC::collect.
+	 * Replaces recursive marking, so depth of object graph (aka linked list 
+	 *  with very large size) does not depend on size of native stack.
+	 */
+	class gc_mark_stack : public gc_visitor {
+		
+		std::vector<gc_object*> stack;
+		
+		// Amount of objects marked by this stack
+		int64_t marked = 0;
+		
+	public:
+		
+		// Marks object as reachable and pushes it to be traced later.
+		void visit(gc_object *o);
+		
+		// Returns amount of objects marked by this stack
+		inline int64_t marked_count() { return marked; };
+		
+		// Pops and traces objects until stack is empty.
+		void drain();
+		
+		// Releases memory of stack if it has grown too large.
+		void shrink();
+	};
+	
+	/*
+	 * Amount and size of objects of single type, see GC::census().
+	 */
+	struct gc_census_entry {
+		std::string type;
+		int64_t     count = 0;
+		int64_t     bytes = 0;
+	};
+	
 	/*
 	 * Garbage collector object, tracked at creation.
+	 * Header of the object is one pointer to the next object in GC list 
+	 *  and one word containing GC flags and size of the object.
 	 */
-	class GC;
-	class gc_list;
 	class gc_object {
 	
 	public: // WARNING: put destructor and constructor in PUBLIC section
@@ -20,8 +88,9 @@ namespace ck_core {
 		
 		// Let's look like it is private
 		//  Else that's not my problem if you delete it from somewhere.
-		void operator delete(void* ptr);
-		// void operator delete(void* ptr, std::size_t size);
+		// Sized version receives size of the most derived object, so it does 
+		//  not depend on header that can be zeroed by value-initialization of bases.
+		void operator delete(void* ptr, std::size_t size);
 		
 		gc_object();
 		
@@ -35,64 +104,100 @@ namespace ck_core {
 		
 		virtual ~gc_object();
 		
-		// Called when GC indexes all reachable objects
-		virtual void gc_mark();
+		// Called when GC indexes all reachable objects.
+		// Should pass each referenced object to visitor.visit() and must not recurse.
+		virtual void gc_trace(gc_visitor &visitor);
 		
 		// Called when GC destroyes current object
 		virtual void gc_finalize();
 		
+		// Called for reachable weak holders (see GC::attach_weak) after marking.
+		// Should visit objects that are kept alive by reachable weak keys.
+		// Repeated until no new objects are marked.
+		virtual void gc_trace_weak(gc_visitor &visitor);
+		
+		// Called for reachable weak holders before sweep.
+		// Should drop references to objects that are not reachable.
+		virtual void gc_clear_weak();
+		
 		// Mark current object as reachable
-		inline void gc_reach() { gc_reachable = 1; };
+		inline void gc_reach() { gc_header |= GC_REACHABLE; };
 		
 		// Indicates if obejcts is reachable and can not be collected.
-		bool gc_reachable = 0;
+		inline bool gc_is_reachable() { return gc_header & GC_REACHABLE; };
 		
 		// Returns size of current object requred on malloc.
-		inline size_t get_size() { return self_size; };
+		inline size_t get_size() { return gc_header >> GC_SIZE_SHIFT; };
 		
 		// Retuns 1 if object is GC root
-		inline bool gc_is_root() { return gc_root; };
+		inline bool gc_is_root() { return gc_header & GC_ROOT; };
 		
 		// Retuns 1 if object is GC lock
-		inline bool gc_is_lock() { return gc_lock; };
+		inline bool gc_is_lock() { return gc_header & GC_LOCK; };
 		
 	private:
 	
 		// Allow access only from GC class.
 		friend class GC;
 		
-		// Set to 1 if object is being recorded
-		bool gc_record;
-		// Set to 1 if object is GC root
-		bool   gc_root;
-		// Set to 1 if object is locked (like root, but not root, okay?)
-		bool   gc_lock;
-		
-		// Pointer to alignation in current GC chain
-		gc_list *gc_chain;
-		// Pointer to alignation to current GC lock
-		gc_list *gc_lock_chain;
-		// Pointer to alignation to current GC root
-		gc_list *gc_root_chain;
-		
-		// Allow derived to know, how much it contains
-		std::size_t self_size;
+		enum : uint64_t {
+			// Object is reachable in current collection
+			GC_REACHABLE   = 1 << 0,
+			// Object is being recorded
+			GC_RECORD      = 1 << 1,
+			// Object is GC root
+			GC_ROOT        = 1 << 2,
+			// Object is locked (like root, but not root, okay?)
+			GC_LOCK        = 1 << 3,
+			// Object is present in list of roots / locks, 
+			//  cleared when list is compacted after unroot / unlock.
+			GC_ROOT_LISTED = 1 << 4,
+			GC_LOCK_LISTED = 1 << 5,
+			
+			// Size is stored above flags
+			GC_SIZE_SHIFT  = 8,
+			GC_FLAGS_MASK  = (1 << GC_SIZE_SHIFT) - 1
+		};
+		
+		// Sizes of allocated objects passed from operator new to constructor.
+		// Arguments of constructor may allocate objects too, so it is a stack 
+		//  and constructor takes the entry only if it was pushed for this object.
+		static thread_local std::vector<std::pair<void*, std::size_t>> allocated_sizes;
+		
+		// Next object in GC list or list of thread allocation state
+		gc_object *gc_next;
+		
+		// Flags in low byte, size of object in the rest
+		uint64_t gc_header;
 	};
 	
 	/*
-	 * Garbage collector chain.
+	 * Per-thread allocation state.
+	 * Objects created by the owning thread are pushed into local list 
+	 *  without taking GC::protect_lock and moved into the global list
+	 *  on the next collection or when thread finishes.
 	 */
-	class gc_list {
+	class gc_thread_state {
 	
-	public:
+		friend class GC;
+		friend class gc_handle_scope;
+		template<typename T> friend class gc_local;
+		
+		// Objects created by this thread since last collection, linked by gc_next.
+		// Pushed only by owning thread, taken entirely by collector.
+		std::atomic<gc_object*> objects;
+		
+		// Amount of objects in list
+		std::atomic<int32_t> size;
 	
-		gc_list  *next;
-		gc_object *obj;
+		// Stack of handles of this thread. Every object in it is treated as root.
+		// Modified only by owning thread, read by collector during stop-the-world.
+		std::vector<gc_object*> handles;
 		
-		// For stupid users, that decide to GC by themself even after delete is forbidden.
-		bool deleted_ptr;
+	public:
 		
-		gc_list();
+		gc_thread_state();
+		~gc_thread_state();
 	};
 
 	/*
@@ -107,13 +212,42 @@ namespace ck_core {
 		// Protects object list from multiple threads access.
 		std::recursive_mutex protect_lock;
 		
+		// Allocation state of the current thread, nullptr if thread is not attached.
+		static thread_local gc_thread_state* local_state;
+		
+		// All attached thread states
+		std::vector<gc_thread_state*> thread_states;
+		
+		// Returns lock over protect_lock, not locked in single-threaded mode.
+		inline std::unique_lock<std::recursive_mutex> protect() {
+			if (is_multithreaded())
+				return std::unique_lock<std::recursive_mutex>(protect_lock);
+			return std::unique_lock<std::recursive_mutex>(protect_lock, std::defer_lock);
+		};
+		
+		// Moves objects from local list of given thread into global list.
+		// Called with protect_lock acquired.
+		void merge_thread_state(gc_thread_state *state);
+		
 		bool collecting;
 		int32_t size;
 		int32_t roots_size;
 		int32_t locks_size;
-		gc_list *objects;
-		gc_list *roots;
-		gc_list *locks;
+		// All objects linked by gc_next
+		gc_object *objects;
+		// Roots and locks, unrooted and unlocked objects are removed on collection
+		std::vector<gc_object*> roots;
+		std::vector<gc_object*> locks;
+		
+		// Mark stack reused between collections
+		gc_mark_stack mark_stack;
+		
+		// Objects holding weak references, processed after marking
+		std::vector<gc_object*> weak_holders;
+		
+		// Traces ephemerons of reachable weak holders till fixpoint and 
+		//  clears references to unreachable objects. Unreachable holders are removed.
+		void process_weak();
 		
 		// Number of objects created since last gc_collect pass
 		int32_t created_interval;
@@ -121,6 +255,51 @@ namespace ck_core {
 		// Current memory usage
 		static std::atomic<int64_t> memory_usage;
 		
+		// Heap size that triggers next collection, updated by pacer after each collection
+		static std::atomic<int64_t> collect_threshold;
+		
+		// Set by allocator when heap size crosses collect_threshold.
+		//  Collection itself is performed by executer on the next safe point.
+		static std::atomic<bool> collect_requested;
+		
+		// Set by allocator when heap size approaches MAX_HEAP_SIZE.
+		//  Forces full collection on the next safe point even if GC is paused.
+		static std::atomic<bool> emergency_requested;
+		
+		// Set by allocator on first OutOfMemory when HEAP_DUMP_ON_OOM is set.
+		//  Snapshot is written on the next safe point, allocator can not stop the world.
+		static std::atomic<bool> dump_requested;
+		
+		// Depth of GC.pause() regions, automatic collection is disabled while > 0
+		std::atomic<int32_t> pause_depth;
+		
+		// Current heap growth factor applied to live size after collection
+		double heap_growth;
+		
+		// Duration of last mark phase in microseconds
+		int64_t last_mark_time;
+		
+		// Time of the end of last collection
+		std::chrono::steady_clock::time_point last_collect;
+		
+		// Recalculates collect_threshold from live heap size and measured mark cost
+		void update_pacer(int64_t mark_time, std::chrono::steady_clock::time_point collect_start);
+		
+		// Fragmentation of malloc heap measured after last collection
+		double fragmentation;
+		
+		// Amount of free malloc memory at last trim. Released pages are still counted 
+		//  as free by malloc, so next trim is performed only after it grows by MIN_TRIM_SIZE.
+		int64_t trimmed_free;
+		
+		// Measures fragmentation and releases free pages to the system if it is above TRIM_RATIO
+		void trim_heap();
+		
+		// Stops other threads and moves all thread local objects into global list.
+		// Returns 1 if GIL lock was requested by this call and must be released by resume_world.
+		bool stop_world();
+		void resume_world(bool requested);
+		
         // Number of minimum objects to be created before next GC
         // Yes, i like number 64.
         // 64 is like 8 * 8 and 2 << (8 - 2).
@@ -198,6 +377,26 @@ namespace ck_core {
 		static int64_t MAX_HEAP_SIZE;
 		// Minimal amount of objects to be created before GC collect, 64
 		static int32_t MIN_GC_INTERVAL;
+		// Minimal heap size that triggers collection, 4Mb
+		static int64_t MIN_HEAP_TRIGGER;
+		// Bounds of heap growth factor, 1.5 .. 4.0
+		static double MIN_HEAP_GROWTH;
+		static double MAX_HEAP_GROWTH;
+		// Target fraction of time spent in marking, 0.05
+		static double GC_TIME_RATIO;
+		// Fraction of MAX_HEAP_SIZE that triggers emergency collection, 0.9
+		static double EMERGENCY_RATIO;
+		// Fragmentation of malloc heap that triggers trimming after collection, 0.25, 0 to disable
+		static double TRIM_RATIO;
+		// Minimal amount of free malloc memory to be trimmed, 16Mb
+		static int64_t MIN_TRIM_SIZE;
+		// Path of heap snapshot written on first OutOfMemory, empty to disable
+		static std::string HEAP_DUMP_ON_OOM;
+		
+		// Changes MAX_HEAP_SIZE, minimal is 8Mb
+		static void set_heap_limit(int64_t size);
+		// Changes MIN_HEAP_TRIGGER and resets collect threshold to it
+		static void set_min_heap_trigger(int64_t size);
 		
 		GC();
 		~GC();
@@ -214,8 +413,21 @@ namespace ck_core {
 		void lock(gc_object *o);
 		void unlock(gc_object *o);
 		
+		// Registers object holding weak references.
+		// gc_trace_weak and gc_clear_weak of it are called on each collection 
+		//  till the object is collected.
+		void attach_weak(gc_object *o);
+		
+		// Returns allocation state of the current thread or nullptr.
+		inline static gc_thread_state* current_state() { return local_state; };
+		
+		// Binds allocation state to the current thread.
+		void attach_thread(gc_thread_state *state);
+		// Unbinds allocation state from the current thread and moves it's objects into global list.
+		void deattach_thread(gc_thread_state *state);
+		
 		// Amount of objects registered by GC.
-		inline int32_t count() { return size; };
+		int32_t count();
 
 		// Amount of roots
 		inline int32_t roots_count() { return roots_size; };
@@ -225,8 +437,127 @@ namespace ck_core {
 		
 		inline int64_t get_used_memory() { return memory_usage; };
 		
+		// Heap size that will trigger next collection
+		inline int64_t get_collect_threshold() { return collect_threshold; };
+		
+		// Returns 1 if allocator requested collection. Cheap enough to be checked on each safe point.
+		inline bool collect_pending() { return collect_requested.load(std::memory_order_relaxed); };
+		
+		// Returns 1 if allocator requested heap snapshot on OutOfMemory
+		inline bool dump_pending() { return dump_requested.load(std::memory_order_relaxed); };
+		
+		// Disables automatic collection till matching resume().
+		// Emergency and forced collections are still performed.
+		inline void pause() { ++pause_depth; };
+		// Leaves pause region, returns 0 if GC was not paused.
+		bool resume();
+		// Returns 1 if GC is paused
+		inline bool is_paused() { return pause_depth > 0; };
+		
+		// Duration of last mark phase in microseconds
+		inline int64_t get_last_mark_time() { return last_mark_time; };
+		
+		// Returns fraction of free memory trapped between used blocks of malloc heap.
+		// Measured after each collection, 0 if not supported by platform.
+		inline double get_fragmentation() { return fragmentation; };
+		
+		// Measures current fragmentation of malloc heap
+		static double measure_fragmentation();
+		
+		// Releases free pages of malloc heap to the system. Returns 1 if memory was released.
+		static bool release_free_memory();
+		
+		// Returns name of object type without namespace
+		static std::string type_name(gc_object *o);
+		
+		// Writes heap snapshot in JSON format (see heap_snapshot.md).
+		// Returns 0 if file could not be written.
+		bool dump_heap(const std::string &path);
+		
+		// Returns amount and size of registered objects by type, sorted by size.
+		// Garbage that was not collected yet is counted too.
+		std::vector<gc_census_entry> census();
+		
+		// Called by allocator before throwing OutOfMemory, requests snapshot to HEAP_DUMP_ON_OOM once.
+		static void out_of_memory();
+		
+		// Writes snapshot requested by out_of_memory(). Called on safe point 
+		//  and by top-level OutOfMemory handler, never by allocator.
+		void dump_pending_heap();
+		
+		// Performs collection if allocator requested it.
 		// if forced_collect is 1, GC will ignore checking conditons for optimizing and perform collection.
 		void collect(bool forced_collect = 0);
 		void dispose();
 	};
+
+	/*
+	 * Handle scope of the current thread.
+	 * All handles created after this scope are released when it is destroyed.
+	 * Example:
+	 *  gc_handle_scope hs;
+	 *  hs.add(obj); // obj is root till the end of the block
+	 */
+	class gc_handle_scope {
+		
+		gc_thread_state *state;
+		std::size_t      mark;
+		
+	public:
+		
+		gc_handle_scope() : state(GC::current_state()), mark(state ? state->handles.size() : 0) {};
+		
+		~gc_handle_scope() {
+			if (state)
+				state->handles.resize(mark);
+		};
+		
+		// Roots given object till the scope is destroyed
+		inline void add(gc_object *o) {
+			if (state)
+				state->handles.push_back(o);
+		};
+	};
+	
+	/*
+	 * Local reference to object rooted by handle of the current thread.
+	 * Must be destroyed in reverse order of creation, as any local variable does.
+	 * Example:
+	 *  gc_local<vscope> scope(new iscope());
+	 */
+	template<typename T> class gc_local {
+		
+		gc_thread_state *state;
+		std::size_t      index;
+		T               *object;
+		
+	public:
+		
+		gc_local(T *o = nullptr) : state(GC::current_state()), index(0), object(o) {
+			if (state) {
+				index = state->handles.size();
+				state->handles.push_back(o);
+			}
+		};
+		
+		~gc_local() {
+			if (state)
+				state->handles.resize(index);
+		};
+		
+		gc_local(const gc_local&)            = delete;
+		gc_local& operator=(const gc_local&) = delete;
+		
+		inline T* get() const { return object; };
+		
+		inline gc_local& operator=(T *o) {
+			object = o;
+			if (state)
+				state->handles[index] = o;
+			return *this;
+		};
+		
+		inline operator T*()   const { return get(); };
+		inline T* operator->() const { return get(); };
+	};
 };
\ No newline at end of file
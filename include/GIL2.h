@@ -8,6 +8,8 @@
 #include <functional>
 
 #include "exceptions.h"
+#include "GC.h"
+#include "mailbox.h"
 
 
 namespace ck_core {
@@ -63,14 +65,32 @@ namespace ck_core {
 		//  is locked set to 1 when thread allowed GIL to acquire lock on it.
 		//  is blocked is set to 1 when thread may perform IO operations and GIL can acquire lock on it.
 		
-		bool running = 1;
-		bool blocked = 0;
-		bool locked  = 0;
+		// State flags are written by other threads (GIL::stop(), signal handler).
+		
+		std::atomic<bool> running = { 1 };
+		std::atomic<bool> blocked = { 0 };
+		std::atomic<bool> locked  = { 0 };
+		
+		// Safepoint poll word.
+		// Executer checks it with a single relaxed load on backward jumps, calls 
+		//  and returns. Any other thread (or the allocator) sets a bit to make 
+		//  this thread stop at the next safepoint and handle the request.
+		std::atomic<uint32_t> poll_word = { 0 };
+		
+		// Daemon thread does not keep interpreter alive. 
+		// Main thread does not wait for it on exit.
+		std::atomic<bool> daemon = { 0 };
 		
 		// Indicates if this thread is owning GIL lock now.
 		// Used to avoid situuations of incorrect GIL locking/unlocking.
 		bool own_gil = 0;
 		
+		// List of objects allocated by this thread, attached to GC on thread start.
+		gc_thread_state gc_state;
+		
+		// Callbacks posted to this thread, executed on it's safepoints.
+		mailbox mail;
+		
 		// Default constructor,
 		//  Binds std::this_thread to native_thread
 		//  Binds native_thread_id value
@@ -92,6 +112,18 @@ namespace ck_core {
 		
 	public:
 		
+		// Bits of poll_word
+		enum poll_bits : uint32_t {
+			// Other thread requested GIL lock
+			POLL_STOP      = 1,
+			// Thread was marked as not running
+			POLL_TERMINATE = 2,
+			// Allocator requested collection
+			POLL_GC        = 4,
+			// Executer has pending late calls
+			POLL_LATE_CALL = 8
+		};
+		
 		~gil_thread() {
 			if (has_native_thread_pointer)
 				delete native_thread_pointer;
@@ -112,6 +144,37 @@ namespace ck_core {
 		// Set running state
 		inline void set_running(bool is_running) {
 			running = is_running;
+			if (!is_running)
+				request_poll(POLL_TERMINATE);
+		};
+		
+		// Returns non-zero if thread has pending safepoint requests
+		inline uint32_t poll() {
+			return poll_word.load(std::memory_order_relaxed);
+		};
+		
+		// Ask thread to stop on the next safepoint
+		inline void request_poll(uint32_t bits) {
+			poll_word.fetch_or(bits, std::memory_order_release);
+		};
+		
+		// Returns and resets pending safepoint requests
+		inline uint32_t take_poll() {
+			return poll_word.exchange(0, std::memory_order_acquire);
+		};
+		
+		// Resets given safepoint requests
+		inline void clear_poll(uint32_t bits) {
+			poll_word.fetch_and(~bits, std::memory_order_acquire);
+		};
+		
+		inline bool is_daemon() {
+			return daemon;
+		};
+		
+		// Mark thread as daemon
+		inline void set_daemon(bool is_daemon) {
+			daemon = is_daemon;
 		};
 		
 		// Set blocked by i/o 
@@ -129,6 +192,11 @@ namespace ck_core {
 			return !running || locked || blocked;
 		};
 		
+		// Returns 1 if this thread owns GIL lock.
+		inline bool owns_gil() {
+			return own_gil;
+		};
+		
 		// Returns id of std::thread
 		inline std::thread::id get_native_id() {
 			return native_thread_id;
@@ -146,7 +214,8 @@ namespace ck_core {
 		
 		// Set blocked = locked = 0
 		inline void clear_blocks() {
-			blocked = locked = 0;
+			blocked = 0;
+			locked  = 0;
 		};
 		
 		// Total threads count
@@ -159,6 +228,11 @@ namespace ck_core {
 			return thread_id;
 		};
 		
+		// Returns queue of callbacks posted to this thread
+		inline mailbox& get_mailbox() {
+			return mail;
+		};
+		
 		// Resets state of the thread to the default
 		// running = 1
 		// locked  = 0
@@ -167,6 +241,7 @@ namespace ck_core {
 			running = 1;
 			locked  = 0;
 			blocked = 0;
+			poll_word.fetch_and(~(uint32_t) POLL_TERMINATE, std::memory_order_relaxed);
 		};
 	};
 	
@@ -203,7 +278,7 @@ namespace ck_core {
 		std::recursive_mutex threads_mutex;
 	
 		// Set to 1 if lock is requested by someone
-		bool lock_requested = 0;
+		std::atomic<bool> lock_requested = { 0 };
 	
 		// Points to the current gil_thread
 		// Assigned when thread is being spawned via 
@@ -263,6 +338,33 @@ namespace ck_core {
 			return lock_requested;
 		};
 		
+		// Sets poll bits on every thread except the current one.
+		inline void poll_all(uint32_t bits) {
+			std::unique_lock<std::recursive_mutex> lk(threads_mutex);
+			
+			for (int i = 0; i < threads.size(); ++i)
+				if (threads[i] != current_thread())
+					threads[i]->request_poll(bits);
+		};
+		
+		// Posts item to mailbox of thread with given id and makes it run 
+		//  posted callbacks on the next safepoint.
+		// Returns 0 if thread is not running, item is not taken then.
+		inline bool post_mail(uint64_t thread_id, mail_item* item) {
+			std::unique_lock<std::recursive_mutex> lk(threads_mutex);
+			
+			for (int i = 0; i < threads.size(); ++i)
+				if (threads[i]->get_id() == thread_id) {
+					if (!threads[i]->is_running() || !threads[i]->get_mailbox().post(item))
+						return 0;
+					
+					threads[i]->request_poll(gil_thread::POLL_LATE_CALL);
+					return 1;
+				}
+			
+			return 0;
+		};
+		
 		// Find thread by thread_id
 		// WARNING: This call is not thread-safe, meaning thread 
 		//  should request GIL lock before call this function.
@@ -286,6 +388,9 @@ namespace ck_core {
 		//  the locked state and could operate with this mutex.
 		inline void lock() {
 		#ifndef CK_SINGLETHREAD
+			if (!is_multithreaded())
+				return;
+			
 			current_thread()->set_locked(1);
 			
 			// Notify all threads that this thread is locked.
@@ -302,6 +407,9 @@ namespace ck_core {
 		// Attempts to lock the mutex. Returns 1 on success.
 		inline bool try_lock() {
 		#ifndef CK_SINGLETHREAD			
+			if (!is_multithreaded())
+				return 1;
+			
 			notify();
 			return sync_mutex.try_lock();
 		#else
@@ -314,6 +422,9 @@ namespace ck_core {
 		//  returns 0.
 		inline void unlock() {
 		#ifndef CK_SINGLETHREAD
+			if (!is_multithreaded())
+				return;
+			
 			sync_mutex.unlock();
 			
 			// To avoid the situation when other threads waiting for some shit
@@ -328,6 +439,9 @@ namespace ck_core {
 		//  returns 0.
 		inline void unlock_no_accept() {
 		#ifndef CK_SINGLETHREAD
+			if (!is_multithreaded())
+				return;
+			
 			sync_mutex.unlock();
 			
 			// To avoid the situation when other threads waiting for some shit
@@ -340,6 +454,9 @@ namespace ck_core {
 		//  notify other threads to lock by setting lock_requestd to 1.
 		inline void request_lock() {
 		#ifndef CK_SINGLETHREAD
+			// No other threads to stop
+			if (!is_multithreaded())
+				return;
 		
 			if (current_thread()->own_gil || lock_requested)
 				return;
@@ -365,6 +482,9 @@ namespace ck_core {
 			// Requesting all threads to lock
 			lock_requested = 1;
 			
+			// Make running threads reach safepoint
+			poll_all(gil_thread::POLL_STOP);
+			
 			
 			// W A I T _ A C Q U I R E
 			
@@ -380,7 +500,7 @@ namespace ck_core {
 				
 				bool all_locked = 1;
 				if (GIL::instance()->get_threads().size() > 1) {
-					for (int i = 0; i < GIL::instance()->get_threads().size() && !all_locked; ++i)
+					for (int i = 0; i < GIL::instance()->get_threads().size(); ++i)
 						if (GIL::instance()->get_threads()[i] != current_thread() && !GIL::instance()->get_threads()[i]->locked_state()) {
 							all_locked = 0;
 							break;
@@ -404,6 +524,8 @@ namespace ck_core {
 		
 		inline bool try_request_lock() {
 		#ifndef CK_SINGLETHREAD
+			if (!is_multithreaded())
+				return 1;
 			
 			if (current_thread()->own_gil || lock_requested)
 				return 0;
@@ -432,6 +554,9 @@ namespace ck_core {
 			// Requesting all threads to lock
 			lock_requested = 1;
 			
+			// Make running threads reach safepoint
+			poll_all(gil_thread::POLL_STOP);
+			
 			
 			// W A I T _ A C Q U I R E
 			
@@ -447,7 +572,7 @@ namespace ck_core {
 				
 				bool all_locked = 1;
 				if (GIL::instance()->get_threads().size() > 1) {
-					for (int i = 0; i < GIL::instance()->get_threads().size() && !all_locked; ++i)
+					for (int i = 0; i < GIL::instance()->get_threads().size(); ++i)
 						if (GIL::instance()->get_threads()[i] != current_thread() && !GIL::instance()->get_threads()[i]->locked_state()) {
 							all_locked = 0;
 							break;
@@ -474,6 +599,9 @@ namespace ck_core {
 		//  may do some shit when waiting on the condition.
 		inline void dequest_lock() {
 		#ifndef CK_SINGLETHREAD
+			if (!is_multithreaded())
+				return;
+			
 			if (!current_thread()->own_gil || !lock_requested)
 				return;
 			
@@ -486,6 +614,9 @@ namespace ck_core {
 		// Send notify to all threads.
 		inline void notify() {
 		#ifndef CK_SINGLETHREAD
+			if (!is_multithreaded())
+				return;
+			
 			sync_condition.notify_all();
 		#endif
 		};
@@ -507,6 +638,9 @@ namespace ck_core {
 		// Checks if some threads was requesting for a lock and locks.
 		inline void accept_lock() {
 		#ifndef CK_SINGLETHREAD
+			if (!is_multithreaded())
+				return;
+			
 			if (is_lock_requested()) {
 				// Wait on mutex for lock for next wait
 				lock();
@@ -559,6 +693,9 @@ namespace ck_core {
 		//  still locked by created thread.
 		int64_t spawn_thread(int64_t stack_size, std::function<void ()> body) {
 		#ifndef CK_SINGLETHREAD
+			// Leave single-threaded mode before any synchronization
+			multithreaded.store(1);
+			
 			// Lock in here to prevent uninitialized value acccess if thread finishes 
 			//  before it was attached and detached from GIL threads array
 			GIL::instance()->lock();
@@ -0,0 +1,222 @@
+#pragma once
+
+#include <map>
+#include <vector>
+#include <deque>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+
+#include "GC.h"
+#include "GIL2.h"
+#include "timer_wheel.h"
+
+namespace ck_vobject {
+	class vobject;
+};
+
+namespace ck_objects {
+	class Future;
+};
+
+namespace ck_core {
+	
+	// Single asynchronous operation on file descriptor.
+	// Performed by reactor thread, result is delivered to the owner thread.
+	struct io_request {
+		enum request_type {
+			// Read next available chunk of data
+			READ,
+			// Read till the end of input
+			READ_ALL,
+			// Write whole buffer
+			WRITE,
+			// Call callback after timer expiration
+			TIMER
+		};
+		
+		request_type type;
+		int          fd;
+		
+		// Data to write or received data
+		std::string buffer;
+		
+		// Amount of written bytes
+		size_t offset = 0;
+		
+		// errno of failed operation, 0 on success
+		int error = 0;
+		
+		// Thread receiving completion
+		gil_thread* owner = nullptr;
+		
+		// Object performing request, kept alive till completion
+		ck_vobject::vobject* source   = nullptr;
+		
+		// Resolved with result on the owner thread
+		ck_objects::Future*  future   = nullptr;
+		
+		// Called with result through late call of the owner thread, optional
+		ck_vobject::vobject* callback = nullptr;
+		
+		// Timer requests only
+		
+		timer_entry timer;
+		uint64_t    timer_id = 0;
+		
+		// Repeat period in milliseconds, 0 for single shot timer
+		int64_t interval = 0;
+		
+		// Timer was cleared after expiration and before dispatch
+		bool cancelled = 0;
+		
+		// Arguments of callback
+		std::vector<ck_vobject::vobject*> args;
+	};
+	
+	// Marks objects referenced by pending requests on each GC step.
+	class event_loop;
+	class event_loop_gc_object : public gc_object {
+		event_loop* loop;
+		
+	public:
+		
+		event_loop_gc_object(event_loop* loop);
+		~event_loop_gc_object();
+		
+		void gc_trace(gc_visitor&);
+		void gc_finalize();
+	};
+	
+	// Reactor multiplexing asynchronous I/O of all threads.
+	// Single native thread waits on epoll for all watched descriptors and performs
+	//  non-blocking reads and writes into native buffers. Completed requests are
+	//  queued for the owner thread and delivered on it's next safepoint: future
+	//  is resolved and callback is passed to the late call queue of the executer.
+	class event_loop {
+		
+		friend class event_loop_gc_object;
+		
+		// Pending operations of single descriptor, performed in order of submission
+		struct fd_watch {
+			std::deque<io_request*> reads;
+			std::deque<io_request*> writes;
+			
+			// Incomplete UTF-8 sequence left from the last chunk
+			std::string carry;
+			
+			// Descriptor is added to epoll set
+			bool registered = 0;
+		};
+		
+		static std::atomic<event_loop*> loop_instance;
+		
+		int epoll_fd;
+		
+		// Wakes reactor on shutdown
+		int wake_fd;
+		
+		std::atomic<bool> stopped = { 0 };
+		
+		// Protects all state below
+		std::mutex mutex;
+		
+		std::map<int, fd_watch> watches;
+		
+		// Completed and not dispatched requests of each thread
+		std::map<gil_thread*, std::vector<io_request*>> completed;
+		
+		// Amount of submitted and not dispatched requests of each thread
+		std::map<gil_thread*, int> pending;
+		
+		// Owner threads wait for completions on this condition
+		std::condition_variable completed_var;
+		
+		// Timers ticking once per millisecond since loop start
+		timer_wheel wheel;
+		std::chrono::steady_clock::time_point start;
+		
+		// Active timers by id
+		std::map<uint64_t, io_request*> timers;
+		uint64_t timer_counter = 0;
+		
+		event_loop_gc_object* gc_marker;
+		
+		event_loop();
+		
+		// Body of the reactor thread
+		void run_reactor();
+		
+		// Performs operation on ready descriptor.
+		// Returns 1 if request is completed.
+		bool perform(fd_watch& watch, io_request* request);
+		
+		// Passes request to the owner thread. Called with mutex locked.
+		void complete(io_request* request);
+		
+		// Updates epoll events of descriptor. Called with mutex locked.
+		// Returns errno on failure.
+		int update(int fd, fd_watch& watch);
+		
+		// Milliseconds since loop start
+		uint64_t now_tick();
+		
+		// Links timer into wheel and wakes reactor to recalculate timeout.
+		// Called with mutex locked.
+		void schedule(io_request* request, uint64_t deadline);
+		
+		// Completes expired timers. Called with mutex locked.
+		// Returns 1 if any timer expired.
+		bool expire_timers();
+		
+	public:
+		
+		// Returns loop instance, reactor is started on the first call
+		static event_loop* instance();
+		
+		// Returns 1 if loop was started, allows skipping checks when no I/O was performed
+		static inline bool exists() {
+			return loop_instance.load(std::memory_order_acquire) != nullptr;
+		};
+		
+		// Starts operation on behalf of the current thread.
+		// Loop owns request after the call.
+		void submit(io_request* request);
+		
+		// Removes descriptor from the loop before closing, pending
+		//  requests on it are completed with EBADF
+		void close(int fd);
+		
+		// Resolves completed requests of the current thread and
+		//  queues their callbacks as executer late calls.
+		// Returns 1 if any request was dispatched.
+		bool dispatch();
+		
+		// Returns 1 if current thread has requests that were not dispatched
+		bool has_pending();
+		
+		// Waits for completed request of the current thread at most timeout milliseconds.
+		// Thread is expected to be marked as blocked.
+		void wait(int64_t timeout);
+		
+		// Dispatches requests and executes callbacks till
+		//  current thread has no pending requests.
+		void run();
+		
+		// Calls callback with args on the current thread after delay milliseconds
+		//  and then each interval milliseconds if interval is positive.
+		// Returns id of timer.
+		uint64_t set_timer(int64_t delay, int64_t interval, ck_vobject::vobject* callback, const std::vector<ck_vobject::vobject*>& args);
+		
+		// Cancels timer, returns 0 if there is no such timer
+		bool clear_timer(uint64_t id);
+		
+		// Drops requests of the finished thread
+		void release(gil_thread* thread);
+		
+		// Stops reactor on interpreter exit, pending requests are dropped
+		static void shutdown();
+	};
+};
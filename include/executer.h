@@ -16,6 +16,9 @@ namespace ck_vobject {
 // Allow both classes collect backtrace of this executer.
 namespace ck_objects {
 	class Cake;
+	
+	// Suspended frame of generator is saved in it
+	class Generator;
 };
 
 namespace ck_exceptions {
@@ -26,7 +29,7 @@ namespace ck_core {
 	
 	// Single execution stack frame.
 	struct stack_frame {		
-		// Set to 1 if call owns this scope.
+		// Set to 1 if call created this scope.
 		bool own_scope = -1;
 		
 		// Index of last scope in the executer scopes array.
@@ -56,10 +59,27 @@ namespace ck_core {
 		// Address of catch node in try/catch
 		int catch_node = -1;
 		
+		// Object holding monitor of synchronized frame
+		ck_vobject::vobject* monitor = nullptr;
+		
 		// Name of the function
 		std::wstring name;
 	};
 	
+	// Saved state of suspended generator frame.
+	// Ids of try frames are relative to the generator call frame.
+	struct generator_frame {
+		// Objects and scopes pushed by generator body
+		std::vector<ck_vobject::vobject*> objects;
+		std::vector<ck_vobject::vscope*>  scopes;
+		
+		// Try frames entered by generator body
+		std::vector<stack_frame> tries;
+		
+		// Address of command following YIELD
+		int pointer = 0;
+	};
+	
 	// Item representing information about late_call_object
 	struct late_call_instance {
 		// Object to be called
@@ -79,12 +99,6 @@ namespace ck_core {
 		
 		// Boolean flag for using scope
 		bool use_scope_without_wrap;
-		
-		// Boolean flags recording information about ownership for passed objects.
-		// Used to mark all of them as root to prevent deletion in unsafe area of execution.
-		bool own_obj;
-		bool own_ref;
-		std::vector<bool> own_args;
 	};
 	
 	// Performs marking all ck_executer objects in current thread on each GC step.
@@ -98,7 +112,7 @@ namespace ck_core {
 		ck_executer_gc_object(ck_executer* exec_instance);
 		~ck_executer_gc_object();
 		
-		void gc_mark();
+		void gc_trace(gc_visitor&);
 		void gc_finalize();
 	};
 	
@@ -123,6 +137,15 @@ namespace ck_core {
 		// During GC cycle values in this list is being marked by gc_marker.
 		std::vector<late_call_instance> late_call;
 	
+		// Set while late calls are executed.
+		// Safepoints inside of the running call leave the rest of 
+		//  the list to the running loop instead of interrupting it.
+		bool in_late_call = 0;
+		
+		// Thread owning this executer. 
+		// Used to post safepoint requests for late calls.
+		ck_core::gil_thread* thread;
+		
 		std::vector<ck_core::ck_script*>  scripts;
 		std::vector<ck_vobject::vscope*>  scopes;
 		std::vector<ck_vobject::vobject*> objects;
@@ -145,6 +168,12 @@ namespace ck_core {
 		// Points to the current command address in bytemap.
 		int pointer = 0;
 		
+		// Generator executed by the last resume_generator()
+		ck_objects::Generator* generator = nullptr;
+		
+		// Set by YIELD, exec_bytecode() returns yielded value up to resume_generator()
+		bool yielding = 0;
+		
 		// Reads byte block from bytemap.
 		bool read(int size, void* ptr);
 		
@@ -162,6 +191,21 @@ namespace ck_core {
 		//  or nullptr if nothing returned or nothing should be returned.
 		ck_vobject::vobject* exec_bytecode();
 		
+		// Executes body of the last try frame. 
+		// Exception is followed to the catch block of the frame and execution continues.
+		// If tries is not null, saved try frames of resumed generator are entered starting from level.
+		// Returns value of RETURN bytecode or nullptr if block was left.
+		ck_vobject::vobject* exec_try_block(const std::vector<stack_frame>* tries = nullptr, int level = 0);
+		
+		// Pushes saved try frame of resumed generator and executes it's body,
+		//  then continues execution of the enclosing block.
+		ck_vobject::vobject* resume_try_frame(const std::vector<stack_frame>& tries, int level);
+		
+		// Handles pending requests of the current thread poll word: 
+		//  GIL lock, GC collection, late calls and termination.
+		// Returns 0 if thread is no longer running.
+		bool poll_safepoint();
+		
 		// Checks if execution reached end or BCEND.
 		bool is_eof();
 		
@@ -264,6 +308,10 @@ namespace ck_core {
 		
 		void restore_window_frame(int restored_frame_id);
 		
+		// Releases monitors of synchronized frames starting from try_size
+		//  before try stack is shrinked to this size.
+		void release_monitors(int try_size);
+		
 	public:
 		
 		// Restore to empty state.
@@ -296,6 +344,14 @@ namespace ck_core {
 			return late_call.size(); 
 		};
 		
+		// Executes all pending late_call functions.
+		// Exceptions are thrown up to the caller.
+		void run_late_calls();
+		
+		// Moves callbacks posted to this thread into late_call list.
+		// Returns amount of received callbacks.
+		int receive_mail();
+		
 		// Executes passed script by allocating new stack frame.
 		void execute(ck_core::ck_script* scr);
 		
@@ -330,6 +386,17 @@ namespace ck_core {
 		//  If 0, returns null.
 		ck_vobject::vobject* call_object(ck_vobject::vobject* obj, ck_vobject::vobject* ref, const std::vector<ck_vobject::vobject*>&, const std::wstring& name, ck_vobject::vscope* scope = nullptr, bool use_scope_without_wrap = 0, bool return_non_null = 1);
 		
+		// Calls object same as call_object() and catches cake thrown by the call.
+		// On failure executer is restored to the state before the call, so 
+		//  native code may continue using it. Returns 0 and assigns thrown cake 
+		//  with collected backtrace to error.
+		bool try_call_object(ck_vobject::vobject*& result, ck_exceptions::cake& error, ck_vobject::vobject* obj, ck_vobject::vobject* ref, const std::vector<ck_vobject::vobject*>&, const std::wstring& name, ck_vobject::vscope* scope = nullptr);
+		
+		// Executes generator body till the next yield or return.
+		// Saved frame of generator is pushed on stacks, value becomes result of the suspended yield.
+		// Sets done to 1 if generator returned or already finished.
+		ck_vobject::vobject* resume_generator(ck_objects::Generator* generator, ck_vobject::vobject* value, bool& done);
+		
 		// Performing late object call by execution passed function on the next executer step.
 		// By default, all objects passed to this function will be marked as root objects to prevent their colleciton on GC.
 		void late_call_object(ck_vobject::vobject* obj, ck_vobject::vobject* ref, const std::vector<ck_vobject::vobject*>& args, const std::wstring& name, ck_vobject::vscope* scope = nullptr, bool use_scope_without_wrap = 0);
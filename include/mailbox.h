@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace ck_vobject {
+	class vobject;
+};
+
+namespace ck_core {
+	
+	class gc_visitor;
+	
+	// Callback posted to thread by Thread.post()
+	struct mail_item {
+		ck_vobject::vobject*              obj = nullptr;
+		std::vector<ck_vobject::vobject*> args;
+		
+		mail_item* next = nullptr;
+	};
+	
+	// Lock-free multiple producers single consumer queue of posted callbacks.
+	// Producers push to the head of the list with CAS, owner thread takes the
+	//  whole list with single exchange. Values are traced by executer of owner.
+	// Producers are running threads, so mailbox can not be closed or traced
+	//  by GC during push.
+	class mailbox {
+		
+		std::atomic<mail_item*> head    = { nullptr };
+		std::atomic<bool>       closed  = { 0 };
+		
+		// Owner waiting for items in Thread.dispatch()
+		std::atomic<bool>       waiting = { 0 };
+		std::mutex              wait_mutex;
+		std::condition_variable wait_var;
+		
+	public:
+		
+		~mailbox();
+		
+		// Appends item, returns 0 if mailbox was closed and item is not taken
+		bool post(mail_item* item);
+		
+		// Takes all posted items, newest first
+		mail_item* take();
+		
+		inline bool empty() {
+			return head.load(std::memory_order_acquire) == nullptr;
+		};
+		
+		// Waits at most timeout milliseconds (forever if timeout < 0) for posted 
+		//  item or till owner thread is stopped.
+		// Thread has to be marked blocked by the caller.
+		void wait(int64_t timeout);
+		
+		// Rejects further posts and drops pending items
+		void close();
+		
+		// Marks values of pending items
+		void gc_trace(gc_visitor& visitor);
+	};
+};
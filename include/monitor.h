@@ -0,0 +1,73 @@
+#pragma once
+
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <condition_variable>
+
+#include "GIL2.h"
+
+namespace ck_core {
+	
+	// Waits on var till ready() returns true or timeout milliseconds pass, infinite if timeout < 0.
+	// Thread is expected to be marked as blocked, so it is woken periodically to notice termination.
+	// Returns result of the last ready() call.
+	template<typename Predicate>
+	bool wait_blocked(std::unique_lock<std::mutex>& lk, std::condition_variable& var, int64_t timeout, Predicate ready) {
+		std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout < 0 ? 0 : timeout);
+		
+		while (!ready()) {
+			if (!GIL::current_thread()->is_running())
+				return 0;
+			
+			int64_t wait_time = 100;
+			if (timeout >= 0) {
+				int64_t left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+				if (left <= 0)
+					return 0;
+				
+				wait_time = std::min(wait_time, left);
+			}
+			
+			var.wait_for(lk, std::chrono::milliseconds(wait_time));
+		}
+		
+		return 1;
+	};
+	
+	// Reentrant lock owned by interpreter thread.
+	// Unlike object field lock, waiting thread is marked as blocked and
+	//  never stalls GIL lock requests, so monitor may be held across safepoints.
+	class monitor {
+		
+		std::mutex mutex;
+		std::condition_variable released;
+		
+		// Owner thread and recursion depth
+		gil_thread* owner = nullptr;
+		int count = 0;
+		
+	public:
+		
+		// Acquires monitor waiting at most timeout milliseconds, infinite if timeout < 0.
+		// Returns 0 on timeout or if thread was stopped while waiting.
+		bool lock(int64_t timeout = -1);
+		
+		// Releases one level of recursion.
+		// Returns 0 if monitor is not owned by the current thread.
+		bool unlock();
+		
+		// Releases all levels of recursion before waiting on condition.
+		// Returns recursion depth to be passed to relock().
+		int unlock_all();
+		
+		// Acquires monitor with recursion depth returned by unlock_all().
+		// Returns 0 if thread was stopped while waiting.
+		bool relock(int depth);
+		
+		bool is_locked();
+		
+		// Returns 1 if monitor is owned by the current thread
+		bool is_owned();
+	};
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+
+#include "Object.h"
+#include "CallableObject.h"
+
+namespace ck_objects {
+	
+	// 64-bit integer updated with atomic operations, never locks.
+	class AtomicInt : public ck_objects::Object {
+		
+	protected:
+		
+		std::atomic<int64_t> value;
+		
+	public:
+		
+		AtomicInt(int64_t value = 0);
+		virtual ~AtomicInt();
+		
+		virtual vobject* get     (ck_vobject::vscope*, const std::wstring&);
+		virtual void     put     (ck_vobject::vscope*, const std::wstring&, vobject*);
+		virtual bool     contains(ck_vobject::vscope*, const std::wstring&);
+		virtual bool     remove  (ck_vobject::vscope*, const std::wstring&);
+		virtual vobject* call    (ck_vobject::vscope*, const std::vector<vobject*>&);
+		
+		virtual void gc_trace(ck_core::gc_visitor&);
+		virtual void gc_finalize();
+		
+		// AtomicInt functions only
+		
+		inline int64_t load() { return value.load(); };
+		
+		inline void store(int64_t v) { value.store(v); };
+		
+		// Returns previous value
+		inline int64_t fetch_add(int64_t delta) { return value.fetch_add(delta); };
+		
+		// Returns previous value
+		inline int64_t exchange(int64_t v) { return value.exchange(v); };
+		
+		// Stores v if current value equals expected
+		inline bool compare_exchange(int64_t expected, int64_t v) { return value.compare_exchange_strong(expected, v); };
+		
+		// Must return integer representation of an object
+		virtual int64_t int_value();
+		
+		// Must return string representation of an object
+		virtual std::wstring string_value();
+		
+		// Called on interpreter start to initialize prototype
+		static vobject* create_proto();
+	};
+	
+	// Defined on interpreter start.
+	static CallableObject* AtomicIntProto = nullptr;
+};
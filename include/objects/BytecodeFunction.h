@@ -21,9 +21,12 @@ namespace ck_objects {
 		ck_core::ck_script* script;
 		std::vector<std::wstring> argn;
 		
+		// Set if body contains yield, call returns Generator
+		bool generator;
+		
 	public:
 		
-		BytecodeFunction(ck_vobject::vscope* definition_scope, ck_core::ck_script* script, const std::vector<std::wstring>& argn);
+		BytecodeFunction(ck_vobject::vscope* definition_scope, ck_core::ck_script* script, const std::vector<std::wstring>& argn, bool generator = 0);
 		virtual ~BytecodeFunction();
 		
 		virtual vobject* get     (ck_vobject::vscope*, const std::wstring&);
@@ -32,7 +35,7 @@ namespace ck_objects {
 		virtual bool     remove  (ck_vobject::vscope*, const std::wstring&);
 		virtual vobject* call    (ck_vobject::vscope*, const std::vector<vobject*>&);
 		
-		virtual void gc_mark();
+		virtual void gc_trace(ck_core::gc_visitor&);
 		
 		
 		// Apply arguments to the function and return scope
@@ -43,6 +46,8 @@ namespace ck_objects {
 		
 		inline ck_core::ck_script* get_script() { return script; };
 		
+		inline bool is_generator() { return generator; };
+		
 		// Called on interpreter start to initialize prototype
 		static ck_vobject::vobject* create_proto();
 	};
@@ -31,7 +31,7 @@ namespace ck_objects {
 		virtual bool     remove  (ck_vobject::vscope*, const std::wstring&);
 		virtual vobject* call    (ck_vobject::vscope*, const std::vector<vobject*>&);
 		
-		virtual void gc_mark();
+		virtual void gc_trace(ck_core::gc_visitor&);
 		virtual void gc_finalize();
 		
 		
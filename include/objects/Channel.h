@@ -0,0 +1,97 @@
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+
+#include "Object.h"
+#include "CallableObject.h"
+
+namespace ck_objects {
+	
+	// Bounded multi-producer multi-consumer queue for passing values between threads.
+	// Values are stored in lock-free ring buffer, each cell has sequence number
+	//  telling producers and consumers if cell is free or filled for their turn.
+	// Threads waiting on full or empty channel are parked and marked blocked.
+	class Channel : public ck_objects::Object {
+		
+	protected:
+		
+		struct cell {
+			std::atomic<uint64_t> sequence;
+			ck_vobject::vobject*  value;
+		};
+		
+		cell*    buffer;
+		uint64_t capacity;
+		
+		// Position of next send and next receive
+		std::atomic<uint64_t> send_pos = { 0 };
+		std::atomic<uint64_t> recv_pos = { 0 };
+		
+		std::atomic<bool> closed = { 0 };
+		
+		// Parked threads
+		std::atomic<int>        waiters = { 0 };
+		std::mutex              park_mutex;
+		std::condition_variable park_var;
+		
+		// Wakes parked threads of this channel and select
+		void wake();
+		
+	public:
+		
+		Channel(uint64_t capacity);
+		virtual ~Channel();
+		
+		virtual vobject* get     (ck_vobject::vscope*, const std::wstring&);
+		virtual void     put     (ck_vobject::vscope*, const std::wstring&, vobject*);
+		virtual bool     contains(ck_vobject::vscope*, const std::wstring&);
+		virtual bool     remove  (ck_vobject::vscope*, const std::wstring&);
+		virtual vobject* call    (ck_vobject::vscope*, const std::vector<vobject*>&);
+		
+		virtual void gc_trace(ck_core::gc_visitor&);
+		virtual void gc_finalize();
+		
+		// Channel functions only
+		
+		// Non-blocking send, returns 0 if channel is full.
+		// Throws if channel is closed.
+		bool try_send(ck_vobject::vobject* value);
+		
+		// Non-blocking receive, returns 0 if channel is empty
+		bool try_recv(ck_vobject::vobject*& value);
+		
+		// Waits till value is sent
+		void send(ck_vobject::vobject* value);
+		
+		// Waits for value. Returns 0 if channel is closed and empty.
+		bool recv(ck_vobject::vobject*& value);
+		
+		// No more values can be sent, parked threads are woken up
+		void close();
+		
+		inline bool is_closed() { return closed.load(std::memory_order_acquire); };
+		
+		// Amount of values in channel
+		int64_t size();
+		
+		inline uint64_t get_capacity() { return capacity; };
+		
+		// Waits for value on any of channels for timeout milliseconds, negative for no limit.
+		// Returns index of channel value was received from,
+		//  -1 if all channels are closed and empty, -2 on timeout.
+		static int select(const std::vector<Channel*>& channels, ck_vobject::vobject*& value, int64_t timeout = -1);
+		
+		// Must return integer representation of an object
+		virtual int64_t int_value();
+		
+		// Must return string representation of an object
+		virtual std::wstring string_value();
+		
+		// Called on interpreter start to initialize prototype
+		static vobject* create_proto();
+	};
+	
+	// Defined on interpreter start.
+	static CallableObject* ChannelProto = nullptr;
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+
+#include "Object.h"
+#include "CallableObject.h"
+#include "Mutex.h"
+
+namespace ck_objects {
+	
+	// Condition variable bound to Mutex.
+	// wait() releases the mutex, parks the thread till notification
+	//  and acquires the mutex again. Both wait and notify require owning the mutex.
+	class Condition : public ck_objects::Object {
+		
+	protected:
+		
+		Mutex* mutex;
+		
+		std::mutex              wait_mutex;
+		std::condition_variable wait_var;
+		
+		// Amount of parked threads and notifications not consumed by them
+		int waiters = 0;
+		int signals = 0;
+		
+	public:
+		
+		Condition(Mutex* mutex);
+		virtual ~Condition();
+		
+		virtual vobject* get     (ck_vobject::vscope*, const std::wstring&);
+		virtual void     put     (ck_vobject::vscope*, const std::wstring&, vobject*);
+		virtual bool     contains(ck_vobject::vscope*, const std::wstring&);
+		virtual bool     remove  (ck_vobject::vscope*, const std::wstring&);
+		virtual vobject* call    (ck_vobject::vscope*, const std::vector<vobject*>&);
+		
+		virtual void gc_trace(ck_core::gc_visitor&);
+		virtual void gc_finalize();
+		
+		// Condition functions only
+		
+		// Waits for notification at most timeout milliseconds, infinite if timeout < 0.
+		// Returns 0 on timeout.
+		bool wait(int64_t timeout);
+		
+		// Wakes one or all waiting threads
+		void notify(bool all);
+		
+		inline Mutex* get_mutex() { return mutex; };
+		
+		// Must return integer representation of an object
+		virtual int64_t int_value();
+		
+		// Must return string representation of an object
+		virtual std::wstring string_value();
+		
+		// Called on interpreter start to initialize prototype
+		static vobject* create_proto();
+	};
+	
+	// Defined on interpreter start.
+	static CallableObject* ConditionProto = nullptr;
+};
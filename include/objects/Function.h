@@ -33,7 +33,7 @@ namespace ck_objects {
 		// Returns binded reference of .this value
 		inline ck_vobject::vobject* get_bind() { return this_bind; };
 		
-		virtual void gc_mark();
+		virtual void gc_trace(ck_core::gc_visitor&);
 		
 		// Converts to string
 		virtual std::wstring string_value();
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+
+#include "Object.h"
+#include "CallableObject.h"
+
+namespace ck_objects {
+	
+	class Future;
+	class Array;
+	
+	// Action performed by future on completion
+	struct future_continuation {
+		enum continuation_type {
+			// Call callback with value and complete target with it's result
+			THEN,
+			// Store value in results[index], resolve target when all values are stored
+			ALL,
+			// Resolve target with first value, reject when all sources failed
+			ANY
+		};
+		
+		continuation_type    type;
+		Future*              target   = nullptr;
+		ck_vobject::vobject* callback = nullptr;
+		Array*               results  = nullptr;
+		int                  index    = 0;
+	};
+	
+	// Result of an asynchronous task.
+	// Future is completed once with value or with error,
+	//  waiting threads are marked as blocked and do not stall GIL lock requests.
+	class Future : public ck_objects::Object {
+		
+	protected:
+		
+		// Set to 1 when future is completed
+		std::atomic<bool> done = { 0 };
+		
+		// Result of the task
+		ck_vobject::vobject* value = nullptr;
+		
+		// Thrown object if task failed
+		ck_vobject::vobject* error = nullptr;
+		
+		// Waiters sleep on this condition
+		std::mutex              wait_mutex;
+		std::condition_variable wait_var;
+		
+		// Executed once by the completing thread
+		std::vector<future_continuation> continuations;
+		
+		// Amount of not completed sources of all() or any()
+		std::atomic<int> remaining = { 0 };
+		
+		// Runs continuations after completion
+		void complete();
+		
+		// Applies result of this future to continuation target
+		void run_continuation(const future_continuation& c);
+		
+		// Adds continuation or runs it if future is completed
+		void add_continuation(const future_continuation& c);
+		
+	public:
+		
+		Future();
+		virtual ~Future();
+		
+		virtual vobject* get     (ck_vobject::vscope*, const std::wstring&);
+		virtual void     put     (ck_vobject::vscope*, const std::wstring&, vobject*);
+		virtual bool     contains(ck_vobject::vscope*, const std::wstring&);
+		virtual bool     remove  (ck_vobject::vscope*, const std::wstring&);
+		virtual vobject* call    (ck_vobject::vscope*, const std::vector<vobject*>&);
+		
+		virtual void gc_trace(ck_core::gc_visitor&);
+		virtual void gc_finalize();
+		
+		// Future functions only
+		
+		inline bool is_done() { return done.load(std::memory_order_acquire); };
+		
+		// Complete future with value.
+		// Returns 0 if future was already completed.
+		bool resolve(ck_vobject::vobject* value);
+		
+		// Complete future with error.
+		// Returns 0 if future was already completed.
+		bool reject(ck_vobject::vobject* error);
+		
+		// Waits for completion at most timeout milliseconds, negative for no limit.
+		// Pool worker runs pending pool tasks while waiting.
+		// Returns 1 if future is completed.
+		bool wait(int64_t timeout = -1);
+		
+		// Returns future completed with result of callback(value).
+		// Error of this future is passed to returned future without calling callback.
+		// Callback is called by the thread completing this future.
+		Future* then(ck_vobject::vobject* callback);
+		
+		// Returns future resolved with array of values of all given futures, 
+		//  rejected with first error. Non-future values are used as is.
+		static Future* all(const std::vector<ck_vobject::vobject*>& futures);
+		
+		// Returns future resolved with the first value of given futures, 
+		//  rejected with last error if all of them failed.
+		static Future* any(const std::vector<ck_vobject::vobject*>& futures);
+		
+		// Waits for completion and returns value or throws error
+		ck_vobject::vobject* result();
+		
+		// Must return integer representation of an object
+		virtual int64_t int_value();
+		
+		// Must return string representation of an object
+		virtual std::wstring string_value();
+		
+		// Called on interpreter start to initialize prototype
+		static vobject* create_proto();
+	};
+	
+	// Defined on interpreter start.
+	static CallableObject* FutureProto = nullptr;
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+
+#include "Object.h"
+#include "CallableObject.h"
+#include "BytecodeFunction.h"
+#include "../executer.h"
+
+namespace ck_objects {
+	
+	// Result of calling function containing yield.
+	// Body is executed by next() till the next yield, then it's frame
+	//  (objects, scopes, try frames and pointer) is saved in generator
+	//  and native stack is unwound. Next call to next() restores the frame.
+	class Generator : public ck_objects::Object {
+		
+		// Executer saves and restores frame of generator
+		friend class ck_core::ck_executer;
+		
+	protected:
+		
+		BytecodeFunction*   function;
+		
+		// Scope with applied arguments
+		ck_vobject::vscope* scope;
+		
+		// Name of the function used in backtrace
+		std::wstring name;
+		
+		ck_core::generator_frame frame;
+		
+		std::atomic<int> state = { CREATED };
+		
+		// Index of the call frame while generator is running
+		int frame_id = -1;
+		
+	public:
+		
+		enum {
+			CREATED   = 0,
+			SUSPENDED = 1,
+			RUNNING   = 2,
+			DONE      = 3
+		};
+		
+		Generator(BytecodeFunction* function, ck_vobject::vscope* scope, const std::wstring& name);
+		virtual ~Generator();
+		
+		virtual vobject* get     (ck_vobject::vscope*, const std::wstring&);
+		virtual void     put     (ck_vobject::vscope*, const std::wstring&, vobject*);
+		virtual bool     contains(ck_vobject::vscope*, const std::wstring&);
+		virtual bool     remove  (ck_vobject::vscope*, const std::wstring&);
+		virtual vobject* call    (ck_vobject::vscope*, const std::vector<vobject*>&);
+		
+		virtual void gc_trace(ck_core::gc_visitor&);
+		virtual void gc_finalize();
+		
+		// Generator functions only
+		
+		// Resumes generator with value as result of the suspended yield.
+		// Returns yielded or returned value, done is set to 1 if generator returned.
+		vobject* next(vobject* value, bool& done);
+		
+		inline bool is_done() { return state.load(std::memory_order_acquire) == DONE; };
+		
+		// Must return integer representation of an object
+		virtual int64_t int_value();
+		
+		// Must return string representation of an object
+		virtual std::wstring string_value();
+		
+		// Called on interpreter start to initialize prototype
+		static vobject* create_proto();
+	};
+	
+	// Defined on interpreter start.
+	static CallableObject* GeneratorProto = nullptr;
+};
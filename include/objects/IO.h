@@ -0,0 +1,74 @@
+#pragma once
+
+#include <mutex>
+#include <cstdio>
+
+#include "Object.h"
+#include "CallableObject.h"
+#include "Future.h"
+
+namespace ck_objects {
+	
+	// Asynchronous stream over file descriptor.
+	// Operations are performed by event loop reactor, results are delivered
+	//  to the calling thread as completed futures and callbacks executed as late calls.
+	class IO : public ck_objects::Object {
+		
+	protected:
+		
+		int fd;
+		
+		// Process opened by popen(), closed with pclose()
+		FILE* process;
+		
+		// Descriptor is closed on finalization
+		bool owned;
+		
+		bool closed = 0;
+		
+		std::mutex close_mutex;
+		
+	public:
+		
+		IO(int fd, bool owned = 0, FILE* process = nullptr);
+		virtual ~IO();
+		
+		virtual vobject* get     (ck_vobject::vscope*, const std::wstring&);
+		virtual void     put     (ck_vobject::vscope*, const std::wstring&, vobject*);
+		virtual bool     contains(ck_vobject::vscope*, const std::wstring&);
+		virtual bool     remove  (ck_vobject::vscope*, const std::wstring&);
+		virtual vobject* call    (ck_vobject::vscope*, const std::vector<vobject*>&);
+		
+		virtual void gc_trace(ck_core::gc_visitor&);
+		virtual void gc_finalize();
+		
+		// IO functions only
+		
+		// Reads next chunk of data or all data till the end of input.
+		// Returned future is resolved with String, undefined on the end of input.
+		Future* read(bool all, ck_vobject::vobject* callback);
+		
+		// Writes whole string, returned future is resolved with amount of written bytes.
+		Future* write(const std::wstring& data, ck_vobject::vobject* callback);
+		
+		// Closes descriptor, pending operations fail.
+		// Returns exit status for process and 0 otherwise.
+		int close();
+		
+		inline bool is_closed() { return closed; };
+		
+		inline int get_fd() { return fd; };
+		
+		// Must return integer representation of an object
+		virtual int64_t int_value();
+		
+		// Must return string representation of an object
+		virtual std::wstring string_value();
+		
+		// Called on interpreter start to initialize prototype
+		static vobject* create_proto();
+	};
+	
+	// Defined on interpreter start.
+	static CallableObject* IOProto = nullptr;
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+#include "Object.h"
+#include "CallableObject.h"
+
+namespace ck_objects {
+	
+	// Bidirectional message stream between parent and isolate process.
+	// Each message is structured clone of value prefixed with 4-byte length.
+	struct isolate_channel {
+		int fd = -1;
+		
+		// Received bytes of incomplete message
+		std::string inbox;
+		
+		// Messages are sent and received by one thread at once
+		std::mutex write_mutex;
+		std::mutex read_mutex;
+		
+		// Encodes and sends value, throws IOError if channel is closed
+		void post(ck_vobject::vobject* value);
+		
+		// Waits for next message at most timeout milliseconds, infinite if timeout < 0.
+		// Returns nullptr on timeout and on closed channel.
+		ck_vobject::vobject* receive(int64_t timeout);
+		
+		void close();
+	};
+	
+	// Independent interpreter instance running script in child process.
+	// Isolates share no heap and no GIL with parent, so they execute in parallel,
+	//  values are passed between them as structured clones.
+	class Isolate : public ck_objects::Object {
+		
+	protected:
+		
+		pid_t pid;
+		
+		isolate_channel channel;
+		
+		// Process was waited for
+		bool joined = 0;
+		int  status = 0;
+		
+		std::mutex join_mutex;
+		
+	public:
+		
+		// Starts interpreter executing script with given arguments
+		Isolate(const std::string& path, const std::vector<std::string>& args);
+		virtual ~Isolate();
+		
+		virtual vobject* get     (ck_vobject::vscope*, const std::wstring&);
+		virtual void     put     (ck_vobject::vscope*, const std::wstring&, vobject*);
+		virtual bool     contains(ck_vobject::vscope*, const std::wstring&);
+		virtual bool     remove  (ck_vobject::vscope*, const std::wstring&);
+		virtual vobject* call    (ck_vobject::vscope*, const std::vector<vobject*>&);
+		
+		virtual void gc_trace(ck_core::gc_visitor&);
+		virtual void gc_finalize();
+		
+		// Isolate functions only
+		
+		inline void post(ck_vobject::vobject* value) { channel.post(value); };
+		
+		inline ck_vobject::vobject* receive(int64_t timeout) { return channel.receive(timeout); };
+		
+		// Sends signal to isolate process
+		void terminate(int signal);
+		
+		// Waits for isolate process exit and closes channel.
+		// Returns exit code or negated number of terminating signal.
+		int join();
+		
+		inline pid_t get_pid() { return pid; };
+		
+		// Returns channel to parent if this interpreter is running as isolate, nullptr otherwise
+		static isolate_channel* parent();
+		
+		// Must return integer representation of an object
+		virtual int64_t int_value();
+		
+		// Must return string representation of an object
+		virtual std::wstring string_value();
+		
+		// Called on interpreter start to initialize prototype
+		static vobject* create_proto();
+	};
+	
+	// Defined on interpreter start.
+	static CallableObject* IsolateProto = nullptr;
+};
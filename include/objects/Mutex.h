@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Object.h"
+#include "CallableObject.h"
+
+#include "../monitor.h"
+
+namespace ck_objects {
+	
+	// Reentrant lock owned by thread.
+	// Threads waiting for it are marked blocked and do not stall GIL lock requests.
+	class Mutex : public ck_objects::Object {
+		
+	protected:
+		
+		ck_core::monitor mon;
+		
+	public:
+		
+		Mutex();
+		virtual ~Mutex();
+		
+		virtual vobject* get     (ck_vobject::vscope*, const std::wstring&);
+		virtual void     put     (ck_vobject::vscope*, const std::wstring&, vobject*);
+		virtual bool     contains(ck_vobject::vscope*, const std::wstring&);
+		virtual bool     remove  (ck_vobject::vscope*, const std::wstring&);
+		virtual vobject* call    (ck_vobject::vscope*, const std::vector<vobject*>&);
+		
+		virtual void gc_trace(ck_core::gc_visitor&);
+		virtual void gc_finalize();
+		
+		// Mutex functions only
+		
+		inline ck_core::monitor& get_monitor() { return mon; };
+		
+		// Acquires monitor of object for synchronized statement.
+		// Mutex is locked itself, any other object gets monitor on demand.
+		// Throws if thread was stopped while waiting.
+		static void enter(ck_vobject::vobject* object);
+		
+		// Releases monitor acquired by enter()
+		static void exit(ck_vobject::vobject* object);
+		
+		// Must return integer representation of an object
+		virtual int64_t int_value();
+		
+		// Must return string representation of an object
+		virtual std::wstring string_value();
+		
+		// Called on interpreter start to initialize prototype
+		static vobject* create_proto();
+	};
+	
+	// Defined on interpreter start.
+	static CallableObject* MutexProto = nullptr;
+};
@@ -26,7 +26,7 @@ namespace ck_objects {
 		virtual bool     remove  (ck_vobject::vscope*, const std::wstring&);
 		virtual vobject* call    (ck_vobject::vscope*, const std::vector<vobject*>&);
 		
-		virtual void gc_mark();
+		virtual void gc_trace(ck_core::gc_visitor&);
 		
 		// Must return string representation of an object
 		virtual std::wstring string_value();
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <map>
+#include <atomic>
 
 #include "../vobject.h"
 
@@ -13,6 +14,21 @@ namespace ck_objects {	// WARNING: This and all standard objects uses prototype
 		// Map with all objects stored by this class instance.
 		std::map<std::wstring, ck_vobject::vobject*> objects;
 		
+		// Set when object fields become immutable.
+		// Frozen object is read without locking.
+		std::atomic<bool> frozen = { 0 };
+		
+		// Unsynchronized lookup in objects map
+		inline vobject* lookup(const std::wstring& name) {
+			std::map<std::wstring, ck_vobject::vobject*>::const_iterator pos = objects.find(name);
+			if (pos == objects.end())
+				return nullptr;
+			return pos->second;
+		};
+		
+		// Throws if object is frozen
+		void check_mutable();
+		
 	public:
 		
 		Object(const std::map<std::wstring, ck_vobject::vobject*>&);
@@ -25,7 +41,7 @@ namespace ck_objects {	// WARNING: This and all standard objects uses prototype
 		virtual bool     remove  (ck_vobject::vscope*, const std::wstring&);
 		virtual vobject* call    (ck_vobject::vscope*, const std::vector<vobject*>&);
 		
-		virtual void gc_mark();
+		virtual void gc_trace(ck_core::gc_visitor&);
 		virtual void gc_finalize();
 		
 		// Object functions only
@@ -39,6 +55,19 @@ namespace ck_objects {	// WARNING: This and all standard objects uses prototype
 		bool     contains(const std::wstring&);
 		bool     remove  (const std::wstring&);
 		
+		// Makes object fields immutable.
+		// Any following put() or remove() throws UnsupportedOperation.
+		void freeze();
+		
+		// Makes object mutable again.
+		// Allowed only before other threads are started because 
+		//  frozen objects are being read without locking.
+		void unfreeze();
+		
+		inline bool is_frozen() {
+			return frozen.load(std::memory_order_acquire);
+		};
+		
 		// Must return integer representation of an object
 		virtual int64_t int_value();
 		
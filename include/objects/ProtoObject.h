@@ -24,7 +24,7 @@ class ProtoObject<ProtoClass> : public vobject {
 	virtual bool     remove  (vscope*, const std::wstring&);
 	virtual vobject* call    (vscope*, const std::vector<vobject*>&);
 	
-	virtual void gc_mark();
+	virtual void gc_trace(ck_core::gc_visitor&);
 	virtual void gc_finalize();
 	
 	virtual int64_t int_value();
@@ -52,7 +52,7 @@ class Proto<ProtoProtoClass> : public vobject {
 	
 	virtual vobject* call    (vscope*, const std::vector<vobject*>&); // <-- only overridable
 	
-	virtual void gc_mark();
+	virtual void gc_trace(ck_core::gc_visitor&);
 	virtual void gc_finalize();
 	
 	virtual int64_t int_value();
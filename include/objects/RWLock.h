@@ -0,0 +1,68 @@
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+
+#include "Object.h"
+#include "CallableObject.h"
+#include "../GIL2.h"
+
+namespace ck_objects {
+	
+	// Lock shared by readers and exclusive for a single writer.
+	// Waiting writer blocks new readers, so writers are not starved.
+	// Write lock is reentrant and allows taking read lock by the same thread,
+	//  read lock is not reentrant while writer waits.
+	class RWLock : public ck_objects::Object {
+		
+	protected:
+		
+		std::mutex              mutex;
+		std::condition_variable var;
+		
+		int readers = 0;
+		
+		// Writer thread and it's recursion depth
+		ck_core::gil_thread* writer = nullptr;
+		int writes = 0;
+		
+		int waiting_writers = 0;
+		
+	public:
+		
+		RWLock();
+		virtual ~RWLock();
+		
+		virtual vobject* get     (ck_vobject::vscope*, const std::wstring&);
+		virtual void     put     (ck_vobject::vscope*, const std::wstring&, vobject*);
+		virtual bool     contains(ck_vobject::vscope*, const std::wstring&);
+		virtual bool     remove  (ck_vobject::vscope*, const std::wstring&);
+		virtual vobject* call    (ck_vobject::vscope*, const std::vector<vobject*>&);
+		
+		virtual void gc_trace(ck_core::gc_visitor&);
+		virtual void gc_finalize();
+		
+		// RWLock functions only
+		
+		// Acquire lock waiting at most timeout milliseconds, infinite if timeout < 0.
+		// Return 0 on timeout or if thread was stopped.
+		bool read_lock(int64_t timeout);
+		bool write_lock(int64_t timeout);
+		
+		// Return 0 if lock was not held
+		bool read_unlock();
+		bool write_unlock();
+		
+		// Must return integer representation of an object
+		virtual int64_t int_value();
+		
+		// Must return string representation of an object
+		virtual std::wstring string_value();
+		
+		// Called on interpreter start to initialize prototype
+		static vobject* create_proto();
+	};
+	
+	// Defined on interpreter start.
+	static CallableObject* RWLockProto = nullptr;
+};
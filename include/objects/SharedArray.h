@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+
+#include "Object.h"
+#include "CallableObject.h"
+
+namespace ck_objects {
+	
+	// Fixed size array of 64-bit numbers stored in single flat buffer.
+	// Elements are read and written atomically without locking, so the
+	//  array can be shared by threads. Double elements are stored as bits.
+	// Script sees it as SharedInt64Array or SharedFloat64Array.
+	class SharedArray : public ck_objects::Object {
+		
+	protected:
+		
+		std::atomic<int64_t>* data;
+		int64_t length;
+		
+		// Elements are Double
+		bool floating;
+		
+	public:
+		
+		SharedArray(int64_t length, bool floating);
+		virtual ~SharedArray();
+		
+		virtual vobject* get     (ck_vobject::vscope*, const std::wstring&);
+		virtual void     put     (ck_vobject::vscope*, const std::wstring&, vobject*);
+		virtual bool     contains(ck_vobject::vscope*, const std::wstring&);
+		virtual bool     remove  (ck_vobject::vscope*, const std::wstring&);
+		virtual vobject* call    (ck_vobject::vscope*, const std::vector<vobject*>&);
+		
+		virtual void gc_trace(ck_core::gc_visitor&);
+		virtual void gc_finalize();
+		
+		// SharedArray functions only
+		
+		inline int64_t size() { return length; };
+		
+		inline bool is_floating() { return floating; };
+		
+		// Returns element at index, negative index counts from the end.
+		// Throws RangeError if index is out of bounds.
+		std::atomic<int64_t>& at(int64_t index);
+		
+		// Converts number to element bits, throws TypeError for non-number
+		int64_t to_bits(vobject* value);
+		
+		// Converts element bits to Int or Double
+		vobject* from_bits(int64_t bits);
+		
+		// Must return integer representation of an object
+		virtual int64_t int_value();
+		
+		// Must return string representation of an object
+		virtual std::wstring string_value();
+		
+		// Called on interpreter start to initialize prototypes
+		static vobject* create_int64_proto();
+		static vobject* create_float64_proto();
+		
+		// Returns Atomics object with operations on elements
+		static vobject* create_atomics();
+	};
+	
+	// Defined on interpreter start.
+	static CallableObject* SharedInt64ArrayProto   = nullptr;
+	static CallableObject* SharedFloat64ArrayProto = nullptr;
+};
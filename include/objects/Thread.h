@@ -4,6 +4,7 @@
 
 #include "Object.h"
 #include "CallableObject.h"
+#include "Future.h"
 #include "../GIL2.h"
 
 namespace ck_objects {	
@@ -15,6 +16,10 @@ namespace ck_objects {
 		// Id of binded thread
 		uint64_t thread_id;
 		
+		// Completed with result of thread runnable, 
+		//  nullptr if object does not own the thread.
+		Future* result = nullptr;
+		
 	public:
 	
 		// Bind thread id instance to this object, no check
@@ -31,7 +36,7 @@ namespace ck_objects {
 		virtual bool     remove  (ck_vobject::vscope*, const std::wstring&);
 		virtual vobject* call    (ck_vobject::vscope*, const std::vector<vobject*>&);
 		
-		virtual void gc_mark();
+		virtual void gc_trace(ck_core::gc_visitor&);
 		virtual void gc_finalize();
 		
 		// Thread functions only
@@ -39,6 +44,9 @@ namespace ck_objects {
 		inline void bind_id(uint64_t tid) { thread_id = tid; };
 		inline uint64_t get_id() { return thread_id; };
 		
+		inline void bind_result(Future* f) { result = f; };
+		inline Future* get_result() { return result; };
+		
 		// Must return integer representation of an object
 		virtual int64_t int_value();
 		
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <condition_variable>
+
+#include "Object.h"
+#include "CallableObject.h"
+#include "Future.h"
+#include "../vscope.h"
+#include "../GIL2.h"
+
+namespace ck_objects {
+	
+	// Single task submitted to pool
+	struct pool_task {
+		ck_vobject::vobject*              runnable = nullptr;
+		std::vector<ck_vobject::vobject*> args;
+		Future*                           future   = nullptr;
+	};
+	
+	// Task queue of single worker.
+	// Owner pushes and pops tasks from the back,
+	//  idle workers steal tasks from the front.
+	struct pool_worker {
+		std::mutex            mutex;
+		std::deque<pool_task> tasks;
+		
+		// Thread of the worker, nullptr if not running
+		ck_core::gil_thread*  thread = nullptr;
+	};
+	
+	class ThreadPool;
+	
+	// Native part of ThreadPool shared by pool object and it's workers.
+	// Workers keep it alive after pool object is collected, so they are 
+	//  able to exit without touching the object.
+	struct pool_state {
+		std::vector<pool_worker*> workers;
+		
+		// Tasks submitted from outside of the pool, taken in FIFO order
+		pool_worker injected;
+		
+		// Amount of queued tasks in all deques
+		std::atomic<int64_t> pending = { 0 };
+		
+		// Amount of started and not finished workers
+		std::atomic<int> alive = { 0 };
+		
+		// Set by shutdown(), workers exit when queues are empty
+		std::atomic<bool> stopping = { 0 };
+		
+		// Set on interpreter exit, workers exit without running queued tasks
+		std::atomic<bool> terminating = { 0 };
+		
+		// Idle workers sleep on this condition
+		std::mutex              idle_mutex;
+		std::condition_variable idle_var;
+		
+		// Scope tasks are executed in, traced by owner
+		ck_vobject::vscope* scope = nullptr;
+		
+		// Pool object, rooted while it has queued or running tasks
+		ThreadPool* owner = nullptr;
+		
+		// Amount of queued and running tasks
+		std::atomic<int64_t> busy = { 0 };
+		
+		~pool_state();
+		
+		// Worker thread body
+		void work(int index);
+		
+		// Takes task from own deque, shared queue or steals from other workers
+		bool take(int index, pool_task& task);
+		
+		// Executes task and completes it's future
+		void run(pool_task& task);
+		
+		// Wakes idle workers
+		void wake_all();
+		
+		// Called on task submit and completion, roots owner while pool is busy
+		void acquire();
+		void release();
+	};
+	
+	// Fixed set of daemon threads executing submitted tasks.
+	// Each worker owns a task deque and steals from other workers when it
+	//  is empty. Executer and stack of the worker are reused by all tasks.
+	// Pool is kept alive while it has queued or running tasks. 
+	//  Workers of collected pool exit.
+	class ThreadPool : public ck_objects::Object {
+		
+	protected:
+		
+		std::shared_ptr<pool_state> state;
+		
+	public:
+		
+		// Spawns given amount of workers
+		ThreadPool(ck_vobject::vscope* scope, int size);
+		virtual ~ThreadPool();
+		
+		virtual vobject* get     (ck_vobject::vscope*, const std::wstring&);
+		virtual void     put     (ck_vobject::vscope*, const std::wstring&, vobject*);
+		virtual bool     contains(ck_vobject::vscope*, const std::wstring&);
+		virtual bool     remove  (ck_vobject::vscope*, const std::wstring&);
+		virtual vobject* call    (ck_vobject::vscope*, const std::vector<vobject*>&);
+		
+		virtual void gc_trace(ck_core::gc_visitor&);
+		virtual void gc_finalize();
+		
+		// ThreadPool functions only
+		
+		inline int size() { return state->workers.size(); };
+		
+		// Queues task and returns it's future.
+		// Task submitted by pool worker is pushed to the worker own deque.
+		Future* submit(ck_vobject::vobject* runnable, const std::vector<ck_vobject::vobject*>& args);
+		
+		// Stop accepting tasks, workers exit after queued tasks are done
+		void shutdown();
+		
+		// Called by pool worker waiting for a future.
+		// Runs single queued task of the current worker pool.
+		// Returns 0 if current thread is not a worker or there is no tasks.
+		static bool help();
+		
+		// Returns 1 if current thread is a pool worker
+		static bool is_worker();
+		
+		// Shared pool with worker per hardware thread, started on the first call.
+		// Used by parallel Array operations.
+		static ThreadPool* common(ck_vobject::vscope* scope);
+		
+		// Called on interpreter exit.
+		// Stops all pools, queued tasks are dropped.
+		static void shutdown_all();
+		
+		// Must return integer representation of an object
+		virtual int64_t int_value();
+		
+		// Must return string representation of an object
+		virtual std::wstring string_value();
+		
+		// Called on interpreter start to initialize prototype
+		static vobject* create_proto();
+	};
+	
+	// Defined on interpreter start.
+	static CallableObject* ThreadPoolProto = nullptr;
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <unordered_map>
+
+#include "Object.h"
+#include "CallableObject.h"
+
+namespace ck_objects {	
+
+	// Map with weak object keys.
+	// Value is kept alive only while it's key is reachable (ephemeron).
+	// Entries with unreachable keys are removed by GC.
+	class WeakMap : public ck_objects::Object {
+		
+	protected:
+		
+		// Entries by key identity
+		std::unordered_map<ck_vobject::vobject*, ck_vobject::vobject*> entries;
+		
+	public:
+	
+		WeakMap();
+		virtual ~WeakMap();
+		
+		virtual vobject* get     (ck_vobject::vscope*, const std::wstring&);
+		virtual void     put     (ck_vobject::vscope*, const std::wstring&, vobject*);
+		virtual bool     contains(ck_vobject::vscope*, const std::wstring&);
+		virtual bool     remove  (ck_vobject::vscope*, const std::wstring&);
+		virtual vobject* call    (ck_vobject::vscope*, const std::vector<vobject*>&);
+		
+		virtual void gc_trace(ck_core::gc_visitor&);
+		virtual void gc_finalize();
+		virtual void gc_trace_weak(ck_core::gc_visitor&);
+		virtual void gc_clear_weak();
+		
+		// WeakMap functions only
+		
+		// Returns value by key or nullptr
+		vobject* get_entry(vobject* key);
+		void     set_entry(vobject* key, vobject* value);
+		bool     has_entry(vobject* key);
+		bool     remove_entry(vobject* key);
+		void     clear_entries();
+		int      size();
+		
+		// Must return integer representation of an object
+		virtual int64_t int_value();
+		
+		// Must return string representation of an object
+		virtual std::wstring string_value();
+		
+		// Called on interpreter start to initialize prototype
+		static vobject* create_proto();
+	};
+	
+	// Defined on interpreter start.
+	static CallableObject* WeakMapProto = nullptr;
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Object.h"
+#include "CallableObject.h"
+
+namespace ck_objects {	
+
+	// Weak reference to an object. 
+	// Referenced object is not kept alive and is cleared by GC when 
+	//  it is not reachable by strong references.
+	class WeakRef : public ck_objects::Object {
+		
+	protected:
+		
+		// Weak referenced object, not traced
+		ck_vobject::vobject* target;
+		
+		// Called with this WeakRef after target was collected
+		ck_vobject::vobject* callback;
+		
+	public:
+	
+		WeakRef(ck_vobject::vobject* target, ck_vobject::vobject* callback = nullptr);
+		virtual ~WeakRef();
+		
+		virtual vobject* get     (ck_vobject::vscope*, const std::wstring&);
+		virtual void     put     (ck_vobject::vscope*, const std::wstring&, vobject*);
+		virtual bool     contains(ck_vobject::vscope*, const std::wstring&);
+		virtual bool     remove  (ck_vobject::vscope*, const std::wstring&);
+		virtual vobject* call    (ck_vobject::vscope*, const std::vector<vobject*>&);
+		
+		virtual void gc_trace(ck_core::gc_visitor&);
+		virtual void gc_finalize();
+		virtual void gc_clear_weak();
+		
+		// WeakRef functions only
+		
+		// Returns target or nullptr if it was collected
+		inline ck_vobject::vobject* get_target() { return target; };
+		
+		// Drops target without calling callback
+		inline void clear() { target = nullptr; callback = nullptr; };
+		
+		// Must return integer representation of an object
+		virtual int64_t int_value();
+		
+		// Must return string representation of an object
+		virtual std::wstring string_value();
+		
+		// Called on interpreter start to initialize prototype
+		static vobject* create_proto();
+	};
+	
+	// Defined on interpreter start.
+	static CallableObject* WeakRefProto = nullptr;
+};
@@ -68,6 +68,7 @@ namespace ck_parser {
 				case ck_token::THIS : os << "this"; break;
 				case ck_token::WITH : os << "with"; break;
 				case ck_token::TYPEOF : os << "typeof"; break;
+				case ck_token::SYNCHRONIZED : os << "synchronized"; break;
 				case ck_token::AS : os << "as"; break;
 				case ck_token::ISTYPEOF : os << "istypeof"; break;
 				case ck_token::ASSIGN : os << "="; break;
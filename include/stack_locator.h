@@ -7,7 +7,7 @@
 #include "ck_platform.h"
 
 // Utility used to move execution stack.
-// Allocates requered space in heap, stores ESP of current
+// Allocates requered space from stack pool, stores ESP of current
 //  stack & does migrating of stack.
 namespace ck_core {
 	namespace stack_locator {
@@ -35,6 +35,8 @@ namespace ck_core {
 			type_int new_esp   = 0;
 			// Size of newly allocated stack
 			type_int new_size  = 0;
+			// Size of mapping containing stack and guard area below it
+			type_int map_size  = 0;
 
 			// Stack arguments
 
@@ -51,6 +53,24 @@ namespace ck_core {
 		// Vector of all descriptors
 		thread_local extern std::vector<stack_descriptor> descriptors;
 
+		// Size of inaccessible area below each stack.
+		// Overflow faults on it instead of corrupting neighbour memory.
+		const size_t guard_size = 64 * 1024;
+		
+		// Maximal amount of released stacks kept for reuse
+		const int pool_limit = 16;
+		
+		// Assigns stack of at least stack_size bytes to descriptor.
+		// Released stack of the same size is reused, otherwise new one is
+		//  mapped with guard area and committed lazily on first touch.
+		// Returns 0 on fail.
+		bool allocate_stack(stack_descriptor& descriptor, size_t stack_size);
+		
+		// Returns stack of descriptor to the pool or unmaps it if pool is full.
+		// Pages of pooled stack are returned to the system except the top
+		//  part used by every call.
+		void release_stack(const stack_descriptor& descriptor);
+		
 		// Macro for performing stack replacement
 		// _argc - amount of the arguments for _wrap_function
 		// _argv - argument array pointer for _wrap_function
@@ -64,9 +84,7 @@ namespace ck_core {
 			stack_descriptor descriptor;
 			
 			// Allocate required stack size and align by 0xF
-			descriptor.new_size  = (8 * 1024 * 1024 < (stack_size) ? (stack_size) : 8 * 1024 * 1024);
-			descriptor.new_stack = (type_int) (uintptr_t) malloc((size_t) descriptor.new_size);
-			if (!descriptor.new_stack)
+			if (!allocate_stack(descriptor, 8 * 1024 * 1024 < (stack_size) ? (stack_size) : 8 * 1024 * 1024))
 				return 0;
 			
 			// Align new stack by 0xF
@@ -141,7 +159,7 @@ namespace ck_core {
 			// Dispose descriptor & attached memory
 			descriptors.pop_back();
 			
-			free((void*) (uintptr_t) descriptor.new_stack);
+			release_stack(descriptor);
 			
 			// Return exception state
 			return !descriptor.exception_handled;
@@ -170,12 +188,14 @@ namespace ck_core {
 		};
 		
 		// Returns remaining stack size for current descriptor.
+		// Measured down to the bottom of the stack mapping.
 		// Returns 0 if stack was not replaced.
 		inline type_int get_stack_remaining() {
 			if (descriptors.size()) {
 				char dummy = 0;
+				type_int position = (type_int) (uintptr_t) &dummy;
 
-				return descriptors.back().new_size - (type_int) (uintptr_t) (descriptors.back().new_esp - (type_int) (uintptr_t) &dummy);
+				return position > descriptors.back().new_stack ? position - descriptors.back().new_stack : 0;
 			}
 
 			return 0;
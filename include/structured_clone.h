@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+
+namespace ck_vobject {
+	class vobject;
+};
+
+namespace ck_core {
+	
+	// Serialization of values passed between interpreter instances.
+	// Supports Undefined, Null, Bool, Int, Double, String, Array and plain Object.
+	// Shared references and cycles are preserved, any other value throws TypeError.
+	namespace structured_clone {
+		
+		// Encodes value graph into byte string
+		std::string serialize(ck_vobject::vobject* value);
+		
+		// Decodes value graph produced by serialize().
+		// Throws TypeError on malformed input.
+		ck_vobject::vobject* deserialize(const std::string& data);
+	};
+};
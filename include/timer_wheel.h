@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace ck_core {
+	
+	struct io_request;
+	
+	// Single timer linked into slot of timer_wheel
+	struct timer_entry {
+		// Tick of expiration
+		uint64_t deadline = 0;
+		
+		timer_entry* prev = nullptr;
+		timer_entry* next = nullptr;
+		
+		// Slot list containing entry, nullptr if entry is not in wheel
+		timer_entry** slot = nullptr;
+		
+		// Request completed on expiration
+		io_request* request = nullptr;
+	};
+	
+	// Hierarchical timing wheel.
+	// Level 0 slots hold timers expiring in the next 64 ticks, each next level
+	//  covers 64 times longer range with 64 times wider slots. When lower level
+	//  finishes a round, matching slot of the upper level is cascaded down.
+	// Insertion and removal are O(1), advance is O(1) per tick and expired timer.
+	// Not thread-safe, guarded by owner.
+	class timer_wheel {
+		
+		static const int LEVEL_BITS = 6;
+		static const int SLOTS      = 1 << LEVEL_BITS;
+		static const int LEVELS     = 4;
+		
+		// Heads of slot lists
+		timer_entry* slots[LEVELS][SLOTS] = {};
+		
+		// Last processed tick
+		uint64_t current;
+		
+		int count = 0;
+		
+		// Unlinks all entries of slot and inserts them again relative to current tick
+		void cascade(int level, int index);
+		
+	public:
+		
+		timer_wheel(uint64_t current = 0) : current(current) {};
+		
+		// Links entry into slot matching it's deadline.
+		// Deadline in the past expires on the next tick.
+		void insert(timer_entry* entry);
+		
+		// Unlinks entry if it is in wheel
+		void remove(timer_entry* entry);
+		
+		// Processes ticks till now, expired entries are unlinked and appended to expired
+		void advance(uint64_t now, std::vector<timer_entry*>& expired);
+		
+		// Returns amount of ticks till the next slot has to be processed, -1 if wheel is empty
+		int64_t next_timeout();
+		
+		inline int size() { return count; };
+		
+		inline uint64_t get_current() { return current; };
+	};
+};
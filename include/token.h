@@ -39,6 +39,8 @@ namespace ck_token {
 	const int TYPEOF         = 73;
 	const int ISTYPEOF       = 74;
 	const int AS             = 75;
+	const int YIELD          = 76;
+	const int SYNCHRONIZED   = 77;
 	
 	// Cupcake operators
 	const int ASSIGN         =  90; // =
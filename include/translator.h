@@ -52,6 +52,11 @@ namespace ck_bytecodes {
 	
 	const int CONTAINS_KEY         = 55; // stack.top->contains(key)
 	
+	const int YIELD                = 56; // Suspend generator with [top] value
+	const int PUSH_CONST_GENERATOR = 57; // Push BytecodeFunction of generator, same layout as PUSH_CONST_FUNCTION
+	const int VSTATE_PUSH_MONITOR  = 58; // Acquire monitor of [top] and push monitor frame
+	const int VSTATE_POP_MONITOR   = 59; // Pop monitor frame and release monitor
+	
 	const int OPT_ADD      = 1;
 	const int OPT_SUB      = 2;
 	const int OPT_MUL      = 3;
@@ -99,6 +104,11 @@ namespace ck_bytecodes {
 	const int TRY_NO_CATCH = 1;
 	const int TRY_NO_ARG   = 2;
 	const int TRY_WITH_ARG = 3;
+	
+	// Frame of synchronized block, holds monitor instead of catch block.
+	// Monitor is released when frame is popped by VSTATE_POP_MONITOR,
+	//  exception, return or restoring enclosing frame.
+	const int TRY_MONITOR  = 4;
 };
 
 namespace ck_translator {
@@ -115,9 +125,10 @@ namespace ck_translator {
 	void translate(std::vector<unsigned char>& bytemap, std::vector<int>& lineno_table, ck_ast::ASTNode* n);
 	
 	// performs translate AST into function body, used in eval()
-	void translate_function(ck_bytecode& bytecode, ck_ast::ASTNode* n);
+	// Returns 1 if body contains yield and function is a generator.
+	bool translate_function(ck_bytecode& bytecode, ck_ast::ASTNode* n);
 	
-	void translate_function(std::vector<unsigned char>& bytemap, std::vector<int>& lineno_table, ck_ast::ASTNode* n);
+	bool translate_function(std::vector<unsigned char>& bytemap, std::vector<int>& lineno_table, ck_ast::ASTNode* n);
 	
 	void print(std::vector<unsigned char>& bytemap, int off = 0, int offset = -1, int limit = -1);
 	
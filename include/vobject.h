@@ -3,6 +3,9 @@
 #include <string>
 #include <vector>
 #include <thread>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
 
 #include "GC.h"
 
@@ -26,7 +29,7 @@ namespace ck_vobject {
 		virtual bool     remove  (vscope*, const std::wstring&);
 		virtual vobject* call    (vscope*, const std::vector<vobject*>&);
 		
-		virtual void gc_mark();
+		virtual void gc_trace(ck_core::gc_visitor&);
 		virtual void gc_finalize();
 		
 		// Utility to convert between types and determine storage type.
@@ -58,13 +61,16 @@ namespace ck_vobject {
 			
 		public:
 		
+			// Lock is skipped in single-threaded mode
 			vslock(vsobject* o) {
-				this->o = o;
-				this->o->lock();
+				this->o = ck_core::is_multithreaded() ? o : nullptr;
+				if (this->o)
+					this->o->lock();
 			};
 			
 			~vslock() {
-				o->unlock();
+				if (o)
+					o->unlock();
 			};
 		#else
 	
@@ -78,25 +84,54 @@ namespace ck_vobject {
 		
 		#ifndef CK_SINGLETHREAD
 			
-			// Synchronization mutex.
-			//  The default type of this mutex is recursive_mutex
-			std::recursive_mutex lock_mutex;
+			virtual ~vsobject();
+			
+		private:
+			
+			// Lock word states:
+			//  0                          - unlocked
+			//  owner << 16 | count << 1   - thin lock owned by thread with given token, 
+			//                               count is recursion depth
+			//  monitor | 1                - inflated lock, monitor is a mutex allocated on contention
+			std::atomic<uint64_t> lock_word = { 0 };
+			
+			static const uint64_t LOCK_INFLATED    = 1;
+			static const uint64_t LOCK_COUNT_ONE   = 1 << 1;
+			static const uint64_t LOCK_COUNT_MASK  = 0xFFFE;
+			static const int      LOCK_OWNER_SHIFT = 16;
+			
+			// Token of the current thread, unique for each thread
+			static thread_local uint64_t lock_token;
+			
+			// Returns token of the current thread shifted to owner position
+			static uint64_t lock_owner();
+			
+			// Called on contention, recursion overflow or inflated lock
+			void lock_slow();
+			void unlock_slow();
+			
+			// Replaces thin lock owned by current thread with monitor
+			void inflate(uint64_t word);
 			
 		protected:
 			
 			// Synchronization methods.
 			//  must be called on any access to object's fields inside 
 			//  of get/put/call/contains/remode, e.t.c.
+			// Uncontended lock is a single CAS on lock word, 
+			//  real mutex is created only when other thread waits for the object.
 			inline void lock() {
-				lock_mutex.lock();
+				uint64_t expected = 0;
+				if (!lock_word.compare_exchange_strong(expected, lock_owner() | LOCK_COUNT_ONE, std::memory_order_acquire, std::memory_order_relaxed))
+					lock_slow();
 			};
 			
 			inline void unlock() {
-				lock_mutex.unlock();
-			};
-			
-			inline std::recursive_mutex& mutex() {
-				return lock_mutex;
+				uint64_t word = lock_word.load(std::memory_order_relaxed);
+				if ((word & (LOCK_INFLATED | LOCK_COUNT_MASK)) == LOCK_COUNT_ONE)
+					lock_word.store(0, std::memory_order_release);
+				else
+					unlock_slow();
 			};
 		
 		#else
@@ -37,7 +37,7 @@ namespace ck_vobject {
 		// Unmakes scope being gc_root
 		virtual void unroot() = 0;
 		
-		virtual void gc_mark() = 0;
+		virtual void gc_trace(ck_core::gc_visitor&) = 0;
 		virtual void gc_finalize() = 0;
 		
 		// Must return integer representation of an object
@@ -94,7 +94,7 @@ namespace ck_vobject {
 		// Unmakes scope being gc_root
 		void unroot();
 		
-		virtual void gc_mark();
+		virtual void gc_trace(ck_core::gc_visitor&);
 		virtual void gc_finalize();
 		
 		// Must return integer representation of an object
@@ -164,7 +164,7 @@ namespace ck_vobject {
 		// Unmakes scope being gc_root
 		void unroot();
 		
-		virtual void gc_mark();
+		virtual void gc_trace(ck_core::gc_visitor&);
 		virtual void gc_finalize();
 		
 		// Must return integer representation of an object
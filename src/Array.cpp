@@ -2,17 +2,23 @@
 
 #include <string>
 #include <sstream>
+#include <thread>
+#include <algorithm>
 
 #include "exceptions.h"
 #include "GIL2.h"
+#include "executer.h"
 
 #include "objects/Object.h"
 #include "objects/Array.h"
 #include "objects/Bool.h"
 #include "objects/Int.h"
+#include "objects/Double.h"
 #include "objects/NativeFunction.h"
 #include "objects/Undefined.h"
 #include "objects/String.h"
+#include "objects/Future.h"
+#include "objects/ThreadPool.h"
 
 using namespace std;
 using namespace ck_exceptions;
@@ -25,6 +31,172 @@ static vobject* call_handler(vscope* scope, const vector<vobject*>& args) {
 	return new Array(args);
 };
 
+
+// P A R A L L E L _ O P E R A T I O N S
+
+// Arrays shorter than this are processed by the calling thread
+static const int64_t PARALLEL_MIN_SIZE = 2048;
+
+// Smallest range passed to single pool task
+static const int64_t PARALLEL_MIN_CHUNK = 512;
+
+// Smallest range sorted or summed by single native thread
+static const int64_t NATIVE_MIN_CHUNK = 1 << 15;
+
+// Pool tasks processing single range, arguments are (fn, src, start, end, ...)
+static NativeFunction* map_task    = nullptr;
+static NativeFunction* filter_task = nullptr;
+static NativeFunction* reduce_task = nullptr;
+static NativeFunction* sort_task   = nullptr;
+static NativeFunction* merge_task  = nullptr;
+
+// Splits [0, size) into ranges, few per worker to balance uneven callbacks
+static vector<pair<int64_t, int64_t>> split_ranges(int64_t size, int64_t min_chunk, int workers) {
+	int64_t count = size < PARALLEL_MIN_SIZE ? 1 : std::max<int64_t>(1, std::min<int64_t>(workers * 4, size / min_chunk));
+	
+	vector<pair<int64_t, int64_t>> ranges;
+	for (int64_t i = 0; i < count; ++i)
+		ranges.push_back({ size * i / count, size * (i + 1) / count });
+	return ranges;
+};
+
+// Runs task for each argument list on the shared pool and waits for all of them.
+// Single task is executed by the calling thread.
+// Throws first error thrown by tasks. Futures are kept in handles.
+static vector<vobject*> run_tasks(vscope* scope, gc_handle_scope& handles, NativeFunction* task, const vector<vector<vobject*>>& tasks) {
+	vector<vobject*> results;
+	
+	if (tasks.size() == 1) {
+		results.push_back(GIL::executer_instance()->call_object(task, nullptr, tasks[0], L"<parallel_task>"));
+		return results;
+	}
+	
+	ThreadPool* pool = ThreadPool::common(scope);
+	
+	vector<Future*> futures;
+	for (int i = 0; i < tasks.size(); ++i) {
+		futures.push_back(pool->submit(task, tasks[i]));
+		handles.add(futures.back());
+	}
+	
+	// Ranges are written by tasks, so all of them must finish before error is thrown
+	for (int i = 0; i < futures.size(); ++i)
+		futures[i]->wait();
+	
+	for (int i = 0; i < futures.size(); ++i)
+		results.push_back(futures[i]->result());
+	
+	return results;
+};
+
+// Returns copy of elements taken under lock of array
+static Array* snapshot(Array* a) {
+	vsobject::vslock lk(a);
+	return new Array(a->items());
+};
+
+// Calls fn from parallel operation
+static inline vobject* call_fn(vobject* fn, const vector<vobject*>& args, const wchar_t* name) {
+	vobject* result = GIL::executer_instance()->call_object(fn, nullptr, args, name);
+	return result ? result : Undefined::instance();
+};
+
+// Comparator of parallelSort, fn(a, b) returns negative number or true if a is less than b
+struct fn_less {
+	vobject* fn;
+	
+	inline bool operator()(vobject* a, vobject* b) const {
+		vobject* result = call_fn(fn, { a, b }, L"<parallel_sort>");
+		
+		if (result->as_type<Int>())
+			return static_cast<Int*>(result)->value() < 0;
+		if (result->as_type<Double>())
+			return static_cast<Double*>(result)->value() < 0;
+		if (result->as_type<Bool>())
+			return static_cast<Bool*>(result)->value();
+		
+		throw TypeError(L"Array.parallelSort comparator expected to return number or bool");
+	};
+};
+
+// Runs body(part) for each part on separate native thread, part 0 is run by calling thread.
+// Body must not allocate objects or execute script code.
+template<typename F>
+static void native_parallel(int parts, const F& body) {
+	vector<std::thread> threads;
+	for (int i = 1; i < parts; ++i)
+		threads.emplace_back(body, i);
+	
+	body(0);
+	
+	for (int i = 0; i < threads.size(); ++i)
+		threads[i].join();
+};
+
+// Sorts (key, value) pairs by key using native threads.
+// Each part is sorted separately, then sorted runs are merged pairwise.
+template<typename K>
+static void native_sort(vector<pair<K, vobject*>>& items) {
+	typedef pair<K, vobject*> item;
+	auto less = [](const item& a, const item& b) -> bool { return a.first < b.first; };
+	
+	int64_t size  = items.size();
+	int64_t parts = std::max<int64_t>(1, std::min<int64_t>(std::thread::hardware_concurrency(), size / NATIVE_MIN_CHUNK));
+	
+	vector<int64_t> bounds;
+	for (int64_t i = 0; i <= parts; ++i)
+		bounds.push_back(size * i / parts);
+	
+	native_parallel(parts, [&](int part) {
+		std::stable_sort(items.begin() + bounds[part], items.begin() + bounds[part + 1], less);
+	});
+	
+	// Merge neighbour runs till single run is left
+	while (bounds.size() > 2) {
+		vector<int64_t> merged;
+		int64_t pairs = (bounds.size() - 1) / 2;
+		
+		native_parallel(pairs, [&](int pair) {
+			std::inplace_merge(items.begin() + bounds[pair * 2], items.begin() + bounds[pair * 2 + 1], items.begin() + bounds[pair * 2 + 2], less);
+		});
+		
+		for (int64_t i = 0; i < bounds.size(); i += 2)
+			merged.push_back(bounds[i]);
+		if (merged.back() != size)
+			merged.push_back(size);
+		
+		bounds.swap(merged);
+	}
+};
+
+// Returns list of task arguments (fn, src, start, end, extra...) for each range
+static vector<vector<vobject*>> range_tasks(vobject* fn, Array* src, const vector<pair<int64_t, int64_t>>& ranges, const vector<vobject*>& extra = {}) {
+	vector<vector<vobject*>> tasks;
+	for (int i = 0; i < ranges.size(); ++i) {
+		vector<vobject*> args = { fn, src, new Int(ranges[i].first), new Int(ranges[i].second) };
+		args.insert(args.end(), extra.begin(), extra.end());
+		tasks.push_back(args);
+	}
+	return tasks;
+};
+
+// Validates function argument of parallel operation
+static vobject* expect_function(const vector<vobject*>& args, const wchar_t* name) {
+	if (!args.size() || !args[0] || args[0]->as_type<Undefined>())
+		throw IllegalArgumentError(std::wstring(L"Array.") + name + L" expected function");
+	return args[0];
+};
+
+// Replaces elements of array with sorted values
+template<typename K>
+static void store_sorted(Array* a, vector<pair<K, vobject*>>& items) {
+	vsobject::vslock lk(a);
+	
+	a->items().resize(items.size());
+	for (int64_t i = 0; i < items.size(); ++i)
+		a->items()[i] = items[i].second;
+};
+
 vobject* Array::create_proto() {
 	if (ArrayProto != nullptr)
 		return ArrayProto;
@@ -211,6 +383,288 @@ vobject* Array::create_proto() {
 			return a;
 		}));
 	
+	// Parallel operations split copy of elements into ranges processed by
+	//  the shared ThreadPool, callbacks are executed on several threads.
+	
+	// (fn, src, start, end, dst) -> dst[i] = fn(src[i], i)
+	map_task = new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			Array* src = static_cast<Array*>(args[1]);
+			Array* dst = static_cast<Array*>(args[4]);
+			
+			for (int64_t i = args[2]->int_value(); i < args[3]->int_value(); ++i)
+				dst->items()[i] = call_fn(args[0], { src->items()[i], new Int(i) }, L"<parallel_map>");
+			
+			return Undefined::instance();
+		});
+	// (fn, src, start, end) -> Array of src[i] where fn(src[i], i) is true
+	filter_task = new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			Array* src    = static_cast<Array*>(args[1]);
+			Array* result = new Array();
+			
+			gc_handle_scope handles;
+			handles.add(result);
+			
+			for (int64_t i = args[2]->int_value(); i < args[3]->int_value(); ++i)
+				if (call_fn(args[0], { src->items()[i], new Int(i) }, L"<parallel_filter>")->int_value())
+					result->items().push_back(src->items()[i]);
+			
+			return result;
+		});
+	// (fn, src, start, end) -> fn(...fn(fn(src[start], src[start + 1]), src[start + 2])..., src[end - 1])
+	reduce_task = new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			Array* src = static_cast<Array*>(args[1]);
+			
+			vobject* value = src->items()[args[2]->int_value()];
+			for (int64_t i = args[2]->int_value() + 1; i < args[3]->int_value(); ++i)
+				value = call_fn(args[0], { value, src->items()[i] }, L"<parallel_reduce>");
+			
+			return value;
+		});
+	// (fn, src, start, end) -> sorts range of src in place
+	sort_task = new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			vector<vobject*>& items = static_cast<Array*>(args[1])->items();
+			
+			std::stable_sort(items.begin() + args[2]->int_value(), items.begin() + args[3]->int_value(), fn_less{ args[0] });
+			return Undefined::instance();
+		});
+	// (fn, src, start, end, dst, mid) -> merges sorted ranges [start, mid) and [mid, end) of src into dst
+	merge_task = new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			vector<vobject*>& src = static_cast<Array*>(args[1])->items();
+			vector<vobject*>& dst = static_cast<Array*>(args[4])->items();
+			
+			int64_t start = args[2]->int_value();
+			int64_t end   = args[3]->int_value();
+			int64_t mid   = args[5]->int_value();
+			
+			std::merge(src.begin() + start, src.begin() + mid, src.begin() + mid, src.begin() + end, dst.begin() + start, fn_less{ args[0] });
+			return Undefined::instance();
+		});
+	
+	for (NativeFunction* task : { map_task, filter_task, reduce_task, sort_task, merge_task })
+		GIL::gc_instance()->attach_root(task);
+	
+	// parallelMap(fn) -> new Array of fn(value, index)
+	ArrayProto->Object::put(L"parallelMap", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Array>())
+				return Undefined::instance();
+			
+			vobject* fn = expect_function(args, L"parallelMap");
+			
+			gc_handle_scope handles;
+			Array* src = snapshot(static_cast<Array*>(__this));
+			handles.add(src);
+			Array* dst = new Array(vector<vobject*>(src->items().size(), Undefined::instance()));
+			handles.add(dst);
+			
+			if (!src->items().size())
+				return dst;
+			
+			auto ranges = split_ranges(src->items().size(), PARALLEL_MIN_CHUNK, std::thread::hardware_concurrency());
+			run_tasks(scope, handles, map_task, range_tasks(fn, src, ranges, { dst }));
+			
+			return dst;
+		}));
+	// parallelFilter(fn) -> new Array of values where fn(value, index) is true, order is kept
+	ArrayProto->Object::put(L"parallelFilter", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Array>())
+				return Undefined::instance();
+			
+			vobject* fn = expect_function(args, L"parallelFilter");
+			
+			gc_handle_scope handles;
+			Array* src = snapshot(static_cast<Array*>(__this));
+			handles.add(src);
+			
+			if (!src->items().size())
+				return new Array();
+			
+			auto ranges = split_ranges(src->items().size(), PARALLEL_MIN_CHUNK, std::thread::hardware_concurrency());
+			vector<vobject*> parts = run_tasks(scope, handles, filter_task, range_tasks(fn, src, ranges));
+			
+			Array* result = new Array();
+			for (int i = 0; i < parts.size(); ++i) {
+				vector<vobject*>& part = static_cast<Array*>(parts[i])->items();
+				result->items().insert(result->items().end(), part.begin(), part.end());
+			}
+			
+			return result;
+		}));
+	// parallelReduce(fn, initial) -> fn applied to all values, fn must be associative.
+	// Without fn returns sum of numbers computed by native threads.
+	ArrayProto->Object::put(L"parallelReduce", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Array>())
+				return Undefined::instance();
+			
+			gc_handle_scope handles;
+			Array* src = snapshot(static_cast<Array*>(__this));
+			handles.add(src);
+			
+			vector<vobject*>& items = src->items();
+			bool has_initial = args.size() > 1 && args[1] && !args[1]->as_type<Undefined>();
+			
+			// Native sum
+			if (!args.size() || !args[0] || args[0]->as_type<Undefined>()) {
+				bool is_double = has_initial && args[1]->as_type<Double>();
+				for (int64_t i = 0; i < items.size(); ++i)
+					if (items[i] && items[i]->as_type<Double>())
+						is_double = 1;
+					else if (!items[i] || !items[i]->as_type<Int>())
+						throw TypeError(L"Array.parallelReduce without function expected array of numbers");
+				
+				int64_t parts = std::max<int64_t>(1, std::min<int64_t>(std::thread::hardware_concurrency(), items.size() / NATIVE_MIN_CHUNK));
+				vector<int64_t> int_sums(parts, 0);
+				vector<double>  double_sums(parts, 0);
+				
+				native_parallel(parts, [&](int part) {
+					for (int64_t i = items.size() * part / parts; i < items.size() * (part + 1) / parts; ++i)
+						if (is_double)
+							double_sums[part] += items[i]->as_type<Double>() ? static_cast<Double*>(items[i])->value() : (double) static_cast<Int*>(items[i])->value();
+						else
+							int_sums[part] += static_cast<Int*>(items[i])->value();
+				});
+				
+				if (is_double) {
+					double sum = has_initial ? (args[1]->as_type<Double>() ? static_cast<Double*>(args[1])->value() : (double) args[1]->int_value()) : 0;
+					for (int i = 0; i < parts; ++i)
+						sum += double_sums[i];
+					return new Double(sum);
+				}
+				
+				int64_t sum = has_initial ? args[1]->int_value() : 0;
+				for (int i = 0; i < parts; ++i)
+					sum += int_sums[i];
+				return new Int(sum);
+			}
+			
+			vobject* fn = args[0];
+			
+			if (!items.size()) {
+				if (has_initial)
+					return args[1];
+				throw IllegalArgumentError(L"Array.parallelReduce of empty array with no initial value");
+			}
+			
+			auto ranges = split_ranges(items.size(), PARALLEL_MIN_CHUNK, std::thread::hardware_concurrency());
+			vector<vobject*> parts = run_tasks(scope, handles, reduce_task, range_tasks(fn, src, ranges));
+			
+			// Combine results of ranges in order
+			vobject* value = has_initial ? args[1] : parts[0];
+			for (int i = has_initial ? 0 : 1; i < parts.size(); ++i)
+				value = call_fn(fn, { value, parts[i] }, L"<parallel_reduce>");
+			
+			return value;
+		}));
+	// parallelSort(comparator) -> sorts array in place and returns it.
+	// comparator(a, b) returns negative number or true if a is less than b. Sort is stable.
+	// Without comparator numbers or strings are sorted by native threads.
+	ArrayProto->Object::put(L"parallelSort", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Array>())
+				return Undefined::instance();
+			
+			Array* array = static_cast<Array*>(__this);
+			
+			gc_handle_scope handles;
+			Array* src = snapshot(array);
+			handles.add(src);
+			
+			vector<vobject*>& items = src->items();
+			
+			// Native sort by extracted keys
+			if (!args.size() || !args[0] || args[0]->as_type<Undefined>()) {
+				bool ints = 1, numbers = 1, strings = 1;
+				for (int64_t i = 0; i < items.size(); ++i) {
+					bool is_int    = items[i] && items[i]->as_type<Int>();
+					bool is_double = items[i] && items[i]->as_type<Double>();
+					
+					ints    = ints && is_int;
+					numbers = numbers && (is_int || is_double);
+					strings = strings && items[i] && items[i]->as_type<String>();
+				}
+				
+				if (ints) {
+					vector<pair<int64_t, vobject*>> keys;
+					for (int64_t i = 0; i < items.size(); ++i)
+						keys.push_back({ static_cast<Int*>(items[i])->value(), items[i] });
+					native_sort(keys);
+					store_sorted(array, keys);
+				} else if (numbers) {
+					vector<pair<double, vobject*>> keys;
+					for (int64_t i = 0; i < items.size(); ++i)
+						keys.push_back({ items[i]->as_type<Double>() ? static_cast<Double*>(items[i])->value() : (double) static_cast<Int*>(items[i])->value(), items[i] });
+					native_sort(keys);
+					store_sorted(array, keys);
+				} else if (strings) {
+					vector<pair<std::wstring, vobject*>> keys;
+					for (int64_t i = 0; i < items.size(); ++i)
+						keys.push_back({ items[i]->string_value(), items[i] });
+					native_sort(keys);
+					store_sorted(array, keys);
+				} else
+					throw TypeError(L"Array.parallelSort without comparator expected array of numbers or strings");
+				
+				return array;
+			}
+			
+			vobject* fn = args[0];
+			
+			if (items.size() > 1) {
+				// Sort ranges, then merge neighbour ranges till single range is left
+				auto ranges = split_ranges(items.size(), PARALLEL_MIN_CHUNK, std::thread::hardware_concurrency());
+				run_tasks(scope, handles, sort_task, range_tasks(fn, src, ranges));
+				
+				Array* dst = new Array(items);
+				handles.add(dst);
+				
+				while (ranges.size() > 1) {
+					vector<pair<int64_t, int64_t>> merged;
+					vector<vector<vobject*>>       tasks;
+					
+					for (int i = 0; i + 1 < ranges.size(); i += 2) {
+						merged.push_back({ ranges[i].first, ranges[i + 1].second });
+						tasks.push_back({ fn, src, new Int(ranges[i].first), new Int(ranges[i + 1].second), dst, new Int(ranges[i].second) });
+					}
+					
+					// Odd range is copied as is
+					if (ranges.size() % 2) {
+						merged.push_back(ranges.back());
+						std::copy(src->items().begin() + ranges.back().first, src->items().begin() + ranges.back().second, dst->items().begin() + ranges.back().first);
+					}
+					
+					run_tasks(scope, handles, merge_task, tasks);
+					
+					std::swap(src, dst);
+					ranges.swap(merged);
+				}
+			}
+			
+			{
+				vsobject::vslock lk(array);
+				array->items() = src->items();
+			}
+			
+			return array;
+		}));
 	
 	return ArrayProto;
 };
@@ -398,19 +852,12 @@ vobject* Array::call(vscope* scope, const vector<vobject*>& args) {
 	throw UnsupportedOperation(L"Array is not callable");
 };
 
-void Array::gc_mark() {
-	if (gc_reachable)
-		return;
-	
-	gc_reach();
-	
+void Array::gc_trace(gc_visitor& visitor) {
 	for (const auto& any : objects) 
-		if (any.second && !any.second->gc_reachable)
-			any.second->gc_mark();
+		visitor.visit(any.second);
 	
 	for (int i = 0; i < elements.size(); ++i)
-		if (elements[i] && !elements[i]->gc_reachable)
-			elements[i]->gc_mark();
+		visitor.visit(elements[i]);
 };
 
 void Array::gc_finalize() {};
@@ -0,0 +1,191 @@
+#include "objects/AtomicInt.h"
+
+#include <string>
+
+#include "exceptions.h"
+#include "GIL2.h"
+
+#include "objects/Object.h"
+#include "objects/Int.h"
+#include "objects/Bool.h"
+#include "objects/NativeFunction.h"
+#include "objects/Undefined.h"
+#include "objects/String.h"
+
+using namespace std;
+using namespace ck_exceptions;
+using namespace ck_vobject;
+using namespace ck_objects;
+using namespace ck_core;
+
+
+// Returns integer argument or def if it is missing
+static int64_t int_arg(const vector<vobject*>& args, int index, int64_t def, const wchar_t* function) {
+	if (args.size() <= index || !args[index] || args[index]->as_type<Undefined>())
+		return def;
+	
+	if (!args[index]->as_type<Int>())
+		throw IllegalArgumentError(std::wstring(L"AtomicInt.") + function + L"() expected Int");
+	
+	return args[index]->int_value();
+};
+
+static vobject* call_handler(vscope* scope, const vector<vobject*>& args) {
+	return new AtomicInt(int_arg(args, 0, 0, L"constructor"));
+};
+
+vobject* AtomicInt::create_proto() {
+	if (AtomicIntProto != nullptr)
+		return AtomicIntProto;
+	
+	AtomicIntProto = new CallableObject(call_handler);
+	GIL::gc_instance()->attach_root(AtomicIntProto);
+	
+	AtomicIntProto->Object::put(L"__typename", new String(L"AtomicInt"));
+	
+	AtomicIntProto->Object::put(L"get", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<AtomicInt>())
+				return Undefined::instance();
+			
+			return new Int(static_cast<AtomicInt*>(__this)->load());
+		}));
+	AtomicIntProto->Object::put(L"set", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<AtomicInt>())
+				return Undefined::instance();
+			
+			static_cast<AtomicInt*>(__this)->store(int_arg(args, 0, 0, L"set"));
+			return Undefined::instance();
+		}));
+	// add(delta) -> new value
+	AtomicIntProto->Object::put(L"add", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<AtomicInt>())
+				return Undefined::instance();
+			
+			int64_t delta = int_arg(args, 0, 1, L"add");
+			return new Int(static_cast<AtomicInt*>(__this)->fetch_add(delta) + delta);
+		}));
+	// getAndAdd(delta) -> previous value
+	AtomicIntProto->Object::put(L"getAndAdd", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<AtomicInt>())
+				return Undefined::instance();
+			
+			return new Int(static_cast<AtomicInt*>(__this)->fetch_add(int_arg(args, 0, 1, L"getAndAdd")));
+		}));
+	// increment() -> new value
+	AtomicIntProto->Object::put(L"increment", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<AtomicInt>())
+				return Undefined::instance();
+			
+			return new Int(static_cast<AtomicInt*>(__this)->fetch_add(1) + 1);
+		}));
+	// decrement() -> new value
+	AtomicIntProto->Object::put(L"decrement", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<AtomicInt>())
+				return Undefined::instance();
+			
+			return new Int(static_cast<AtomicInt*>(__this)->fetch_add(-1) - 1);
+		}));
+	// exchange(value) -> previous value
+	AtomicIntProto->Object::put(L"exchange", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<AtomicInt>())
+				return Undefined::instance();
+			
+			return new Int(static_cast<AtomicInt*>(__this)->exchange(int_arg(args, 0, 0, L"exchange")));
+		}));
+	// compareAndSet(expected, value) -> true if value was stored
+	AtomicIntProto->Object::put(L"compareAndSet", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<AtomicInt>())
+				return Undefined::instance();
+			
+			if (args.size() < 2)
+				throw IllegalArgumentError(L"AtomicInt.compareAndSet() expected expected and new values");
+			
+			int64_t expected = int_arg(args, 0, 0, L"compareAndSet");
+			int64_t value    = int_arg(args, 1, 0, L"compareAndSet");
+			
+			return Bool::instance(static_cast<AtomicInt*>(__this)->compare_exchange(expected, value));
+		}));
+	
+	return AtomicIntProto;
+};
+
+
+AtomicInt::AtomicInt(int64_t value) : value(value) {};
+
+AtomicInt::~AtomicInt() {};
+
+
+vobject* AtomicInt::get(vscope* scope, const wstring& name) {
+	vobject* ret = Object::get(name);
+	
+	if (!ret && AtomicIntProto)
+		return AtomicIntProto->get(scope, name);
+	return ret;
+};
+
+void AtomicInt::put(vscope* scope, const wstring& name, vobject* object) {
+	Object::put(name, object);
+};
+
+bool AtomicInt::contains(vscope* scope, const wstring& name) {
+	return Object::contains(name) || (AtomicIntProto && AtomicIntProto->contains(scope, name));
+};
+
+bool AtomicInt::remove(vscope* scope, const wstring& name) {
+	if (Object::remove(name))
+		return 1;
+	return 0;
+};
+
+vobject* AtomicInt::call(vscope* scope, const vector<vobject*>& args) {
+	throw UnsupportedOperation(L"AtomicInt is not callable");
+};
+
+
+void AtomicInt::gc_trace(gc_visitor& visitor) {
+	Object::gc_trace(visitor);
+};
+
+void AtomicInt::gc_finalize() {};
+
+// Must return integer representation of an object
+int64_t AtomicInt::int_value() {
+	return value.load();
+};
+
+// Must return string representation of an object
+std::wstring AtomicInt::string_value() {
+	return std::to_wstring(value.load());
+};
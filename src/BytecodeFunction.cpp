@@ -61,7 +61,7 @@ static vobject* call_handler(vscope* scope, const vector<vobject*>& args) {
 	ck_core::ck_script* main_script = new ck_script();
 	main_script->directory = GIL::executer_instance()->get_script()->directory;
 	main_script->filename  = GIL::executer_instance()->get_script()->filename;
-	ck_translator::translate_function(main_script->bytecode.bytemap, main_script->bytecode.lineno_table, n);
+	bool generator = ck_translator::translate_function(main_script->bytecode.bytemap, main_script->bytecode.lineno_table, n);
 	
 	// Free up memory
 	delete n;
@@ -73,7 +73,7 @@ static vobject* call_handler(vscope* scope, const vector<vobject*>& args) {
 			argn.push_back(args[i]->string_value());
 	
 	// Return result
-	return new BytecodeFunction(scope, main_script, argn);
+	return new BytecodeFunction(scope, main_script, argn, generator);
 };
 
 vobject* BytecodeFunction::create_proto() {
@@ -89,7 +89,7 @@ vobject* BytecodeFunction::create_proto() {
 };
 
 
-BytecodeFunction::BytecodeFunction(ck_vobject::vscope* definition_scope, ck_script* function_script, const std::vector<std::wstring>& argnames) : scope(definition_scope), script(function_script), argn(argnames) {};
+BytecodeFunction::BytecodeFunction(ck_vobject::vscope* definition_scope, ck_script* function_script, const std::vector<std::wstring>& argnames, bool generator) : scope(definition_scope), script(function_script), argn(argnames), generator(generator) {};
 
 BytecodeFunction::~BytecodeFunction() {
 	delete script;
@@ -142,14 +142,10 @@ vscope* BytecodeFunction::apply(ck_vobject::vobject* this_bind, const std::vecto
 	return nscope;
 };
 
-void BytecodeFunction::gc_mark() {
-	if (gc_reachable)
-		return;
+void BytecodeFunction::gc_trace(gc_visitor& visitor) {
+	Function::gc_trace(visitor);
 	
-	Function::gc_mark();
-	
-	if (scope && !scope->gc_reachable)
-		scope->gc_mark();
+	visitor.visit(scope);
 };
 
 
@@ -265,8 +265,8 @@ vobject* Cake::call(ck_vobject::vscope* scope, const std::vector<vobject*>& args
 	throw UnsupportedOperation(L"Cake is not callable");
 };
 
-void Cake::gc_mark() {
-	Object::gc_mark();
+void Cake::gc_trace(gc_visitor& visitor) {
+	Object::gc_trace(visitor);
 };
 
 void Cake::gc_finalize() {
@@ -0,0 +1,439 @@
+#include "objects/Channel.h"
+
+#include <string>
+#include <chrono>
+#include <algorithm>
+
+#include "exceptions.h"
+#include "GIL2.h"
+
+#include "objects/Object.h"
+#include "objects/Int.h"
+#include "objects/Bool.h"
+#include "objects/Array.h"
+#include "objects/NativeFunction.h"
+#include "objects/Undefined.h"
+#include "objects/String.h"
+
+using namespace std;
+using namespace ck_exceptions;
+using namespace ck_vobject;
+using namespace ck_objects;
+using namespace ck_core;
+
+
+// Threads waiting in select() sleep on shared condition,
+//  any channel receiving value or being closed wakes them.
+static std::mutex              select_mutex;
+static std::condition_variable select_var;
+static std::atomic<int>        select_waiters(0);
+
+// Maximal amount of values stored in channel
+static const uint64_t MAX_CAPACITY = 1 << 26;
+
+
+static vobject* call_handler(vscope* scope, const vector<vobject*>& args) {
+	int64_t capacity = 1;
+	
+	if (args.size() && args[0] && !args[0]->as_type<Undefined>()) {
+		if (!args[0]->as_type<Int>() || args[0]->int_value() <= 0 || args[0]->int_value() > MAX_CAPACITY)
+			throw IllegalArgumentError(L"Channel expected capacity in range [1, " + to_wstring(MAX_CAPACITY) + L"]");
+		
+		capacity = args[0]->int_value();
+	}
+	
+	return new Channel(capacity);
+};
+
+vobject* Channel::create_proto() {
+	if (ChannelProto != nullptr)
+		return ChannelProto;
+	
+	ChannelProto = new CallableObject(call_handler);
+	GIL::gc_instance()->attach_root(ChannelProto);
+	
+	ChannelProto->Object::put(L"__typename", new String(L"Channel"));
+	
+	// Waits for free space and sends value
+	ChannelProto->Object::put(L"send", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Channel>())
+				return Undefined::instance();
+			
+			static_cast<Channel*>(__this)->send(args.size() && args[0] ? args[0] : Undefined::instance());
+			return Undefined::instance();
+		}));
+	// Waits for value, returns undefined if channel is closed and empty
+	ChannelProto->Object::put(L"recv", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Channel>())
+				return Undefined::instance();
+			
+			vobject* value;
+			if (static_cast<Channel*>(__this)->recv(value))
+				return value;
+			return Undefined::instance();
+		}));
+	ChannelProto->Object::put(L"trySend", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Channel>())
+				return Undefined::instance();
+			
+			return Bool::instance(static_cast<Channel*>(__this)->try_send(args.size() && args[0] ? args[0] : Undefined::instance()));
+		}));
+	// Returns undefined if channel is empty
+	ChannelProto->Object::put(L"tryRecv", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Channel>())
+				return Undefined::instance();
+			
+			vobject* value;
+			if (static_cast<Channel*>(__this)->try_recv(value))
+				return value;
+			return Undefined::instance();
+		}));
+	ChannelProto->Object::put(L"close", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Channel>())
+				return Undefined::instance();
+			
+			static_cast<Channel*>(__this)->close();
+			return Undefined::instance();
+		}));
+	ChannelProto->Object::put(L"isClosed", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Channel>())
+				return Undefined::instance();
+			
+			return Bool::instance(static_cast<Channel*>(__this)->is_closed());
+		}));
+	ChannelProto->Object::put(L"size", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Channel>())
+				return Undefined::instance();
+			
+			return new Int(static_cast<Channel*>(__this)->size());
+		}));
+	ChannelProto->Object::put(L"capacity", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Channel>())
+				return Undefined::instance();
+			
+			return new Int(static_cast<Channel*>(__this)->get_capacity());
+		}));
+	
+	// Static
+	// select(channels, timeout) -> [index, value]
+	// index is -1 if all channels are closed, -2 on timeout
+	ChannelProto->Object::put(L"select", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			if (!args.size() || !args[0] || !args[0]->as_type<Array>())
+				throw IllegalArgumentError(L"Channel.select expected array of channels");
+			
+			vector<Channel*> channels;
+			for (vobject* o : static_cast<Array*>(args[0])->items())
+				if (o && o->as_type<Channel>())
+					channels.push_back(static_cast<Channel*>(o));
+				else
+					throw IllegalArgumentError(L"Channel.select expected array of channels");
+			
+			int64_t timeout = -1;
+			if (args.size() > 1 && args[1] && !args[1]->as_type<Undefined>())
+				timeout = args[1]->int_value();
+			
+			vobject* value = Undefined::instance();
+			int index = Channel::select(channels, value, timeout);
+			
+			return new Array({ new Int(index), index >= 0 ? value : Undefined::instance() });
+		}));
+	
+	return ChannelProto;
+};
+
+
+Channel::Channel(uint64_t capacity) : capacity(capacity) {
+	buffer = new cell[capacity];
+	
+	// Cell i is free for send number i
+	for (uint64_t i = 0; i < capacity; ++i) {
+		buffer[i].sequence.store(i, std::memory_order_relaxed);
+		buffer[i].value = nullptr;
+	}
+};
+
+Channel::~Channel() {
+	delete[] buffer;
+};
+
+
+vobject* Channel::get(vscope* scope, const wstring& name) {
+	vobject* ret = Object::get(name);
+	
+	if (!ret && ChannelProto)
+		return ChannelProto->get(scope, name);
+	return ret;
+};
+
+void Channel::put(vscope* scope, const wstring& name, vobject* object) {
+	Object::put(name, object);
+};
+
+bool Channel::contains(vscope* scope, const wstring& name) {
+	return Object::contains(name) || (ChannelProto && ChannelProto->contains(scope, name));
+};
+
+bool Channel::remove(vscope* scope, const wstring& name) {
+	if (Object::remove(name))
+		return 1;
+	return 0;
+};
+
+vobject* Channel::call(vscope* scope, const vector<vobject*>& args) {
+	throw UnsupportedOperation(L"Channel is not callable");
+};
+
+
+void Channel::gc_trace(gc_visitor& visitor) {
+	Object::gc_trace(visitor);
+	
+	// Received cells are cleared
+	for (uint64_t i = 0; i < capacity; ++i)
+		visitor.visit(buffer[i].value);
+};
+
+void Channel::gc_finalize() {};
+
+// Channel functions only
+
+void Channel::wake() {
+	// Pairs with waiter incrementing counter before checking channel state
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	
+	if (waiters.load(std::memory_order_relaxed) > 0) {
+		{
+			std::unique_lock<std::mutex> lk(park_mutex);
+		}
+		park_var.notify_all();
+	}
+	
+	if (select_waiters.load(std::memory_order_relaxed) > 0) {
+		{
+			std::unique_lock<std::mutex> lk(select_mutex);
+		}
+		select_var.notify_all();
+	}
+};
+
+bool Channel::try_send(vobject* value) {
+	if (is_closed())
+		throw IllegalStateError(L"Channel is closed");
+	
+	cell*    c;
+	uint64_t pos = send_pos.load(std::memory_order_relaxed);
+	
+	while (1) {
+		c = &buffer[pos % capacity];
+		uint64_t seq = c->sequence.load(std::memory_order_acquire);
+		int64_t  dif = (int64_t) seq - (int64_t) pos;
+		
+		if (dif == 0) {
+			// Cell is free, claim it
+			if (send_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		} else if (dif < 0)
+			// Cell still holds value of previous round
+			return 0;
+		else
+			pos = send_pos.load(std::memory_order_relaxed);
+	}
+	
+	c->value = value;
+	c->sequence.store(pos + 1, std::memory_order_release);
+	
+	wake();
+	return 1;
+};
+
+bool Channel::try_recv(vobject*& value) {
+	cell*    c;
+	uint64_t pos = recv_pos.load(std::memory_order_relaxed);
+	
+	while (1) {
+		c = &buffer[pos % capacity];
+		uint64_t seq = c->sequence.load(std::memory_order_acquire);
+		int64_t  dif = (int64_t) seq - (int64_t) (pos + 1);
+		
+		if (dif == 0) {
+			// Cell is filled, claim it
+			if (recv_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		} else if (dif < 0)
+			// Cell was not sent yet
+			return 0;
+		else
+			pos = recv_pos.load(std::memory_order_relaxed);
+	}
+	
+	value    = c->value;
+	c->value = nullptr;
+	
+	// Free cell for send of the next round
+	c->sequence.store(pos + capacity, std::memory_order_release);
+	
+	wake();
+	return 1;
+};
+
+void Channel::send(vobject* value) {
+	while (!try_send(value)) {
+		
+		// Thread was stopped
+		if (!GIL::current_thread()->is_running())
+			return;
+		
+		// Park till receiver frees cell.
+		// Thread is marked blocked to not delay stop-the-world.
+		waiters++;
+		GIL::instance()->io_block();
+		
+		{
+			std::unique_lock<std::mutex> lk(park_mutex);
+			park_var.wait_for(lk, std::chrono::milliseconds(100), [this]() -> bool {
+				return is_closed() || size() < capacity;
+			});
+		}
+		
+		GIL::instance()->io_unblock();
+		waiters--;
+	}
+};
+
+bool Channel::recv(vobject*& value) {
+	while (!try_recv(value)) {
+		
+		// Values sent before close are still received
+		if (is_closed())
+			return try_recv(value);
+		
+		// Thread was stopped
+		if (!GIL::current_thread()->is_running())
+			return 0;
+		
+		// Park till sender fills cell
+		waiters++;
+		GIL::instance()->io_block();
+		
+		{
+			std::unique_lock<std::mutex> lk(park_mutex);
+			park_var.wait_for(lk, std::chrono::milliseconds(100), [this]() -> bool {
+				return is_closed() || size() > 0;
+			});
+		}
+		
+		GIL::instance()->io_unblock();
+		waiters--;
+	}
+	
+	return 1;
+};
+
+void Channel::close() {
+	closed.store(1, std::memory_order_release);
+	wake();
+};
+
+int64_t Channel::size() {
+	int64_t size = (int64_t) send_pos.load(std::memory_order_acquire) - (int64_t) recv_pos.load(std::memory_order_acquire);
+	return size < 0 ? 0 : size;
+};
+
+int Channel::select(const std::vector<Channel*>& channels, vobject*& value, int64_t timeout) {
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout < 0 ? 0 : timeout);
+	
+	// Rotate first checked channel to not starve the last ones
+	static thread_local uint32_t start = 0;
+	++start;
+	
+	while (1) {
+		bool all_closed = 1;
+		
+		for (int k = 0; k < channels.size(); ++k) {
+			int i = (start + k) % channels.size();
+			
+			// Closed state is checked first, so value sent before close is not missed
+			bool closed = channels[i]->is_closed();
+			
+			if (channels[i]->try_recv(value))
+				return i;
+			
+			if (!closed)
+				all_closed = 0;
+		}
+		
+		if (all_closed)
+			return -1;
+		
+		// Thread was stopped
+		if (!GIL::current_thread()->is_running())
+			return -1;
+		
+		int64_t wait_time = 100;
+		if (timeout >= 0) {
+			int64_t left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+			if (left <= 0)
+				return -2;
+			
+			wait_time = std::min(wait_time, left);
+		}
+		
+		select_waiters++;
+		GIL::instance()->io_block();
+		
+		{
+			std::unique_lock<std::mutex> lk(select_mutex);
+			select_var.wait_for(lk, std::chrono::milliseconds(wait_time), [&channels]() -> bool {
+				for (int i = 0; i < channels.size(); ++i)
+					if (channels[i]->size() > 0 || channels[i]->is_closed())
+						return 1;
+				return 0;
+			});
+		}
+		
+		GIL::instance()->io_unblock();
+		select_waiters--;
+	}
+};
+
+// Must return integer representation of an object
+int64_t Channel::int_value() {
+	return (intptr_t) this;
+};
+
+// Must return string representation of an object
+std::wstring Channel::string_value() {
+	return std::wstring(L"[Channel ") + std::to_wstring(size()) + L"/" + std::to_wstring(capacity) + std::wstring(L"]");
+};
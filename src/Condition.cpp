@@ -0,0 +1,196 @@
+#include "objects/Condition.h"
+
+#include <string>
+
+#include "exceptions.h"
+#include "GIL2.h"
+#include "monitor.h"
+
+#include "objects/Object.h"
+#include "objects/Bool.h"
+#include "objects/NativeFunction.h"
+#include "objects/Undefined.h"
+#include "objects/String.h"
+
+using namespace std;
+using namespace ck_exceptions;
+using namespace ck_vobject;
+using namespace ck_objects;
+using namespace ck_core;
+
+
+static vobject* call_handler(vscope* scope, const vector<vobject*>& args) {
+	if (!args.size() || !args[0] || args[0]->as_type<Undefined>())
+		return new Condition(new Mutex());
+	
+	if (!args[0]->as_type<Mutex>())
+		throw IllegalArgumentError(L"Condition expected Mutex");
+	
+	return new Condition(static_cast<Mutex*>(args[0]));
+};
+
+vobject* Condition::create_proto() {
+	if (ConditionProto != nullptr)
+		return ConditionProto;
+	
+	ConditionProto = new CallableObject(call_handler);
+	GIL::gc_instance()->attach_root(ConditionProto);
+	
+	ConditionProto->Object::put(L"__typename", new String(L"Condition"));
+	
+	// wait(timeout) -> false on timeout
+	ConditionProto->Object::put(L"wait", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Condition>())
+				return Undefined::instance();
+			
+			int64_t timeout = -1;
+			if (args.size() && args[0] && !args[0]->as_type<Undefined>())
+				timeout = args[0]->int_value();
+			
+			return Bool::instance(static_cast<Condition*>(__this)->wait(timeout));
+		}));
+	ConditionProto->Object::put(L"notify", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Condition>())
+				return Undefined::instance();
+			
+			static_cast<Condition*>(__this)->notify(0);
+			return Undefined::instance();
+		}));
+	ConditionProto->Object::put(L"notifyAll", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Condition>())
+				return Undefined::instance();
+			
+			static_cast<Condition*>(__this)->notify(1);
+			return Undefined::instance();
+		}));
+	ConditionProto->Object::put(L"getMutex", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Condition>())
+				return Undefined::instance();
+			
+			return static_cast<Condition*>(__this)->get_mutex();
+		}));
+	
+	return ConditionProto;
+};
+
+
+Condition::Condition(Mutex* mutex) : mutex(mutex) {};
+
+Condition::~Condition() {};
+
+
+vobject* Condition::get(vscope* scope, const wstring& name) {
+	vobject* ret = Object::get(name);
+	
+	if (!ret && ConditionProto)
+		return ConditionProto->get(scope, name);
+	return ret;
+};
+
+void Condition::put(vscope* scope, const wstring& name, vobject* object) {
+	Object::put(name, object);
+};
+
+bool Condition::contains(vscope* scope, const wstring& name) {
+	return Object::contains(name) || (ConditionProto && ConditionProto->contains(scope, name));
+};
+
+bool Condition::remove(vscope* scope, const wstring& name) {
+	if (Object::remove(name))
+		return 1;
+	return 0;
+};
+
+vobject* Condition::call(vscope* scope, const vector<vobject*>& args) {
+	throw UnsupportedOperation(L"Condition is not callable");
+};
+
+
+void Condition::gc_trace(gc_visitor& visitor) {
+	Object::gc_trace(visitor);
+	
+	visitor.visit(mutex);
+};
+
+void Condition::gc_finalize() {};
+
+// Condition functions only
+
+bool Condition::wait(int64_t timeout) {
+	monitor& mon = mutex->get_monitor();
+	
+	if (!mon.is_owned())
+		throw IllegalStateError(L"Condition.wait() expected Mutex owned by current thread");
+	
+	std::unique_lock<std::mutex> lk(wait_mutex);
+	
+	// Mutex is released after registering as waiter, so
+	//  notification by the next owner can not be missed
+	++waiters;
+	int depth = mon.unlock_all();
+	
+	GIL::instance()->io_block();
+	
+	bool signalled = wait_blocked(lk, wait_var, timeout, [this]() -> bool {
+		return signals > 0;
+	});
+	
+	if (signalled)
+		--signals;
+	
+	--waiters;
+	if (signals > waiters)
+		signals = waiters;
+	
+	lk.unlock();
+	GIL::instance()->io_unblock();
+	
+	if (!mon.relock(depth))
+		throw IllegalStateError(L"thread stopped while waiting for monitor");
+	
+	return signalled;
+};
+
+void Condition::notify(bool all) {
+	if (!mutex->get_monitor().is_owned())
+		throw IllegalStateError(L"Condition.notify() expected Mutex owned by current thread");
+	
+	std::unique_lock<std::mutex> lk(wait_mutex);
+	
+	if (signals >= waiters)
+		return;
+	
+	if (all) {
+		signals = waiters;
+		wait_var.notify_all();
+	} else {
+		++signals;
+		wait_var.notify_one();
+	}
+};
+
+// Must return integer representation of an object
+int64_t Condition::int_value() {
+	return (intptr_t) this;
+};
+
+// Must return string representation of an object
+std::wstring Condition::string_value() {
+	return std::wstring(L"[Condition ") + std::to_wstring((intptr_t) this) + std::wstring(L"]");
+};
@@ -9,6 +9,6 @@ using namespace ck_vobject;
 using namespace ck_objects;
 using namespace ck_core;
 
-void Function::gc_mark() { gc_reach(); if (this_bind && !this_bind->gc_reachable) this_bind->gc_mark(); };
+void Function::gc_trace(gc_visitor& visitor) { visitor.visit(this_bind); };
 
 std::wstring Function::string_value() { return std::wstring(L"[Function ") + std::to_wstring((intptr_t) this) + std::wstring(L"]"); };
\ No newline at end of file
@@ -0,0 +1,404 @@
+#include "objects/Future.h"
+
+#include <string>
+#include <chrono>
+#include <algorithm>
+
+#include "exceptions.h"
+#include "GIL2.h"
+#include "executer.h"
+#include "vscope.h"
+#include "event_loop.h"
+
+#include "objects/Object.h"
+#include "objects/Bool.h"
+#include "objects/NativeFunction.h"
+#include "objects/Undefined.h"
+#include "objects/String.h"
+#include "objects/ThreadPool.h"
+#include "objects/Array.h"
+#include "objects/Cake.h"
+#include "objects/Null.h"
+
+using namespace std;
+using namespace ck_exceptions;
+using namespace ck_vobject;
+using namespace ck_objects;
+using namespace ck_core;
+
+
+static vobject* call_handler(vscope* scope, const vector<vobject*>& args) {
+	throw UnsupportedOperation(L"Future can not be constructed directly");
+};
+
+vobject* Future::create_proto() {
+	if (FutureProto != nullptr)
+		return FutureProto;
+	
+	FutureProto = new CallableObject(call_handler);
+	GIL::gc_instance()->attach_root(FutureProto);
+	
+	FutureProto->Object::put(L"__typename", new String(L"Future"));
+	
+	// Waits for completion, returns result or throws error of the task
+	FutureProto->Object::put(L"get", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Future>())
+				return Undefined::instance();
+			
+			return static_cast<Future*>(__this)->result();
+		}));
+	// then(callback) -> Future of callback(value)
+	FutureProto->Object::put(L"then", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Future>())
+				return Undefined::instance();
+			
+			if (!args.size() || !args[0] || args[0]->as_type<Undefined>() || args[0]->as_type<Null>())
+				throw IllegalArgumentError(L"Future.then expected function");
+			
+			return static_cast<Future*>(__this)->then(args[0]);
+		}));
+	
+	// Static
+	FutureProto->Object::put(L"all", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			if (!args.size() || !args[0] || !args[0]->as_type<Array>())
+				throw IllegalArgumentError(L"Future.all expected array of futures");
+			
+			return Future::all(static_cast<Array*>(args[0])->items());
+		}));
+	FutureProto->Object::put(L"any", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			if (!args.size() || !args[0] || !args[0]->as_type<Array>())
+				throw IllegalArgumentError(L"Future.any expected array of futures");
+			
+			if (!static_cast<Array*>(args[0])->size())
+				throw IllegalArgumentError(L"Future.any expected non-empty array");
+			
+			return Future::any(static_cast<Array*>(args[0])->items());
+		}));
+	FutureProto->Object::put(L"isDone", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Future>())
+				return Undefined::instance();
+			
+			return Bool::instance(static_cast<Future*>(__this)->is_done());
+		}));
+	
+	return FutureProto;
+};
+
+
+Future::Future() {};
+
+Future::~Future() {};
+
+
+vobject* Future::get(vscope* scope, const wstring& name) {
+	vobject* ret = Object::get(name);
+	
+	if (!ret && FutureProto)
+		return FutureProto->get(scope, name);
+	return ret;
+};
+
+void Future::put(vscope* scope, const wstring& name, vobject* object) {
+	Object::put(name, object);
+};
+
+bool Future::contains(vscope* scope, const wstring& name) {
+	return Object::contains(name) || (FutureProto && FutureProto->contains(scope, name));
+};
+
+bool Future::remove(vscope* scope, const wstring& name) {
+	if (Object::remove(name))
+		return 1;
+	return 0;
+};
+
+vobject* Future::call(vscope* scope, const vector<vobject*>& args) {
+	throw UnsupportedOperation(L"Future is not callable");
+};
+
+
+void Future::gc_trace(gc_visitor& visitor) {
+	Object::gc_trace(visitor);
+	
+	visitor.visit(value);
+	visitor.visit(error);
+	
+	std::unique_lock<std::mutex> lk(wait_mutex);
+	for (int i = 0; i < continuations.size(); ++i) {
+		visitor.visit(continuations[i].target);
+		visitor.visit(continuations[i].callback);
+		visitor.visit(continuations[i].results);
+	}
+};
+
+void Future::gc_finalize() {};
+
+// Future functions only
+
+bool Future::resolve(vobject* value) {
+	{
+		std::unique_lock<std::mutex> lk(wait_mutex);
+		
+		if (done.load(std::memory_order_relaxed))
+			return 0;
+		
+		this->value = value;
+		done.store(1, std::memory_order_release);
+	}
+	
+	wait_var.notify_all();
+	complete();
+	return 1;
+};
+
+bool Future::reject(vobject* error) {
+	{
+		std::unique_lock<std::mutex> lk(wait_mutex);
+		
+		if (done.load(std::memory_order_relaxed))
+			return 0;
+		
+		this->error = error ? error : Undefined::instance();
+		done.store(1, std::memory_order_release);
+	}
+	
+	wait_var.notify_all();
+	complete();
+	return 1;
+};
+
+void Future::complete() {
+	std::vector<future_continuation> list;
+	
+	{
+		std::unique_lock<std::mutex> lk(wait_mutex);
+		list.swap(continuations);
+	}
+	
+	// Callbacks may run GC, keep continuations alive
+	gc_handle_scope handles;
+	for (int i = 0; i < list.size(); ++i) {
+		handles.add(list[i].target);
+		handles.add(list[i].callback);
+		handles.add(list[i].results);
+	}
+	
+	for (int i = 0; i < list.size(); ++i)
+		run_continuation(list[i]);
+};
+
+void Future::run_continuation(const future_continuation& c) {
+	switch (c.type) {
+		case future_continuation::THEN: {
+			if (error) {
+				c.target->reject(error);
+				break;
+			}
+			
+			ck_executer* executer = GIL::executer_instance();
+			if (!executer) {
+				c.target->reject(new Cake(IllegalStateError(L"no executer to call Future.then callback")));
+				break;
+			}
+			
+			vobject* result;
+			cake     message;
+			
+			if (executer->try_call_object(result, message, c.callback, nullptr, { value ? value : Undefined::instance() }, L"<future_then>", new iscope()))
+				c.target->resolve(result);
+			else
+				c.target->reject(message.get_type_id() == cake_type::CK_OBJECT ? message.get_object() : new Cake(message));
+			
+			break;
+		}
+		
+		case future_continuation::ALL: {
+			if (error) {
+				c.target->reject(error);
+				break;
+			}
+			
+			c.results->set_item(c.index, value ? value : Undefined::instance());
+			
+			if (--c.target->remaining == 0)
+				c.target->resolve(c.results);
+			
+			break;
+		}
+		
+		case future_continuation::ANY: {
+			if (!error) {
+				c.target->resolve(value ? value : Undefined::instance());
+				break;
+			}
+			
+			if (--c.target->remaining == 0)
+				c.target->reject(error);
+			
+			break;
+		}
+	}
+};
+
+void Future::add_continuation(const future_continuation& c) {
+	{
+		std::unique_lock<std::mutex> lk(wait_mutex);
+		
+		if (!done.load(std::memory_order_relaxed)) {
+			continuations.push_back(c);
+			return;
+		}
+	}
+	
+	// Already completed
+	run_continuation(c);
+};
+
+bool Future::wait(int64_t timeout) {
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout < 0 ? 0 : timeout);
+	
+	while (!is_done()) {
+		
+		// Worker of a pool runs other tasks instead of sleeping,
+		//  so pool never deadlocks on tasks waiting for each other.
+		if (ThreadPool::help())
+			continue;
+		
+		// Thread was stopped
+		if (!GIL::current_thread()->is_running())
+			return 0;
+		
+		// Future may be completed by asynchronous I/O of this thread.
+		// Waiting is a safepoint, so callbacks are executed here too.
+		bool io_pending = event_loop::exists() && event_loop::instance()->has_pending();
+		if (io_pending && event_loop::instance()->dispatch()) {
+			GIL::executer_instance()->run_late_calls();
+			continue;
+		}
+		
+		// Short timeout allows worker to pick up new tasks
+		//  and waiter to notice termination.
+		int64_t wait_time = ThreadPool::is_worker() ? 1 : io_pending ? 10 : 100;
+		if (timeout >= 0) {
+			int64_t left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+			if (left <= 0)
+				return 0;
+			
+			wait_time = std::min(wait_time, left);
+		}
+		
+		// Allow other threads to perform stop-the-world while waiting
+		GIL::instance()->io_block();
+		
+		if (io_pending)
+			event_loop::instance()->wait(wait_time);
+		else {
+			std::unique_lock<std::mutex> lk(wait_mutex);
+			wait_var.wait_for(lk, std::chrono::milliseconds(wait_time), [this]() -> bool {
+				return done.load(std::memory_order_acquire);
+			});
+		}
+		
+		GIL::instance()->io_unblock();
+	}
+	
+	return 1;
+};
+
+Future* Future::then(vobject* callback) {
+	future_continuation c;
+	c.type     = future_continuation::THEN;
+	c.target   = new Future();
+	c.callback = callback;
+	
+	add_continuation(c);
+	return c.target;
+};
+
+Future* Future::all(const std::vector<vobject*>& futures) {
+	Future* target  = new Future();
+	Array*  results = new Array(std::vector<vobject*>(futures.size(), Undefined::instance()));
+	
+	// Count sources before any of them completes target
+	int count = 0;
+	for (int i = 0; i < futures.size(); ++i)
+		if (futures[i] && futures[i]->as_type<Future>())
+			++count;
+	
+	target->remaining = count + 1;
+	
+	for (int i = 0; i < futures.size(); ++i)
+		if (futures[i] && futures[i]->as_type<Future>()) {
+			future_continuation c;
+			c.type    = future_continuation::ALL;
+			c.target  = target;
+			c.results = results;
+			c.index   = i;
+			
+			static_cast<Future*>(futures[i])->add_continuation(c);
+		} else
+			results->set_item(i, futures[i] ? futures[i] : Undefined::instance());
+	
+	// Release own count
+	if (--target->remaining == 0)
+		target->resolve(results);
+	
+	return target;
+};
+
+Future* Future::any(const std::vector<vobject*>& futures) {
+	Future* target = new Future();
+	
+	// Plain value is available immediately
+	for (int i = 0; i < futures.size(); ++i)
+		if (!futures[i] || !futures[i]->as_type<Future>()) {
+			target->resolve(futures[i] ? futures[i] : Undefined::instance());
+			return target;
+		}
+	
+	target->remaining = futures.size();
+	
+	for (int i = 0; i < futures.size(); ++i) {
+		future_continuation c;
+		c.type   = future_continuation::ANY;
+		c.target = target;
+		
+		static_cast<Future*>(futures[i])->add_continuation(c);
+	}
+	
+	return target;
+};
+
+vobject* Future::result() {
+	if (!wait())
+		return Undefined::instance();
+	
+	if (error)
+		throw ObjectCake(error);
+	
+	return value ? value : Undefined::instance();
+};
+
+// Must return integer representation of an object
+int64_t Future::int_value() {
+	return (intptr_t) this;
+};
+
+// Must return string representation of an object
+std::wstring Future::string_value() {
+	return std::wstring(L"[Future ") + std::to_wstring((intptr_t) this) + std::wstring(L"]");
+};
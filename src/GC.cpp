@@ -3,9 +3,22 @@
 #include <exception>
 #include <cstdlib>
 #include <new>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <typeinfo>
+#include <map>
+#include <cxxabi.h>
 
 #include "exceptions.h"
 #include "GIL2.h"
+#include "ck_platform.h"
+
+// Fragmentation is measured with glibc mallinfo2
+#if defined(LINUX) && defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+	#define CK_GC_MALLINFO
+	#include <malloc.h>
+#endif
 
 using namespace ck_core;
 using namespace ck_exceptions;
@@ -13,28 +26,47 @@ using namespace ck_exceptions;
 
 int64_t GC::MAX_HEAP_SIZE             = 512 * 1024 * 1024;
 int32_t GC::MIN_GC_INTERVAL           = 64;
-std::atomic<int64_t> GC::memory_usage = 0;
+int64_t GC::MIN_HEAP_TRIGGER          = 4 * 1024 * 1024;
+double  GC::MIN_HEAP_GROWTH           = 1.5;
+double  GC::MAX_HEAP_GROWTH           = 4.0;
+double  GC::GC_TIME_RATIO             = 0.05;
+double  GC::EMERGENCY_RATIO           = 0.9;
+double  GC::TRIM_RATIO                = 0.25;
+int64_t GC::MIN_TRIM_SIZE             = 16 * 1024 * 1024;
+std::string GC::HEAP_DUMP_ON_OOM;
+std::atomic<int64_t> GC::memory_usage      = 0;
+std::atomic<int64_t> GC::collect_threshold = GC::MIN_HEAP_TRIGGER;
+std::atomic<bool>    GC::collect_requested   = 0;
+std::atomic<bool>    GC::emergency_requested = 0;
+std::atomic<bool>    GC::dump_requested      = 0;
+thread_local gc_thread_state* GC::local_state = nullptr;
+thread_local std::vector<std::pair<void*, std::size_t>> gc_object::allocated_sizes;
 
 // gc_object		
 gc_object::gc_object() : 
-			gc_reachable(0),
-			gc_record(0),
-			gc_root(0),
-			gc_lock(0),
-			gc_chain(nullptr),
-			gc_lock_chain(nullptr),
-			gc_root_chain(nullptr) {
+			gc_next(nullptr) {
+				// Size is passed by operator new, 0 for objects not allocated on heap
+				std::size_t size = 0;
+				if (!allocated_sizes.empty() && allocated_sizes.back().first == this) {
+					size = allocated_sizes.back().second;
+					allocated_sizes.pop_back();
+				}
+				
+				gc_header = (uint64_t) size << GC_SIZE_SHIFT;
+				
 				GIL::gc_instance()->attach(this);
 			};
 			
 gc_object::~gc_object() {};
 		
-void gc_object::gc_mark() {
-	gc_reachable = 1;
-};
+void gc_object::gc_trace(gc_visitor &visitor) {};
 		
 void gc_object::gc_finalize() {};
 
+void gc_object::gc_trace_weak(gc_visitor &visitor) {};
+
+void gc_object::gc_clear_weak() {};
+
 void gc_object::gc_make_root() {
 	GIL::gc_instance()->attach_root(this);
 };
@@ -52,71 +84,181 @@ void gc_object::gc_make_unlock() {
 };
 
 void* gc_object::operator new(std::size_t count) {
-	if (GC::memory_usage + count > GC::MAX_HEAP_SIZE)
+	if (GC::memory_usage + count > GC::MAX_HEAP_SIZE) {
+		GC::out_of_memory();
 		throw OutOfMemory(L"Out of memory", 0);
+	}
 	
 	void* object = std::malloc(count);
-	if (!object)
+	if (!object) {
+		GC::out_of_memory();
 		throw OutOfMemory(L"Out of memory", 0);
+	}
 	
-	static_cast<gc_object*>(object)->self_size = count;
-	GC::memory_usage += count;
+	gc_object::allocated_sizes.emplace_back(object, count);
+	
+	// Request collection on the next safe point when heap grown enough
+	int64_t usage = GC::memory_usage += count;
+	if (usage >= GC::collect_threshold.load(std::memory_order_relaxed)) {
+		GC::collect_requested.store(1, std::memory_order_relaxed);
+		
+		// Executer picks it up on the next safepoint poll
+		gil_thread* thread = GIL::current_thread();
+		if (thread && !(thread->poll() & gil_thread::POLL_GC))
+			thread->request_poll(gil_thread::POLL_GC);
+		
+		// Close to the limit, collect even if paused
+		if (usage >= GC::MAX_HEAP_SIZE * GC::EMERGENCY_RATIO)
+			GC::emergency_requested.store(1, std::memory_order_relaxed);
+	}
 	
 	return object;
 };
 
-void gc_object::operator delete(void* ptr) {
-	GC::memory_usage -= static_cast<gc_object*>(ptr)->self_size;
+void gc_object::operator delete(void* ptr, std::size_t size) {
+	GC::memory_usage -= size;
+	
+	// Constructor has thrown or was not called, drop size passed to it
+	if (!allocated_sizes.empty() && allocated_sizes.back().first == ptr)
+		allocated_sizes.pop_back();
 	
 	std::free(ptr);
 };
 
-/*
-void gc_object::operator delete(void* ptr, std::size_t size) {
-	GC::memory_usage -= size;
+
+// gc_mark_stack
+void gc_mark_stack::visit(gc_object *o) {
+	if (o == nullptr || o->gc_is_reachable())
+		return;
 	
-	::operator delete(ptr, size);
+	o->gc_reach();
+	++marked;
+	stack.push_back(o);
 };
-*/
 
+void gc_mark_stack::drain() {
+	while (stack.size()) {
+		gc_object *o = stack.back();
+		stack.pop_back();
+		o->gc_trace(*this);
+	}
+};
+
+void gc_mark_stack::shrink() {
+	// Keep up to 64k pointers between collections
+	if (stack.capacity() > 65536)
+		std::vector<gc_object*>().swap(stack);
+};
+
+
+// gc_thread_state
+gc_thread_state::gc_thread_state() :
+				objects(nullptr),
+				size(0) {};
+
+gc_thread_state::~gc_thread_state() {};
 
-// gc_list
-gc_list::gc_list() : 
-				next(nullptr), 
-				obj(nullptr), 
-				deleted_ptr(0) {};
-				
 // GC		
 GC::GC() :
 		collecting(0),
 		size(0),
 		roots_size(0),
 		locks_size(0),
-		roots(nullptr),
-		locks(nullptr),
 		objects(nullptr), 
-		created_interval(0) {};
+		created_interval(0),
+		pause_depth(0),
+		heap_growth(GC::MIN_HEAP_GROWTH),
+		last_mark_time(0),
+		last_collect(std::chrono::steady_clock::now()),
+		fragmentation(0),
+		trimmed_free(0) {};
 
 GC::~GC() {
 	dispose();
+};
+void GC::attach_thread(gc_thread_state *state) {
+	if (state == nullptr)
+		return;
 	
-	while (objects) {
-		gc_list *c = objects;
-		objects = objects->next;
-		delete c;
-	}
+#ifndef CK_SINGLETHREAD
+	std::unique_lock<std::recursive_mutex> lk = protect();
+#endif
 	
-	while (roots) {
-		gc_list *c = roots;
-		roots = roots->next;
-		delete c;
-	}
+	thread_states.push_back(state);
+	local_state = state;
+};
+
+void GC::deattach_thread(gc_thread_state *state) {
+	if (state == nullptr)
+		return;
+	
+#ifndef CK_SINGLETHREAD
+	std::unique_lock<std::recursive_mutex> lk = protect();
+#endif
 	
-	while (locks) {
-		gc_list *c = locks;
-		locks = locks->next;
-		delete c;
+	merge_thread_state(state);
+	
+	for (int i = 0; i < thread_states.size(); ++i)
+		if (thread_states[i] == state) {
+			thread_states.erase(thread_states.begin() + i);
+			break;
+		}
+	
+	if (local_state == state)
+		local_state = nullptr;
+};
+
+void GC::merge_thread_state(gc_thread_state *state) {
+	// Take the whole list, owner thread continues with empty one
+	gc_object *list = state->objects.exchange(nullptr, std::memory_order_acquire);
+	if (list == nullptr)
+		return;
+	
+	int32_t amount = 1;
+	gc_object *tail = list;
+	while (tail->gc_next) {
+		tail = tail->gc_next;
+		++amount;
 	}
+	
+	state->size -= amount;
+	
+	tail->gc_next = objects;
+	objects       = list;
+	size             += amount;
+	created_interval += amount;
+};
+int32_t GC::count() {
+#ifndef CK_SINGLETHREAD
+	std::unique_lock<std::recursive_mutex> lk = protect();
+#endif
+	
+	int32_t total = size;
+	for (int i = 0; i < thread_states.size(); ++i)
+		total += thread_states[i]->size;
+	
+	return total;
+};
+
+void GC::set_heap_limit(int64_t size) {
+	GC::MAX_HEAP_SIZE = size < 8 * 1024 * 1024 ? 8 * 1024 * 1024 : size;
+	
+	if (GC::collect_threshold > GC::MAX_HEAP_SIZE)
+		GC::collect_threshold = GC::MAX_HEAP_SIZE / 2;
+};
+
+void GC::set_min_heap_trigger(int64_t size) {
+	GC::MIN_HEAP_TRIGGER  = size < 0 ? 0 : size;
+	GC::collect_threshold = GC::MIN_HEAP_TRIGGER;
+};
+
+bool GC::resume() {
+	int32_t depth = pause_depth;
+	while (depth > 0)
+		if (pause_depth.compare_exchange_weak(depth, depth - 1))
+			return 1;
+	
+	return 0;
 };
 
 // Called on object creation.
@@ -124,120 +266,156 @@ void GC::attach(gc_object *o) {
 	if (o == nullptr)
 		return;
 	
+	// Fast path, push into list of current thread
+	if (gc_thread_state *state = local_state) {
+		if (o->gc_header & gc_object::GC_RECORD)
+			return;
+		
+		o->gc_header |= gc_object::GC_RECORD;
+		
+		o->gc_next = state->objects.load(std::memory_order_relaxed);
+		while (!state->objects.compare_exchange_weak(o->gc_next, o, std::memory_order_release, std::memory_order_relaxed));
+		
+		++state->size;
+		return;
+	}
+	
 #ifndef CK_SINGLETHREAD 
-	std::unique_lock<std::recursive_mutex> lk(protect_lock);
+	std::unique_lock<std::recursive_mutex> lk = protect();
 	// GIL_lock lock; // в этой херне жопа, гц блочится на сборку, эта хня блочит этот поток, объект удаляют ещё до инициализации
 #endif
 
-	if (o->gc_record)
+	if (o->gc_header & gc_object::GC_RECORD)
 		return;
 	
-	gc_list *c = new gc_list;
-	if (!c)
-		throw OutOfMemory(L"GC list allocation error", 0);
-		
 	++created_interval;
 	
-	o->gc_record    = 1;
-	o->gc_reachable = 0;
-	o->gc_chain     = c;
+	o->gc_header |= gc_object::GC_RECORD;
 	
-	c->next = objects;
-	c->obj  = o;
-	objects = c;
+	o->gc_next = objects;
+	objects    = o;
 	++size;
 };
-
 // Called to make given object root object
 void GC::attach_root(gc_object *o) {
 	if (o == nullptr)
 		return;
 	
 #ifndef CK_SINGLETHREAD
-	std::unique_lock<std::recursive_mutex> lk(protect_lock);
+	std::unique_lock<std::recursive_mutex> lk = protect();
 #endif
 
-	if (o->gc_lock)
+	if (o->gc_header & gc_object::GC_ROOT)
 		return;
 	
-	gc_list *c = new gc_list;
-	if (!c)
-		throw OutOfMemory(L"GC list allocation error", 0);
-	
-	o->gc_root       = 1;
-	o->gc_reachable  = 0;
-	o->gc_root_chain = c;
+	o->gc_header |= gc_object::GC_ROOT;
+	++roots_size;
 	
-	c->next = roots;
-	c->obj  = o;
+	// Object could be unrooted and rooted again before the list was compacted
+	if (o->gc_header & gc_object::GC_ROOT_LISTED)
+		return;
 	
-	roots = c;
-	++roots_size;
+	o->gc_header |= gc_object::GC_ROOT_LISTED;
+	roots.push_back(o);
 };
-
 void GC::deattach_root(gc_object *o) {
 	if (o == nullptr)
 		return;
 	
 #ifndef CK_SINGLETHREAD
-	std::unique_lock<std::recursive_mutex> lk(protect_lock);
+	std::unique_lock<std::recursive_mutex> lk = protect();
 #endif
 
-	if (!o->gc_root)
+	if (!(o->gc_header & gc_object::GC_ROOT))
 		return;
 	
-	o->gc_root = 0;
+	o->gc_header &= ~(uint64_t) gc_object::GC_ROOT;
 	--roots_size;
 };
-
 // Called to lock given object from deletion.
 void GC::lock(gc_object *o) {
 	if (o == nullptr)
 		return;
 	
 #ifndef CK_SINGLETHREAD
-	std::unique_lock<std::recursive_mutex> lk(protect_lock);
+	std::unique_lock<std::recursive_mutex> lk = protect();
 #endif
 
-	if (o->gc_lock)
+	if (o->gc_header & gc_object::GC_LOCK)
 		return;
 	
-	gc_list *c = new gc_list;
-	if (!c)
-		throw OutOfMemory(L"GC list allocation error", 0);
-	
-	o->gc_lock       = 1;
-	o->gc_reachable  = 0;
-	o->gc_lock_chain = c;
+	o->gc_header |= gc_object::GC_LOCK;
+	++locks_size;
 	
-	c->next = locks;
-	c->obj  = o;
+	if (o->gc_header & gc_object::GC_LOCK_LISTED)
+		return;
 	
-	locks = c;
-	++locks_size;
+	o->gc_header |= gc_object::GC_LOCK_LISTED;
+	locks.push_back(o);
 };
-
 void GC::unlock(gc_object *o) {
 	if (o == nullptr)
 		return;
 	
 #ifndef CK_SINGLETHREAD
-	GIL_lock lock;
+	std::unique_lock<std::recursive_mutex> lk = protect();
 #endif
 
-	if (!o->gc_lock)
+	if (!(o->gc_header & gc_object::GC_LOCK))
 		return;
 	
-	o->gc_lock = 0;
+	o->gc_header &= ~(uint64_t) gc_object::GC_LOCK;
 	--locks_size;
 };
+void GC::attach_weak(gc_object *o) {
+	if (o == nullptr)
+		return;
+	
+#ifndef CK_SINGLETHREAD
+	std::unique_lock<std::recursive_mutex> lk = protect();
+#endif
+	
+	weak_holders.push_back(o);
+};
 
-void GC::collect(bool forced_collect) {
+void GC::process_weak() {
+#ifndef CK_SINGLETHREAD
+	std::unique_lock<std::recursive_mutex> lk = protect();
+#endif
 	
-	// XXX: Support for GC.collect on very deep objects (aka linked list with very large size)
+	// Values of weak keys can make other holders and keys reachable, 
+	//  so trace till nothing new is marked.
+	int64_t marked;
+	do {
+		marked = mark_stack.marked_count();
+		
+		for (int i = 0; i < weak_holders.size(); ++i)
+			if (weak_holders[i]->gc_is_reachable())
+				weak_holders[i]->gc_trace_weak(mark_stack);
+		
+		mark_stack.drain();
+	} while (marked != mark_stack.marked_count());
+	
+	// Drop unreachable holders, they are deleted by sweep
+	int j = 0;
+	for (int i = 0; i < weak_holders.size(); ++i)
+		if (weak_holders[i]->gc_is_reachable())
+			weak_holders[j++] = weak_holders[i];
+	weak_holders.resize(j);
+	
+	for (int i = 0; i < weak_holders.size(); ++i)
+		weak_holders[i]->gc_clear_weak();
+};
+
+void GC::collect(bool forced_collect) {
 	
 	// First check if collection can be performed
-	if (created_interval <= GC::MIN_GC_INTERVAL && !forced_collect)
+	if (!forced_collect && !collect_requested.load(std::memory_order_relaxed))
+		return;
+	
+	// Paused GC collects only when heap is close to the limit
+	bool emergency = emergency_requested.load(std::memory_order_relaxed);
+	if (!forced_collect && !emergency && pause_depth > 0)
 		return;
 	
 	if (collecting)
@@ -247,100 +425,351 @@ void GC::collect(bool forced_collect) {
 	if (!GIL::instance()->try_request_lock())
 		return;
 	
+	{
+	#ifndef CK_SINGLETHREAD
+		std::unique_lock<std::recursive_mutex> lk = protect();
+	#endif
+		
+		// Collect objects created by all threads
+		for (int i = 0; i < thread_states.size(); ++i)
+			merge_thread_state(thread_states[i]);
+	}
+	
+	if (created_interval <= GC::MIN_GC_INTERVAL && !forced_collect && !emergency) {
+		collect_requested = 0;
+		GIL::instance()->dequest_lock();
+		return;
+	}
 	
 	created_interval = 0;
 	collecting = 1;
+	collect_requested   = 0;
+	emergency_requested = 0;
 	
 	if (objects == nullptr) {
 		collecting = 0;
+		GIL::instance()->dequest_lock();
 		return;
 	}
 	
-	// Mark all roots
-	gc_list *chain = roots;
-	gc_list *list  = nullptr;
+	auto collect_start = std::chrono::steady_clock::now();
+	
+	// Mark all roots, drop unrooted
+	int j = 0;
+	for (int i = 0; i < roots.size(); ++i)
+		if (roots[i]->gc_header & gc_object::GC_ROOT) {
+			mark_stack.visit(roots[i]);
+			roots[j++] = roots[i];
+		} else
+			roots[i]->gc_header &= ~(uint64_t) gc_object::GC_ROOT_LISTED;
+	roots.resize(j);
+	
+	// Mark all locked objects, drop unlocked
+	j = 0;
+	for (int i = 0; i < locks.size(); ++i)
+		if (locks[i]->gc_header & gc_object::GC_LOCK) {
+			mark_stack.visit(locks[i]);
+			locks[j++] = locks[i];
+		} else
+			locks[i]->gc_header &= ~(uint64_t) gc_object::GC_LOCK_LISTED;
+	locks.resize(j);
+	
+	// Mark handles of all threads
+	{
+	#ifndef CK_SINGLETHREAD
+		std::unique_lock<std::recursive_mutex> lk = protect();
+	#endif
+		
+		for (int i = 0; i < thread_states.size(); ++i)
+			for (int j = 0; j < thread_states[i]->handles.size(); ++j)
+				mark_stack.visit(thread_states[i]->handles[j]);
+	}
+	
+	// Trace everything reachable from roots, locks and handles
+	mark_stack.drain();
+	
+	// Clear weak references to objects that will be swept
+	process_weak();
+	mark_stack.shrink();
+	
+	int64_t mark_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - collect_start).count();
+	
+	// Sweep all objects
+	gc_object *chain = objects;
+	gc_object *list  = nullptr;
 	while (chain) {
-		if (chain->deleted_ptr) {
-			gc_list *tmp = chain;
-			chain         = chain->next;
-			delete tmp;
-		} else if (!chain->obj->gc_root) {
-			chain->obj->gc_root_chain = nullptr;
+		gc_object *o = chain;
+		chain = chain->gc_next;
+		
+		if (!(o->gc_header & (gc_object::GC_REACHABLE | gc_object::GC_ROOT | gc_object::GC_LOCK))) {
+			--size;
+			o->gc_finalize();
 			
-			gc_list *tmp = chain;
-			chain         = chain->next;
-			delete tmp;
+			delete o;
 		} else {
-			chain->obj->gc_mark();
-			gc_list *tmp = chain;
-			chain         = chain->next;
+			// Reset
+			o->gc_header &= ~(uint64_t) gc_object::GC_REACHABLE;
 			
-			tmp->next = list;
-			list      = tmp;
+			o->gc_next = list;
+			list       = o;
 		}
+	};
+	
+	objects = list;
+	
+	update_pacer(mark_time, collect_start);
+	
+	trim_heap();
+
+	collecting = 0;	
+	
+	GIL::instance()->dequest_lock();
+};
+
+void GC::update_pacer(int64_t mark_time, std::chrono::steady_clock::time_point collect_start) {
+	int64_t mutator_time = std::chrono::duration_cast<std::chrono::microseconds>(collect_start - last_collect).count();
+	
+	// Marking takes too much of the run time, let the heap grow more between collections.
+	// Else shrink it back to keep memory usage low.
+	if (mark_time > mutator_time * GC::GC_TIME_RATIO)
+		heap_growth = std::min(heap_growth * 1.25, GC::MAX_HEAP_GROWTH);
+	else
+		heap_growth = std::max(heap_growth * 0.9, GC::MIN_HEAP_GROWTH);
+	
+	int64_t threshold = std::max(GC::MIN_HEAP_TRIGGER, (int64_t) (memory_usage * heap_growth));
+	
+	// Close to the limit heap should be collected more frequently rather than fail
+	if (threshold > GC::MAX_HEAP_SIZE)
+		threshold = memory_usage + (GC::MAX_HEAP_SIZE - memory_usage) / 2;
+	
+	collect_threshold = threshold;
+	last_mark_time    = mark_time;
+	last_collect      = std::chrono::steady_clock::now();
+};
+
+double GC::measure_fragmentation() {
+#ifdef CK_GC_MALLINFO
+	struct mallinfo2 info = mallinfo2();
+	if (info.arena == 0)
+		return 0;
+	
+	// Free space at the top of the heap is released by malloc itself, 
+	//  the rest is spread between used blocks.
+	return (double) (info.fordblks - info.keepcost) / (double) info.arena;
+#else
+	return 0;
+#endif
+};
+
+bool GC::release_free_memory() {
+#ifdef CK_GC_MALLINFO
+	return malloc_trim(0);
+#else
+	return 0;
+#endif
+};
+
+void GC::trim_heap() {
+#ifdef CK_GC_MALLINFO
+	struct mallinfo2 info = mallinfo2();
+	if (info.arena == 0)
+		return;
+	
+	int64_t trapped = info.fordblks - info.keepcost;
+	fragmentation   = (double) trapped / (double) info.arena;
+	
+	// Free memory was reused since last trim
+	if (trapped < trimmed_free)
+		trimmed_free = trapped;
+	
+	// Objects never move, so the best way to reduce RSS is to give 
+	//  free pages between them back to the system.
+	if (GC::TRIM_RATIO > 0 && fragmentation > GC::TRIM_RATIO && trapped - trimmed_free > GC::MIN_TRIM_SIZE) {
+		malloc_trim(0);
+		trimmed_free = trapped;
 	}
+#endif
+};
+
+bool GC::stop_world() {
+	bool requested = 0;
 	
-	roots = list;
+#ifndef CK_SINGLETHREAD
+	// Wait for other thread to finish it's request
+	if (GIL::current_thread() && !GIL::current_thread()->owns_gil()) {
+		while (!GIL::instance()->try_request_lock())
+			GIL::instance()->accept_lock();
+		requested = 1;
+	}
 	
-	// Mark all locked objects
-	chain = locks;
-	list  = nullptr;
-	while (chain) {
-		if (chain->deleted_ptr) {
-			gc_list *tmp = chain;
-			chain         = chain->next;
-			delete tmp;
-		} else if (!chain->obj->gc_lock) {
-			chain->obj->gc_lock_chain = nullptr;
+	std::unique_lock<std::recursive_mutex> lk = protect();
+#endif
+	
+	for (int i = 0; i < thread_states.size(); ++i)
+		merge_thread_state(thread_states[i]);
+	
+	return requested;
+};
+
+void GC::resume_world(bool requested) {
+	if (requested)
+		GIL::instance()->dequest_lock();
+};
+
+std::string GC::type_name(gc_object *o) {
+	const char *mangled = typeid(*o).name();
+	
+	// Demangling is slow, snapshot asks for each object
+	static thread_local std::map<const char*, std::string> names;
+	auto cached = names.find(mangled);
+	if (cached != names.end())
+		return cached->second;
+	
+	int status = 0;
+	char *demangled = abi::__cxa_demangle(mangled, nullptr, nullptr, &status);
+	std::string name = status == 0 && demangled ? demangled : mangled;
+	std::free(demangled);
+	
+	// ck_objects::Array -> Array
+	std::size_t ns = name.rfind("::");
+	if (ns != std::string::npos)
+		name = name.substr(ns + 2);
+	
+	names[mangled] = name;
+	return name;
+};
+
+// Collects all references of traced object
+class gc_edge_recorder : public gc_visitor {
+	
+public:
+	
+	std::vector<gc_object*> edges;
+	
+	void visit(gc_object *o) {
+		if (o != nullptr)
+			edges.push_back(o);
+	};
+};
+
+bool GC::dump_heap(const std::string &path) {
+	std::ofstream out(path);
+	if (!out)
+		return 0;
+	
+	bool requested = stop_world();
+	
+	{
+	#ifndef CK_SINGLETHREAD
+		std::unique_lock<std::recursive_mutex> lk = protect();
+	#endif
+		
+		out << "{\"version\":1,\"used_memory\":" << memory_usage << ",\"objects\":[";
+		
+		// Objects with type, size and outgoing edges
+		gc_edge_recorder recorder;
+		bool first = 1;
+		for (gc_object *o = objects; o; o = o->gc_next) {
+			recorder.edges.clear();
+			o->gc_trace(recorder);
 			
-			gc_list *tmp = chain;
-			chain         = chain->next;
-			delete tmp;
-		} else {
-			chain->obj->gc_mark();
-			gc_list *tmp = chain;
-			chain        = chain->next;
+			out << (first ? "" : ",") << "\n{\"id\":" << (uintptr_t) o 
+			    << ",\"type\":\"" << type_name(o) 
+			    << "\",\"size\":" << o->get_size() 
+			    << ",\"edges\":[";
+			for (int i = 0; i < recorder.edges.size(); ++i)
+				out << (i ? "," : "") << (uintptr_t) recorder.edges[i];
+			out << "]}";
 			
-			tmp->next = list;
-			list      = tmp;
+			first = 0;
 		}
+		
+		// Roots with their origin
+		out << "\n],\"roots\":[";
+		first = 1;
+		for (int i = 0; i < roots.size(); ++i) 
+			if (roots[i]->gc_is_root()) {
+				out << (first ? "" : ",") << "\n{\"id\":" << (uintptr_t) roots[i] << ",\"origin\":\"root\"}";
+				first = 0;
+			}
+		
+		for (int i = 0; i < locks.size(); ++i) 
+			if (locks[i]->gc_is_lock()) {
+				out << (first ? "" : ",") << "\n{\"id\":" << (uintptr_t) locks[i] << ",\"origin\":\"lock\"}";
+				first = 0;
+			}
+		
+		for (int i = 0; i < thread_states.size(); ++i)
+			for (int j = 0; j < thread_states[i]->handles.size(); ++j) 
+				if (thread_states[i]->handles[j]) {
+					out << (first ? "" : ",") << "\n{\"id\":" << (uintptr_t) thread_states[i]->handles[j] << ",\"origin\":\"handle\",\"thread\":" << i << "}";
+					first = 0;
+				}
+		
+		out << "\n]}\n";
 	}
 	
-	locks = list;
-	
-	// Mark all objects
-	chain = objects;
-	list  = nullptr;
-	while (chain) {	
-		if (chain->deleted_ptr) {
-			gc_list *tmp = chain;
-			chain = chain->next;
-			--size;			
-			delete tmp;
-		} else if (!chain->obj->gc_reachable && !chain->obj->gc_root && !chain->obj->gc_lock) {			
-			gc_list *tmp = chain;
-			chain = chain->next;
-			--size;
-			tmp->obj->gc_finalize();
+	resume_world(requested);
+	
+	out.close();
+	return !out.fail();
+};
 
-			delete tmp->obj;
-			delete tmp;			
-		} else {
-			// Reset
-			chain->obj->gc_reachable = 0;
-			gc_list *tmp = chain;
-			chain         = chain->next;
-			
-			tmp->next = list;
-			list      = tmp;
+std::vector<gc_census_entry> GC::census() {
+	std::map<std::string, gc_census_entry> types;
+	
+	bool requested = stop_world();
+	
+	{
+	#ifndef CK_SINGLETHREAD
+		std::unique_lock<std::recursive_mutex> lk = protect();
+	#endif
+		
+		for (gc_object *o = objects; o; o = o->gc_next) {
+			gc_census_entry &entry = types[type_name(o)];
+			++entry.count;
+			entry.bytes += o->get_size();
 		}
-	};
+	}
 	
-	objects = list;
+	resume_world(requested);
+	
+	std::vector<gc_census_entry> result;
+	for (auto &type : types) {
+		type.second.type = type.first;
+		result.push_back(type.second);
+	}
+	
+	std::sort(result.begin(), result.end(), [](const gc_census_entry &a, const gc_census_entry &b) -> bool {
+		return a.bytes > b.bytes;
+	});
+	
+	return result;
+};
 
-	collecting = 0;	
+void GC::out_of_memory() {
+	static std::atomic<bool> dumped(0);
 	
-	GIL::instance()->dequest_lock();
+	if (GC::HEAP_DUMP_ON_OOM.empty() || dumped.exchange(1))
+		return;
+	
+	// Objects created by native code may be not rooted yet, 
+	//  so world is stopped later, on the safe point
+	GC::dump_requested = 1;
+	
+	gil_thread* thread = GIL::current_thread();
+	if (thread)
+		thread->request_poll(gil_thread::POLL_GC);
+};
+
+void GC::dump_pending_heap() {
+	if (collecting || !dump_requested.exchange(0))
+		return;
+	
+	if (dump_heap(GC::HEAP_DUMP_ON_OOM))
+		std::wcerr << "Heap snapshot written to " << GC::HEAP_DUMP_ON_OOM.c_str() << std::endl;
+	else
+		std::wcerr << "Failed to write heap snapshot to " << GC::HEAP_DUMP_ON_OOM.c_str() << std::endl;
 };
 
 void GC::dispose() {	
@@ -355,33 +784,29 @@ void GC::dispose() {
 	
 	collecting = 1;
 	
+	for (int i = 0; i < thread_states.size(); ++i)
+		merge_thread_state(thread_states[i]);
+	
+	// Holders are deleted with the rest of objects
+	weak_holders.clear();
+	
 	if (objects == nullptr) {
 		collecting = 0;
 		return;
 	}
 	
-	while (roots) {
-		gc_list *tmp = roots->next;
-		if (!roots->deleted_ptr)
-			roots->obj->gc_root_chain = nullptr;
-		delete roots;
-		roots = tmp;
-	}
-	
+	roots.clear();
+	locks.clear();
 	
 	// Delete all unused objects
 	while (objects) {
-		gc_list *tmp = objects->next;
-		if (objects->deleted_ptr) {
-			delete objects;
-		} else {
-			--size;
-			objects->obj->gc_finalize();
+		gc_object *o = objects;
+		objects = objects->gc_next;
+		
+		--size;
+		o->gc_finalize();
 			
-			delete objects->obj;
-			delete objects;
-		} 
-		objects = tmp;
+		delete o;
 	}
 	
 	collecting = 0;
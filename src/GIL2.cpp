@@ -7,6 +7,7 @@
 #include <csignal>
 
 #include "executer.h"
+#include "event_loop.h"
 #include "exceptions.h"
 #include "vobject.h"
 #include "GC.h"
@@ -22,6 +23,7 @@ thread_local gil_thread*       GIL::current_thread_ptr = nullptr;
 GIL*                           GIL::gil_instance       = nullptr;
 thread_local ck_executer*      GIL::executer           = nullptr;
 std::atomic<uint64_t>   gil_thread::thread_counter     = 0;
+std::atomic<bool>       ck_core::multithreaded         = 0;
 
 
 // GIL constructor is called on main() call.
@@ -41,6 +43,7 @@ GIL::GIL() { // : sync_lock(sync_mutex, sync_condition) {
 	
 	// Create GC instance before any object is created
 	GIL::gc = new GC();
+	GIL::gc->attach_thread(&current_thread_ptr->gc_state);
 	// Create executer instance mapped to current Thread0
 	GIL::executer = new ck_executer();
 	
@@ -148,6 +151,10 @@ void ck_core::thread_spawn_wrapper(ck_core::thread_spawner_args* args) {
 	
 	// Copy pointers to GIL values
 	GIL::gil_instance = args->gil; // unused, static
+	
+	// Bind allocation list before any object is created by this thread
+	GIL::gc_instance()->attach_thread(&GIL::current_thread_ptr->gc_state);
+	
 	GIL::executer     = new ck_core::ck_executer();
 	
 	// Copy id of thread, requires thread-safe
@@ -176,10 +183,20 @@ void ck_core::thread_spawn_wrapper(ck_core::thread_spawner_args* args) {
 	// Dispose instance of thread if it still exist
 	GIL::instance()->lock();
 	
+	// Drop callbacks posted to this thread, no one is able to post during GIL lock
+	GIL::current_thread_ptr->get_mailbox().close();
+	
 	// Dispose used values
 	delete GIL::executer;
 	delete args;
 	
+	// Drop asynchronous I/O requests of this thread
+	if (ck_core::event_loop::exists())
+		ck_core::event_loop::instance()->release(GIL::current_thread_ptr);
+	
+	// Pass objects of this thread to GC
+	GIL::gc_instance()->deattach_thread(&GIL::current_thread_ptr->gc_state);
+	
 	// Mark thread as dead
 	GIL::current_thread_ptr->set_running(0);
 	
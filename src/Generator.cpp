@@ -0,0 +1,161 @@
+#include "objects/Generator.h"
+
+#include <string>
+
+#include "exceptions.h"
+#include "GIL2.h"
+#include "executer.h"
+
+#include "objects/Object.h"
+#include "objects/Int.h"
+#include "objects/Bool.h"
+#include "objects/Array.h"
+#include "objects/NativeFunction.h"
+#include "objects/Undefined.h"
+#include "objects/String.h"
+
+using namespace std;
+using namespace ck_exceptions;
+using namespace ck_vobject;
+using namespace ck_objects;
+using namespace ck_core;
+
+
+static vobject* call_handler(vscope* scope, const vector<vobject*>& args) {
+	throw UnsupportedOperation(L"Generator can not be constructed directly");
+};
+
+vobject* Generator::create_proto() {
+	if (GeneratorProto != nullptr)
+		return GeneratorProto;
+	
+	GeneratorProto = new CallableObject(call_handler);
+	GIL::gc_instance()->attach_root(GeneratorProto);
+	
+	GeneratorProto->Object::put(L"__typename", new String(L"Generator"));
+	
+	// next(value) -> { value: yielded value, done: generator returned }
+	GeneratorProto->Object::put(L"next", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Generator>())
+				return Undefined::instance();
+			
+			bool done;
+			vobject* value = static_cast<Generator*>(__this)->next(args.size() ? args[0] : nullptr, done);
+			
+			return new Object({ { L"value", value }, { L"done", Bool::instance(done) } });
+		}));
+	GeneratorProto->Object::put(L"isDone", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Generator>())
+				return Undefined::instance();
+			
+			return Bool::instance(static_cast<Generator*>(__this)->is_done());
+		}));
+	// toArray(limit) -> Array of yielded values, limit is optional
+	GeneratorProto->Object::put(L"toArray", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Generator>())
+				return Undefined::instance();
+			
+			int64_t limit = -1;
+			if (args.size() && args[0] && !args[0]->as_type<Undefined>())
+				limit = args[0]->int_value();
+			
+			Array* result = new Array();
+			
+			// Generator body may run GC
+			gc_handle_scope handles;
+			handles.add(result);
+			
+			bool done = 0;
+			while (limit < 0 || result->size() < limit) {
+				vobject* value = static_cast<Generator*>(__this)->next(nullptr, done);
+				if (done)
+					break;
+				
+				result->items().push_back(value);
+			}
+			
+			return result;
+		}));
+	
+	return GeneratorProto;
+};
+
+
+Generator::Generator(BytecodeFunction* function, vscope* scope, const std::wstring& name) : function(function), scope(scope), name(name) {};
+
+Generator::~Generator() {};
+
+
+vobject* Generator::get(vscope* scope, const wstring& name) {
+	vobject* ret = Object::get(name);
+	
+	if (!ret && GeneratorProto)
+		return GeneratorProto->get(scope, name);
+	return ret;
+};
+
+void Generator::put(vscope* scope, const wstring& name, vobject* object) {
+	Object::put(name, object);
+};
+
+bool Generator::contains(vscope* scope, const wstring& name) {
+	return Object::contains(name) || (GeneratorProto && GeneratorProto->contains(scope, name));
+};
+
+bool Generator::remove(vscope* scope, const wstring& name) {
+	if (Object::remove(name))
+		return 1;
+	return 0;
+};
+
+vobject* Generator::call(vscope* scope, const vector<vobject*>& args) {
+	throw UnsupportedOperation(L"Generator is not callable");
+};
+
+
+void Generator::gc_trace(gc_visitor& visitor) {
+	Object::gc_trace(visitor);
+	
+	visitor.visit(function);
+	visitor.visit(scope);
+	
+	// Saved frame of suspended generator
+	for (int i = 0; i < frame.objects.size(); ++i)
+		visitor.visit(frame.objects[i]);
+	for (int i = 0; i < frame.scopes.size(); ++i)
+		visitor.visit(frame.scopes[i]);
+};
+
+void Generator::gc_finalize() {};
+
+// Generator functions only
+
+vobject* Generator::next(vobject* value, bool& done) {
+	ck_executer* executer = GIL::executer_instance();
+	if (!executer)
+		throw IllegalStateError(L"no executer to resume Generator");
+	
+	return executer->resume_generator(this, value, done);
+};
+
+// Must return integer representation of an object
+int64_t Generator::int_value() {
+	return (intptr_t) this;
+};
+
+// Must return string representation of an object
+std::wstring Generator::string_value() {
+	return std::wstring(L"[Generator ") + std::to_wstring((intptr_t) this) + std::wstring(L"]");
+};
@@ -0,0 +1,289 @@
+#include "objects/IO.h"
+
+#include <string>
+#include <locale>
+#include <codecvt>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "exceptions.h"
+#include "GIL2.h"
+#include "event_loop.h"
+
+#include "objects/Object.h"
+#include "objects/Int.h"
+#include "objects/Bool.h"
+#include "objects/Array.h"
+#include "objects/NativeFunction.h"
+#include "objects/Undefined.h"
+#include "objects/String.h"
+
+using namespace std;
+using namespace ck_exceptions;
+using namespace ck_vobject;
+using namespace ck_objects;
+using namespace ck_core;
+
+
+// Switches descriptor to non-blocking mode, so reactor never stalls on it
+static void set_nonblocking(int fd) {
+	int flags = fcntl(fd, F_GETFL);
+	if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)
+		throw IOError(L"failed to set non-blocking mode on descriptor " + to_wstring(fd));
+};
+
+// Returns callback argument if it is present
+static vobject* callback_arg(const vector<vobject*>& args, int index) {
+	if (args.size() <= index || !args[index] || args[index]->as_type<Undefined>())
+		return nullptr;
+	return args[index];
+};
+
+static vobject* call_handler(vscope* scope, const vector<vobject*>& args) {
+	if (!args.size() || !args[0] || !args[0]->as_type<Int>() || args[0]->int_value() < 0)
+		throw IllegalArgumentError(L"IO expected file descriptor");
+	
+	int fd = args[0]->int_value();
+	set_nonblocking(fd);
+	
+	return new IO(fd);
+};
+
+vobject* IO::create_proto() {
+	if (IOProto != nullptr)
+		return IOProto;
+	
+	IOProto = new CallableObject(call_handler);
+	GIL::gc_instance()->attach_root(IOProto);
+	
+	IOProto->Object::put(L"__typename", new String(L"IO"));
+	
+	// read(callback) -> Future of the next chunk, undefined on the end of input
+	IOProto->Object::put(L"read", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<IO>())
+				return Undefined::instance();
+			
+			return static_cast<IO*>(__this)->read(0, callback_arg(args, 0));
+		}));
+	// readAll(callback) -> Future of all data till the end of input
+	IOProto->Object::put(L"readAll", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<IO>())
+				return Undefined::instance();
+			
+			return static_cast<IO*>(__this)->read(1, callback_arg(args, 0));
+		}));
+	// write(string, callback) -> Future of amount of written bytes
+	IOProto->Object::put(L"write", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<IO>())
+				return Undefined::instance();
+			
+			if (!args.size() || !args[0])
+				throw IllegalArgumentError(L"IO.write expected data");
+			
+			return static_cast<IO*>(__this)->write(args[0]->string_value(), callback_arg(args, 1));
+		}));
+	// Returns exit status of process or 0
+	IOProto->Object::put(L"close", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<IO>())
+				return Undefined::instance();
+			
+			return new Int(static_cast<IO*>(__this)->close());
+		}));
+	IOProto->Object::put(L"isClosed", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<IO>())
+				return Undefined::instance();
+			
+			return Bool::instance(static_cast<IO*>(__this)->is_closed());
+		}));
+	IOProto->Object::put(L"getFd", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<IO>())
+				return Undefined::instance();
+			
+			return new Int(static_cast<IO*>(__this)->get_fd());
+		}));
+	
+	// Static functions
+	
+	// pipe() -> [reader, writer]
+	IOProto->Object::put(L"pipe", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			int fds[2];
+			if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) == -1)
+				throw IOError(L"failed to create pipe");
+			
+			return new Array({ new IO(fds[0], 1), new IO(fds[1], 1) });
+		}));
+	// popen(command, mode) -> IO connected to process input or output, mode is 'r' or 'w'
+	IOProto->Object::put(L"popen", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			if (!args.size() || !args[0] || !args[0]->as_type<String>())
+				throw IllegalArgumentError(L"IO.popen expected command");
+			
+			std::wstring mode = L"r";
+			if (args.size() > 1 && args[1] && !args[1]->as_type<Undefined>())
+				mode = args[1]->string_value();
+			
+			if (mode != L"r" && mode != L"w")
+				throw IllegalArgumentError(L"IO.popen expected mode 'r' or 'w'");
+			
+			std::string command = std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>>().to_bytes(args[0]->string_value());
+			
+			FILE* process = popen(command.c_str(), mode == L"r" ? "re" : "we");
+			if (!process)
+				throw IOError(L"failed to start process");
+			
+			int fd = fileno(process);
+			set_nonblocking(fd);
+			
+			return new IO(fd, 1, process);
+		}));
+	// Runs callbacks of I/O requests of the current thread till all of them are completed
+	IOProto->Object::put(L"run", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			if (event_loop::exists())
+				event_loop::instance()->run();
+			
+			return Undefined::instance();
+		}));
+	
+	return IOProto;
+};
+
+
+IO::IO(int fd, bool owned, FILE* process) : fd(fd), process(process), owned(owned) {};
+
+IO::~IO() {};
+
+
+vobject* IO::get(vscope* scope, const wstring& name) {
+	vobject* ret = Object::get(name);
+	
+	if (!ret && IOProto)
+		return IOProto->get(scope, name);
+	return ret;
+};
+
+void IO::put(vscope* scope, const wstring& name, vobject* object) {
+	Object::put(name, object);
+};
+
+bool IO::contains(vscope* scope, const wstring& name) {
+	return Object::contains(name) || (IOProto && IOProto->contains(scope, name));
+};
+
+bool IO::remove(vscope* scope, const wstring& name) {
+	if (Object::remove(name))
+		return 1;
+	return 0;
+};
+
+vobject* IO::call(vscope* scope, const vector<vobject*>& args) {
+	throw UnsupportedOperation(L"IO is not callable");
+};
+
+
+void IO::gc_trace(gc_visitor& visitor) {
+	Object::gc_trace(visitor);
+};
+
+void IO::gc_finalize() {
+	// Pending requests keep object alive, so it is never closed under the loop
+	if (owned)
+		close();
+};
+
+// IO functions only
+
+Future* IO::read(bool all, vobject* callback) {
+	if (closed)
+		throw IOError(L"IO is closed");
+	
+	io_request* request = new io_request();
+	request->type     = all ? io_request::READ_ALL : io_request::READ;
+	request->fd       = fd;
+	request->source   = this;
+	request->future   = new Future();
+	request->callback = callback;
+	
+	Future* future = request->future;
+	event_loop::instance()->submit(request);
+	
+	return future;
+};
+
+Future* IO::write(const std::wstring& data, vobject* callback) {
+	if (closed)
+		throw IOError(L"IO is closed");
+	
+	io_request* request = new io_request();
+	request->type     = io_request::WRITE;
+	request->fd       = fd;
+	request->buffer   = std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>>().to_bytes(data);
+	request->source   = this;
+	request->future   = new Future();
+	request->callback = callback;
+	
+	Future* future = request->future;
+	event_loop::instance()->submit(request);
+	
+	return future;
+};
+
+int IO::close() {
+	std::unique_lock<std::mutex> lk(close_mutex);
+	
+	if (closed)
+		return 0;
+	closed = 1;
+	
+	if (event_loop::exists())
+		event_loop::instance()->close(fd);
+	
+	if (process) {
+		int status = pclose(process);
+		process = nullptr;
+		
+		if (status != -1 && WIFEXITED(status))
+			return WEXITSTATUS(status);
+		return status;
+	}
+	
+	::close(fd);
+	return 0;
+};
+
+// Must return integer representation of an object
+int64_t IO::int_value() {
+	return fd;
+};
+
+// Must return string representation of an object
+std::wstring IO::string_value() {
+	return std::wstring(L"[IO ") + std::to_wstring(fd) + std::wstring(L"]");
+};
@@ -0,0 +1,496 @@
+#include "objects/Isolate.h"
+
+#include <string>
+#include <chrono>
+#include <thread>
+#include <locale>
+#include <codecvt>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+
+#include <spawn.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+
+#include "exceptions.h"
+#include "GIL2.h"
+#include "structured_clone.h"
+
+#include "objects/Object.h"
+#include "objects/Int.h"
+#include "objects/Bool.h"
+#include "objects/NativeFunction.h"
+#include "objects/Undefined.h"
+#include "objects/String.h"
+
+extern char** environ;
+
+using namespace std;
+using namespace ck_exceptions;
+using namespace ck_vobject;
+using namespace ck_objects;
+using namespace ck_core;
+
+
+// Descriptor of channel to parent in isolate process
+static const int ISOLATE_FD = 3;
+
+// Environment variable passing channel descriptor to isolate process
+static const char* ISOLATE_ENV = "CK_ISOLATE_FD";
+
+// Amount of bytes in message length prefix
+static const size_t HEADER_SIZE = 4;
+
+// Processes of collected isolates that were not joined.
+// They exit after seeing closed channel and are reaped later.
+static std::mutex         orphans_mutex;
+static std::vector<pid_t> orphans;
+
+// Reaps exited orphan processes without blocking
+static void reap_orphans() {
+	std::unique_lock<std::mutex> lk(orphans_mutex);
+	
+	for (int i = 0; i < orphans.size();) {
+		int status;
+		pid_t result = waitpid(orphans[i], &status, WNOHANG);
+		
+		if (result == orphans[i] || (result == -1 && errno != EINTR))
+			orphans.erase(orphans.begin() + i);
+		else
+			++i;
+	}
+};
+
+
+// isolate_channel
+
+void isolate_channel::post(vobject* value) {
+	// Encode while holding GIL, objects may change after blocking
+	std::string payload = structured_clone::serialize(value);
+	
+	std::string message(HEADER_SIZE, '\0');
+	for (int i = 0; i < HEADER_SIZE; ++i)
+		message[i] = (payload.size() >> (8 * i)) & 0xFF;
+	message += payload;
+	
+	bool failed = 0;
+	
+	GIL::instance()->io_block();
+	
+	{
+		std::unique_lock<std::mutex> lk(write_mutex);
+		
+		size_t offset = 0;
+		while (offset < message.size()) {
+			if (fd == -1) {
+				failed = 1;
+				break;
+			}
+			
+			ssize_t written = ::send(fd, message.data() + offset, message.size() - offset, MSG_NOSIGNAL);
+			if (written == -1) {
+				if (errno == EINTR)
+					continue;
+				
+				failed = 1;
+				break;
+			}
+			
+			offset += written;
+		}
+	}
+	
+	GIL::instance()->io_unblock();
+	
+	if (failed)
+		throw IOError(L"Isolate channel is closed");
+};
+
+vobject* isolate_channel::receive(int64_t timeout) {
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeout, (int64_t) 0));
+	
+	std::string payload;
+	bool received = 0;
+	
+	GIL::instance()->io_block();
+	
+	{
+		std::unique_lock<std::mutex> lk(read_mutex);
+		
+		// Wake up periodically to notice termination
+		while (GIL::current_thread()->is_running()) {
+			// Check for complete message in inbox
+			if (inbox.size() >= HEADER_SIZE) {
+				size_t size = 0;
+				for (int i = 0; i < HEADER_SIZE; ++i)
+					size |= (size_t) (unsigned char) inbox[i] << (8 * i);
+				
+				if (inbox.size() - HEADER_SIZE >= size) {
+					payload = inbox.substr(HEADER_SIZE, size);
+					inbox.erase(0, HEADER_SIZE + size);
+					received = 1;
+					break;
+				}
+			}
+			
+			if (fd == -1)
+				break;
+			
+			int64_t wait = 100;
+			if (timeout >= 0)
+				wait = std::min(wait, std::max((int64_t) 0, (int64_t) std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count()));
+			
+			pollfd pfd = { fd, POLLIN, 0 };
+			int ready = ::poll(&pfd, 1, wait);
+			
+			if (ready == -1 && errno != EINTR)
+				break;
+			
+			if (ready <= 0) {
+				if (timeout >= 0 && std::chrono::steady_clock::now() >= deadline)
+					break;
+				continue;
+			}
+			
+			char buffer[65536];
+			ssize_t size = ::recv(fd, buffer, sizeof(buffer), 0);
+			
+			if (size > 0)
+				inbox.append(buffer, size);
+			else if (size == 0 || (errno != EINTR && errno != EAGAIN))
+				// Other side closed the channel
+				break;
+		}
+	}
+	
+	GIL::instance()->io_unblock();
+	
+	if (!received)
+		return nullptr;
+	
+	return structured_clone::deserialize(payload);
+};
+
+void isolate_channel::close() {
+	if (fd == -1)
+		return;
+	
+	// Wake up threads waiting on the channel
+	::shutdown(fd, SHUT_RDWR);
+	
+	std::unique_lock<std::mutex> wlk(write_mutex);
+	std::unique_lock<std::mutex> rlk(read_mutex);
+	
+	if (fd != -1) {
+		::close(fd);
+		fd = -1;
+	}
+};
+
+
+// Returns timeout argument or -1 if it is missing
+static int64_t timeout_arg(const vector<vobject*>& args) {
+	if (!args.size() || !args[0] || args[0]->as_type<Undefined>())
+		return -1;
+	return args[0]->int_value();
+};
+
+static vobject* call_handler(vscope* scope, const vector<vobject*>& args) {
+	if (!args.size() || !args[0] || !args[0]->as_type<String>())
+		throw IllegalArgumentError(L"Isolate expected script path");
+	
+	std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
+	
+	std::string path = converter.to_bytes(args[0]->string_value());
+	
+	std::vector<std::string> sargs;
+	for (int i = 1; i < args.size(); ++i)
+		sargs.push_back(converter.to_bytes(args[i] ? args[i]->string_value() : L"undefined"));
+	
+	return new Isolate(path, sargs);
+};
+
+vobject* Isolate::create_proto() {
+	if (IsolateProto != nullptr)
+		return IsolateProto;
+	
+	// Take channel to parent before any other process is started
+	parent();
+	
+	IsolateProto = new CallableObject(call_handler);
+	GIL::gc_instance()->attach_root(IsolateProto);
+	
+	IsolateProto->Object::put(L"__typename", new String(L"Isolate"));
+	
+	// post(value) sends clone of value to isolate.
+	// Isolate.post(value) called in isolate sends value to parent.
+	IsolateProto->Object::put(L"post", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			vobject* __this = scope ? scope->get(L"__this", 1) : nullptr;
+			vobject* value  = args.size() ? args[0] : nullptr;
+			
+			if (__this && __this->as_type<Isolate>()) {
+				static_cast<Isolate*>(__this)->post(value);
+				return Undefined::instance();
+			}
+			
+			isolate_channel* channel = Isolate::parent();
+			if (!channel)
+				throw IllegalStateError(L"interpreter is not running as Isolate");
+			
+			channel->post(value);
+			return Undefined::instance();
+		}));
+	// receive(timeout) returns next message from isolate or undefined on timeout and closed channel.
+	// Isolate.receive(timeout) called in isolate returns message from parent.
+	IsolateProto->Object::put(L"receive", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			vobject* __this = scope ? scope->get(L"__this", 1) : nullptr;
+			vobject* value;
+			
+			if (__this && __this->as_type<Isolate>())
+				value = static_cast<Isolate*>(__this)->receive(timeout_arg(args));
+			else {
+				isolate_channel* channel = Isolate::parent();
+				if (!channel)
+					throw IllegalStateError(L"interpreter is not running as Isolate");
+				
+				value = channel->receive(timeout_arg(args));
+			}
+			
+			return value ? value : Undefined::instance();
+		}));
+	// terminate(signal) sends signal to isolate, SIGTERM by default
+	IsolateProto->Object::put(L"terminate", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Isolate>())
+				return Undefined::instance();
+			
+			int signal = SIGTERM;
+			if (args.size() && args[0] && !args[0]->as_type<Undefined>())
+				signal = args[0]->int_value();
+			
+			static_cast<Isolate*>(__this)->terminate(signal);
+			return Undefined::instance();
+		}));
+	// join() waits for isolate exit and returns it's exit code
+	IsolateProto->Object::put(L"join", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Isolate>())
+				return Undefined::instance();
+			
+			return new Int(static_cast<Isolate*>(__this)->join());
+		}));
+	IsolateProto->Object::put(L"getPid", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Isolate>())
+				return Undefined::instance();
+			
+			return new Int(static_cast<Isolate*>(__this)->get_pid());
+		}));
+	
+	// Static functions
+	
+	// Returns true if current interpreter was started as Isolate
+	IsolateProto->Object::put(L"isIsolate", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			return Bool::instance(Isolate::parent() != nullptr);
+		}));
+	
+	return IsolateProto;
+};
+
+
+Isolate::Isolate(const std::string& path, const std::vector<std::string>& args) {
+	reap_orphans();
+	
+	char executable[4096];
+	ssize_t length = readlink("/proc/self/exe", executable, sizeof(executable) - 1);
+	if (length == -1)
+		throw IOError(L"failed to locate interpreter executable");
+	executable[length] = '\0';
+	
+	int fds[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == -1)
+		throw IOError(L"failed to create Isolate channel");
+	
+	// dup2 onto the same descriptor keeps close-on-exec flag
+	if (fds[1] == ISOLATE_FD) {
+		int moved = fcntl(fds[1], F_DUPFD_CLOEXEC, ISOLATE_FD + 1);
+		::close(fds[1]);
+		fds[1] = moved;
+	}
+	
+	std::vector<std::string> argv_strings = { executable, path };
+	argv_strings.insert(argv_strings.end(), args.begin(), args.end());
+	
+	std::vector<char*> argv;
+	for (std::string& s : argv_strings)
+		argv.push_back(&s[0]);
+	argv.push_back(nullptr);
+	
+	// Inherit environment with channel descriptor replaced
+	std::string channel_env = std::string(ISOLATE_ENV) + "=" + std::to_string(ISOLATE_FD);
+	size_t prefix = strlen(ISOLATE_ENV) + 1;
+	
+	std::vector<char*> envp;
+	for (char** env = environ; env && *env; ++env)
+		if (strncmp(*env, channel_env.c_str(), prefix))
+			envp.push_back(*env);
+	envp.push_back(&channel_env[0]);
+	envp.push_back(nullptr);
+	
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, fds[1], ISOLATE_FD);
+	
+	int error = posix_spawn(&pid, executable, &actions, nullptr, argv.data(), envp.data());
+	
+	posix_spawn_file_actions_destroy(&actions);
+	::close(fds[1]);
+	
+	if (error) {
+		::close(fds[0]);
+		throw IOError(L"failed to start Isolate: " + std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>>().from_bytes(strerror(error)));
+	}
+	
+	channel.fd = fds[0];
+};
+
+Isolate::~Isolate() {};
+
+
+vobject* Isolate::get(vscope* scope, const wstring& name) {
+	vobject* ret = Object::get(name);
+	
+	if (!ret && IsolateProto)
+		return IsolateProto->get(scope, name);
+	return ret;
+};
+
+void Isolate::put(vscope* scope, const wstring& name, vobject* object) {
+	Object::put(name, object);
+};
+
+bool Isolate::contains(vscope* scope, const wstring& name) {
+	return Object::contains(name) || (IsolateProto && IsolateProto->contains(scope, name));
+};
+
+bool Isolate::remove(vscope* scope, const wstring& name) {
+	if (Object::remove(name))
+		return 1;
+	return 0;
+};
+
+vobject* Isolate::call(vscope* scope, const vector<vobject*>& args) {
+	throw UnsupportedOperation(L"Isolate is not callable");
+};
+
+
+void Isolate::gc_trace(gc_visitor& visitor) {
+	Object::gc_trace(visitor);
+};
+
+void Isolate::gc_finalize() {
+	// Unreachable isolate keeps running, closed channel is seen as end of input
+	channel.close();
+	
+	if (!joined && waitpid(pid, &status, WNOHANG) == 0) {
+		std::unique_lock<std::mutex> lk(orphans_mutex);
+		orphans.push_back(pid);
+	}
+	
+	reap_orphans();
+};
+
+// Isolate functions only
+
+void Isolate::terminate(int signal) {
+	std::unique_lock<std::mutex> lk(join_mutex);
+	
+	if (!joined)
+		kill(pid, signal);
+};
+
+int Isolate::join() {
+	GIL::instance()->io_block();
+	
+	{
+		std::unique_lock<std::mutex> lk(join_mutex);
+		
+		// Wake up periodically to notice termination
+		while (!joined && GIL::current_thread()->is_running()) {
+			pid_t result = waitpid(pid, &status, WNOHANG);
+			
+			if (result == pid || (result == -1 && errno != EINTR)) {
+				joined = 1;
+				break;
+			}
+			
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		
+		if (joined)
+			channel.close();
+	}
+	
+	reap_orphans();
+	
+	GIL::instance()->io_unblock();
+	
+	if (!joined)
+		return -1;
+	
+	if (WIFEXITED(status))
+		return WEXITSTATUS(status);
+	if (WIFSIGNALED(status))
+		return -WTERMSIG(status);
+	return status;
+};
+
+isolate_channel* Isolate::parent() {
+	static std::once_flag flag;
+	static isolate_channel* channel = nullptr;
+	
+	std::call_once(flag, []() {
+		const char* env = getenv(ISOLATE_ENV);
+		if (!env)
+			return;
+		
+		int fd = atoi(env);
+		if (fd < 0 || fcntl(fd, F_GETFD) == -1)
+			return;
+		
+		// Processes started by isolate do not inherit the channel
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+		
+		channel = new isolate_channel();
+		channel->fd = fd;
+	});
+	
+	return channel;
+};
+
+// Must return integer representation of an object
+int64_t Isolate::int_value() {
+	return pid;
+};
+
+// Must return string representation of an object
+std::wstring Isolate::string_value() {
+	return std::wstring(L"[Isolate ") + std::to_wstring(pid) + std::wstring(L"]");
+};
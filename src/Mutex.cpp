@@ -0,0 +1,213 @@
+#include "objects/Mutex.h"
+
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "exceptions.h"
+#include "GIL2.h"
+
+#include "objects/Object.h"
+#include "objects/Bool.h"
+#include "objects/NativeFunction.h"
+#include "objects/Undefined.h"
+#include "objects/String.h"
+
+using namespace std;
+using namespace ck_exceptions;
+using namespace ck_vobject;
+using namespace ck_objects;
+using namespace ck_core;
+
+
+// Monitor of an object used by synchronized statement.
+// Exists while any thread holds or waits for it.
+struct object_monitor {
+	monitor mon;
+	int     users = 0;
+};
+
+static std::mutex table_mutex;
+static std::map<vobject*, object_monitor*> monitor_table;
+
+
+// Returns timeout argument or -1 if it is missing
+static int64_t timeout_arg(const vector<vobject*>& args) {
+	if (!args.size() || !args[0] || args[0]->as_type<Undefined>())
+		return -1;
+	return args[0]->int_value();
+};
+
+static vobject* call_handler(vscope* scope, const vector<vobject*>& args) {
+	return new Mutex();
+};
+
+vobject* Mutex::create_proto() {
+	if (MutexProto != nullptr)
+		return MutexProto;
+	
+	MutexProto = new CallableObject(call_handler);
+	GIL::gc_instance()->attach_root(MutexProto);
+	
+	MutexProto->Object::put(L"__typename", new String(L"Mutex"));
+	
+	// lock(timeout) -> true if mutex was acquired before timeout
+	MutexProto->Object::put(L"lock", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Mutex>())
+				return Undefined::instance();
+			
+			return Bool::instance(static_cast<Mutex*>(__this)->mon.lock(timeout_arg(args)));
+		}));
+	MutexProto->Object::put(L"tryLock", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Mutex>())
+				return Undefined::instance();
+			
+			return Bool::instance(static_cast<Mutex*>(__this)->mon.lock(0));
+		}));
+	MutexProto->Object::put(L"unlock", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Mutex>())
+				return Undefined::instance();
+			
+			if (!static_cast<Mutex*>(__this)->mon.unlock())
+				throw IllegalStateError(L"Mutex is not owned by current thread");
+			
+			return Undefined::instance();
+		}));
+	MutexProto->Object::put(L"isLocked", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Mutex>())
+				return Undefined::instance();
+			
+			return Bool::instance(static_cast<Mutex*>(__this)->mon.is_locked());
+		}));
+	MutexProto->Object::put(L"isOwned", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Mutex>())
+				return Undefined::instance();
+			
+			return Bool::instance(static_cast<Mutex*>(__this)->mon.is_owned());
+		}));
+	
+	return MutexProto;
+};
+
+
+Mutex::Mutex() {};
+
+Mutex::~Mutex() {};
+
+
+vobject* Mutex::get(vscope* scope, const wstring& name) {
+	vobject* ret = Object::get(name);
+	
+	if (!ret && MutexProto)
+		return MutexProto->get(scope, name);
+	return ret;
+};
+
+void Mutex::put(vscope* scope, const wstring& name, vobject* object) {
+	Object::put(name, object);
+};
+
+bool Mutex::contains(vscope* scope, const wstring& name) {
+	return Object::contains(name) || (MutexProto && MutexProto->contains(scope, name));
+};
+
+bool Mutex::remove(vscope* scope, const wstring& name) {
+	if (Object::remove(name))
+		return 1;
+	return 0;
+};
+
+vobject* Mutex::call(vscope* scope, const vector<vobject*>& args) {
+	throw UnsupportedOperation(L"Mutex is not callable");
+};
+
+
+void Mutex::gc_trace(gc_visitor& visitor) {
+	Object::gc_trace(visitor);
+};
+
+void Mutex::gc_finalize() {};
+
+// Mutex functions only
+
+void Mutex::enter(vobject* object) {
+	if (object->as_type<Mutex>()) {
+		if (!static_cast<Mutex*>(object)->mon.lock())
+			throw IllegalStateError(L"thread stopped while waiting for monitor");
+		return;
+	}
+	
+	object_monitor* entry;
+	{
+		std::unique_lock<std::mutex> lk(table_mutex);
+		
+		object_monitor*& slot = monitor_table[object];
+		if (!slot)
+			slot = new object_monitor();
+		
+		entry = slot;
+		++entry->users;
+	}
+	
+	if (entry->mon.lock())
+		return;
+	
+	std::unique_lock<std::mutex> lk(table_mutex);
+	if (--entry->users == 0) {
+		monitor_table.erase(object);
+		delete entry;
+	}
+	
+	throw IllegalStateError(L"thread stopped while waiting for monitor");
+};
+
+void Mutex::exit(vobject* object) {
+	if (object->as_type<Mutex>()) {
+		static_cast<Mutex*>(object)->mon.unlock();
+		return;
+	}
+	
+	std::unique_lock<std::mutex> lk(table_mutex);
+	
+	auto it = monitor_table.find(object);
+	if (it == monitor_table.end())
+		return;
+	
+	object_monitor* entry = it->second;
+	entry->mon.unlock();
+	
+	if (--entry->users == 0) {
+		monitor_table.erase(it);
+		delete entry;
+	}
+};
+
+// Must return integer representation of an object
+int64_t Mutex::int_value() {
+	return (intptr_t) this;
+};
+
+// Must return string representation of an object
+std::wstring Mutex::string_value() {
+	return std::wstring(L"[Mutex ") + std::to_wstring((intptr_t) this) + std::wstring(L"]");
+};
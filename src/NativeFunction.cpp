@@ -62,8 +62,8 @@ vobject* NativeFunction::call(ck_vobject::vscope* scope, const std::vector<vobje
 	throw UnsupportedOperation(L"BytecodeFunction is not directly callable");
 };
 
-void NativeFunction::gc_mark() {
-	Function::gc_mark();
+void NativeFunction::gc_trace(gc_visitor& visitor) {
+	Function::gc_trace(visitor);
 };
 
 
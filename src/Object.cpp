@@ -91,6 +91,40 @@ vobject* Object::create_proto() {
 			
 			return new Array(keys);
 		}));
+	ObjectProto->put(L"freeze", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Object>())
+				return Undefined::instance();
+			
+			static_cast<Object*>(__this)->freeze();
+			
+			return __this;
+		}));
+	ObjectProto->put(L"unfreeze", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Object>())
+				return Undefined::instance();
+			
+			static_cast<Object*>(__this)->unfreeze();
+			
+			return __this;
+		}));
+	ObjectProto->put(L"isFrozen", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Object>())
+				return Undefined::instance();
+			
+			return Bool::instance(static_cast<Object*>(__this)->is_frozen());
+		}));
 	ObjectProto->Object::put(L"string", new NativeFunction(
 		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
 			// Validate __this
@@ -163,7 +197,7 @@ vobject* Object::create_proto() {
 };
 
 
-Object::Object(const std::map<std::wstring, ck_vobject::vobject*>& objec) : vsobject() {
+Object::Object(const std::map<std::wstring, ck_vobject::vobject*>& objec) {
 	objects = objec;
 };
 
@@ -200,15 +234,9 @@ vobject* Object::call(vscope* scope, const vector<vobject*>& args) {
 };
 
 
-void Object::gc_mark() {
-	if (gc_reachable)
-		return;
-	
-	gc_reach();
-	
+void Object::gc_trace(gc_visitor& visitor) {
 	for (const auto& any : objects) 
-		if (any.second && !any.second->gc_reachable)
-			any.second->gc_mark();
+		visitor.visit(any.second);
 };
 
 void Object::gc_finalize() {};
@@ -219,6 +247,8 @@ void Object::append(Object* obj) {
 	if (!obj)
 		return;
 	
+	check_mutable();
+	
 	objects.insert(obj->objects.begin(), obj->objects.end());
 };
 
@@ -236,34 +266,38 @@ void Object::put(const wstring& name, vobject* object) {
 	
 	vsobject::vslock lk(this);
 	
+	check_mutable();
+	
 	objects[name] = object;
 };
 
 vobject* Object::get(const wstring& name) {
 	
+	// Frozen object never changes
+	if (is_frozen())
+		return lookup(name);
+	
 	vsobject::vslock lk(this);
 	
-	//wcout << this->string_value() << " getting " << name << endl;
-	map<wstring, vobject*>::const_iterator pos = objects.find(name);
-	if (pos == objects.end())
-		return nullptr;
-	return pos->second;
+	return lookup(name);
 };
 
 bool Object::contains(const wstring& name) {
 	
+	if (is_frozen())
+		return objects.count(name);
+	
 	vsobject::vslock lk(this);
 	
-	map<wstring, vobject*>::const_iterator pos = objects.find(name);
-	if (pos == objects.end())
-		return 0;
-	return 1;
+	return objects.count(name);
 };
 
 bool Object::remove(const wstring& name) {
 	
 	vsobject::vslock lk(this);
 	
+	check_mutable();
+	
 	map<wstring, vobject*>::const_iterator pos = objects.find(name);
 	if (pos == objects.end())
 		return 0;
@@ -271,6 +305,26 @@ bool Object::remove(const wstring& name) {
 	return 1;
 };
 
+void Object::check_mutable() {
+	if (frozen.load(std::memory_order_relaxed))
+		throw UnsupportedOperation(L"Object is frozen");
+};
+
+void Object::freeze() {
+	
+	// Wait for pending writers
+	vsobject::vslock lk(this);
+	
+	frozen.store(1, std::memory_order_release);
+};
+
+void Object::unfreeze() {
+	if (is_multithreaded())
+		throw IllegalStateError(L"Object can not be unfrozen after threads were started");
+	
+	frozen.store(0, std::memory_order_relaxed);
+};
+
 // Must return integer representation of an object
 int64_t Object::int_value() { 
 	return (intptr_t) this; 
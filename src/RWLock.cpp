@@ -0,0 +1,261 @@
+#include "objects/RWLock.h"
+
+#include <string>
+
+#include "exceptions.h"
+#include "GIL2.h"
+#include "monitor.h"
+
+#include "objects/Object.h"
+#include "objects/Bool.h"
+#include "objects/NativeFunction.h"
+#include "objects/Undefined.h"
+#include "objects/String.h"
+
+using namespace std;
+using namespace ck_exceptions;
+using namespace ck_vobject;
+using namespace ck_objects;
+using namespace ck_core;
+
+
+// Returns timeout argument or -1 if it is missing
+static int64_t timeout_arg(const vector<vobject*>& args) {
+	if (!args.size() || !args[0] || args[0]->as_type<Undefined>())
+		return -1;
+	return args[0]->int_value();
+};
+
+static vobject* call_handler(vscope* scope, const vector<vobject*>& args) {
+	return new RWLock();
+};
+
+vobject* RWLock::create_proto() {
+	if (RWLockProto != nullptr)
+		return RWLockProto;
+	
+	RWLockProto = new CallableObject(call_handler);
+	GIL::gc_instance()->attach_root(RWLockProto);
+	
+	RWLockProto->Object::put(L"__typename", new String(L"RWLock"));
+	
+	// readLock(timeout) -> true if lock was acquired before timeout
+	RWLockProto->Object::put(L"readLock", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<RWLock>())
+				return Undefined::instance();
+			
+			return Bool::instance(static_cast<RWLock*>(__this)->read_lock(timeout_arg(args)));
+		}));
+	RWLockProto->Object::put(L"tryReadLock", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<RWLock>())
+				return Undefined::instance();
+			
+			return Bool::instance(static_cast<RWLock*>(__this)->read_lock(0));
+		}));
+	RWLockProto->Object::put(L"readUnlock", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<RWLock>())
+				return Undefined::instance();
+			
+			if (!static_cast<RWLock*>(__this)->read_unlock())
+				throw IllegalStateError(L"RWLock is not locked for reading");
+			
+			return Undefined::instance();
+		}));
+	// writeLock(timeout) -> true if lock was acquired before timeout
+	RWLockProto->Object::put(L"writeLock", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<RWLock>())
+				return Undefined::instance();
+			
+			return Bool::instance(static_cast<RWLock*>(__this)->write_lock(timeout_arg(args)));
+		}));
+	RWLockProto->Object::put(L"tryWriteLock", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<RWLock>())
+				return Undefined::instance();
+			
+			return Bool::instance(static_cast<RWLock*>(__this)->write_lock(0));
+		}));
+	RWLockProto->Object::put(L"writeUnlock", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<RWLock>())
+				return Undefined::instance();
+			
+			if (!static_cast<RWLock*>(__this)->write_unlock())
+				throw IllegalStateError(L"RWLock is not locked for writing by current thread");
+			
+			return Undefined::instance();
+		}));
+	
+	return RWLockProto;
+};
+
+
+RWLock::RWLock() {};
+
+RWLock::~RWLock() {};
+
+
+vobject* RWLock::get(vscope* scope, const wstring& name) {
+	vobject* ret = Object::get(name);
+	
+	if (!ret && RWLockProto)
+		return RWLockProto->get(scope, name);
+	return ret;
+};
+
+void RWLock::put(vscope* scope, const wstring& name, vobject* object) {
+	Object::put(name, object);
+};
+
+bool RWLock::contains(vscope* scope, const wstring& name) {
+	return Object::contains(name) || (RWLockProto && RWLockProto->contains(scope, name));
+};
+
+bool RWLock::remove(vscope* scope, const wstring& name) {
+	if (Object::remove(name))
+		return 1;
+	return 0;
+};
+
+vobject* RWLock::call(vscope* scope, const vector<vobject*>& args) {
+	throw UnsupportedOperation(L"RWLock is not callable");
+};
+
+
+void RWLock::gc_trace(gc_visitor& visitor) {
+	Object::gc_trace(visitor);
+};
+
+void RWLock::gc_finalize() {};
+
+// RWLock functions only
+
+bool RWLock::read_lock(int64_t timeout) {
+	gil_thread* self = GIL::current_thread();
+	
+	std::unique_lock<std::mutex> lk(mutex);
+	
+	if (writer == self || (!writer && !waiting_writers)) {
+		++readers;
+		return 1;
+	}
+	
+	if (!timeout)
+		return 0;
+	
+	// Allow other threads to perform stop-the-world while waiting
+	GIL::instance()->io_block();
+	
+	bool acquired = wait_blocked(lk, var, timeout, [this]() -> bool {
+		return !writer && !waiting_writers;
+	});
+	
+	if (acquired)
+		++readers;
+	
+	lk.unlock();
+	GIL::instance()->io_unblock();
+	
+	return acquired;
+};
+
+bool RWLock::write_lock(int64_t timeout) {
+	gil_thread* self = GIL::current_thread();
+	
+	std::unique_lock<std::mutex> lk(mutex);
+	
+	if (writer == self) {
+		++writes;
+		return 1;
+	}
+	
+	if (!writer && !readers) {
+		writer = self;
+		writes = 1;
+		return 1;
+	}
+	
+	if (!timeout)
+		return 0;
+	
+	++waiting_writers;
+	
+	// Allow other threads to perform stop-the-world while waiting
+	GIL::instance()->io_block();
+	
+	bool acquired = wait_blocked(lk, var, timeout, [this]() -> bool {
+		return !writer && !readers;
+	});
+	
+	--waiting_writers;
+	
+	if (acquired) {
+		writer = self;
+		writes = 1;
+	} else
+		// Readers waiting behind this writer may proceed
+		var.notify_all();
+	
+	lk.unlock();
+	GIL::instance()->io_unblock();
+	
+	return acquired;
+};
+
+bool RWLock::read_unlock() {
+	std::unique_lock<std::mutex> lk(mutex);
+	
+	if (!readers)
+		return 0;
+	
+	if (--readers == 0)
+		var.notify_all();
+	
+	return 1;
+};
+
+bool RWLock::write_unlock() {
+	std::unique_lock<std::mutex> lk(mutex);
+	
+	if (writer != GIL::current_thread())
+		return 0;
+	
+	if (--writes == 0) {
+		writer = nullptr;
+		var.notify_all();
+	}
+	
+	return 1;
+};
+
+// Must return integer representation of an object
+int64_t RWLock::int_value() {
+	return (intptr_t) this;
+};
+
+// Must return string representation of an object
+std::wstring RWLock::string_value() {
+	return std::wstring(L"[RWLock ") + std::to_wstring((intptr_t) this) + std::wstring(L"]");
+};
@@ -0,0 +1,514 @@
+#include "objects/SharedArray.h"
+
+#include <string>
+#include <cstring>
+#include <mutex>
+#include <condition_variable>
+
+#include "exceptions.h"
+#include "GIL2.h"
+#include "monitor.h"
+
+#include "objects/Object.h"
+#include "objects/Int.h"
+#include "objects/Double.h"
+#include "objects/Array.h"
+#include "objects/NativeFunction.h"
+#include "objects/Undefined.h"
+#include "objects/String.h"
+
+using namespace std;
+using namespace ck_exceptions;
+using namespace ck_vobject;
+using namespace ck_objects;
+using namespace ck_core;
+
+
+// Thread parked in Atomics.wait() on single element
+struct element_waiter {
+	std::atomic<int64_t>*   address;
+	bool                    notified = 0;
+	std::condition_variable var;
+};
+
+// Waiters are spread over buckets by element address
+struct waiter_bucket {
+	std::mutex                   mutex;
+	std::vector<element_waiter*> waiters;
+};
+
+static const int WAITER_BUCKETS = 64;
+static waiter_bucket waiter_buckets[WAITER_BUCKETS];
+
+static waiter_bucket& bucket_of(std::atomic<int64_t>* address) {
+	return waiter_buckets[((uintptr_t) address >> 3) % WAITER_BUCKETS];
+};
+
+static inline int64_t double_bits(double value) {
+	int64_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	return bits;
+};
+
+static inline double bits_double(int64_t bits) {
+	double value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+};
+
+// Returns 1 and index if name is valid integer
+static bool parse_index(const wstring& name, int64_t& index) {
+	if (!name.size())
+		return 0;
+	
+	int chk_ind = 0;
+	if (name[chk_ind] == U'-' || name[chk_ind] == U'+')
+		++chk_ind;
+	if (chk_ind == name.size())
+		return 0;
+	for (; chk_ind < name.size(); ++chk_ind)
+		if (name[chk_ind] < U'0' || U'9' < name[chk_ind])
+			return 0;
+	
+	try {
+		index = std::stoll(name);
+	} catch (...) {
+		throw RangeError(L"SharedArray index out of range");
+	}
+	
+	return 1;
+};
+
+static SharedArray* make_array(const vector<vobject*>& args, bool floating) {
+	const wchar_t* type = floating ? L"SharedFloat64Array" : L"SharedInt64Array";
+	
+	if (!args.size() || !args[0])
+		throw IllegalArgumentError(std::wstring(type) + L" expected length or Array");
+	
+	// Copy of Array
+	if (args[0]->as_type<Array>()) {
+		Array* source = static_cast<Array*>(args[0]);
+		
+		vector<vobject*> items;
+		{
+			vsobject::vslock lk(source);
+			items = source->items();
+		}
+		
+		SharedArray* array = new SharedArray(items.size(), floating);
+		for (int64_t i = 0; i < items.size(); ++i)
+			array->at(i).store(array->to_bits(items[i]), std::memory_order_relaxed);
+		
+		return array;
+	}
+	
+	if (!args[0]->as_type<Int>())
+		throw IllegalArgumentError(std::wstring(type) + L" expected length or Array");
+	
+	int64_t length = args[0]->int_value();
+	if (length < 0 || length > (1LL << 28))
+		throw IllegalArgumentError(std::wstring(type) + L" expected length in range [0, 268435456]");
+	
+	return new SharedArray(length, floating);
+};
+
+static vobject* int64_call_handler(vscope* scope, const vector<vobject*>& args) {
+	return make_array(args, 0);
+};
+
+static vobject* float64_call_handler(vscope* scope, const vector<vobject*>& args) {
+	return make_array(args, 1);
+};
+
+// Defines functions shared by both prototypes
+static void define_methods(CallableObject* proto) {
+	proto->Object::put(L"size", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<SharedArray>())
+				return Undefined::instance();
+			
+			return new Int(static_cast<SharedArray*>(__this)->size());
+		}));
+	proto->Object::put(L"fill", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<SharedArray>())
+				return Undefined::instance();
+			
+			SharedArray* array = static_cast<SharedArray*>(__this);
+			
+			int64_t bits = array->to_bits(args.size() ? args[0] : nullptr);
+			for (int64_t i = 0; i < array->size(); ++i)
+				array->at(i).store(bits);
+			
+			return __this;
+		}));
+	proto->Object::put(L"toArray", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<SharedArray>())
+				return Undefined::instance();
+			
+			SharedArray* array = static_cast<SharedArray*>(__this);
+			
+			Array* result = new Array();
+			result->items().reserve(array->size());
+			for (int64_t i = 0; i < array->size(); ++i)
+				result->items().push_back(array->from_bits(array->at(i).load(std::memory_order_relaxed)));
+			
+			return result;
+		}));
+};
+
+vobject* SharedArray::create_int64_proto() {
+	if (SharedInt64ArrayProto != nullptr)
+		return SharedInt64ArrayProto;
+	
+	SharedInt64ArrayProto = new CallableObject(int64_call_handler);
+	GIL::gc_instance()->attach_root(SharedInt64ArrayProto);
+	
+	SharedInt64ArrayProto->Object::put(L"__typename", new String(L"SharedInt64Array"));
+	define_methods(SharedInt64ArrayProto);
+	
+	return SharedInt64ArrayProto;
+};
+
+vobject* SharedArray::create_float64_proto() {
+	if (SharedFloat64ArrayProto != nullptr)
+		return SharedFloat64ArrayProto;
+	
+	SharedFloat64ArrayProto = new CallableObject(float64_call_handler);
+	GIL::gc_instance()->attach_root(SharedFloat64ArrayProto);
+	
+	SharedFloat64ArrayProto->Object::put(L"__typename", new String(L"SharedFloat64Array"));
+	define_methods(SharedFloat64ArrayProto);
+	
+	return SharedFloat64ArrayProto;
+};
+
+
+// A T O M I C S
+
+// Validates array argument of Atomics function
+static SharedArray* array_arg(const vector<vobject*>& args, int argc, const wchar_t* function, bool int_only = 0) {
+	if (args.size() < argc || !args[0] || !args[0]->as_type<SharedArray>())
+		throw TypeError(std::wstring(L"Atomics.") + function + L" expected shared array and " + std::to_wstring(argc - 1) + L" arguments");
+	
+	SharedArray* array = static_cast<SharedArray*>(args[0]);
+	if (int_only && array->is_floating())
+		throw TypeError(std::wstring(L"Atomics.") + function + L" expected SharedInt64Array");
+	
+	return array;
+};
+
+static std::atomic<int64_t>& element_arg(SharedArray* array, const vector<vobject*>& args) {
+	if (!args[1] || !args[1]->as_type<Int>())
+		throw TypeError(L"SharedArray index expected Int");
+	
+	return array->at(args[1]->int_value());
+};
+
+// Applies operation to element with CAS loop, returns previous value
+template<typename Operation>
+static vobject* update(SharedArray* array, std::atomic<int64_t>& element, Operation operation) {
+	int64_t bits = element.load();
+	while (!element.compare_exchange_weak(bits, operation(bits)));
+	
+	return array->from_bits(bits);
+};
+
+static vobject* f_atomics_load(vscope* scope, const vector<vobject*>& args) {
+	SharedArray* array = array_arg(args, 2, L"load");
+	return array->from_bits(element_arg(array, args).load());
+};
+
+// Returns stored value
+static vobject* f_atomics_store(vscope* scope, const vector<vobject*>& args) {
+	SharedArray* array = array_arg(args, 3, L"store");
+	int64_t bits = array->to_bits(args[2]);
+	
+	element_arg(array, args).store(bits);
+	return array->from_bits(bits);
+};
+
+// Following functions return previous value
+
+static vobject* f_atomics_add(vscope* scope, const vector<vobject*>& args) {
+	SharedArray* array = array_arg(args, 3, L"add");
+	std::atomic<int64_t>& element = element_arg(array, args);
+	int64_t bits = array->to_bits(args[2]);
+	
+	if (!array->is_floating())
+		return new Int(element.fetch_add(bits));
+	
+	double delta = bits_double(bits);
+	return update(array, element, [delta](int64_t old) -> int64_t { return double_bits(bits_double(old) + delta); });
+};
+
+static vobject* f_atomics_sub(vscope* scope, const vector<vobject*>& args) {
+	SharedArray* array = array_arg(args, 3, L"sub");
+	std::atomic<int64_t>& element = element_arg(array, args);
+	int64_t bits = array->to_bits(args[2]);
+	
+	if (!array->is_floating())
+		return new Int(element.fetch_sub(bits));
+	
+	double delta = bits_double(bits);
+	return update(array, element, [delta](int64_t old) -> int64_t { return double_bits(bits_double(old) - delta); });
+};
+
+static vobject* f_atomics_and(vscope* scope, const vector<vobject*>& args) {
+	SharedArray* array = array_arg(args, 3, L"and", 1);
+	return new Int(element_arg(array, args).fetch_and(array->to_bits(args[2])));
+};
+
+static vobject* f_atomics_or(vscope* scope, const vector<vobject*>& args) {
+	SharedArray* array = array_arg(args, 3, L"or", 1);
+	return new Int(element_arg(array, args).fetch_or(array->to_bits(args[2])));
+};
+
+static vobject* f_atomics_xor(vscope* scope, const vector<vobject*>& args) {
+	SharedArray* array = array_arg(args, 3, L"xor", 1);
+	return new Int(element_arg(array, args).fetch_xor(array->to_bits(args[2])));
+};
+
+static vobject* f_atomics_exchange(vscope* scope, const vector<vobject*>& args) {
+	SharedArray* array = array_arg(args, 3, L"exchange");
+	return array->from_bits(element_arg(array, args).exchange(array->to_bits(args[2])));
+};
+
+// compareExchange(array, index, expected, value), value is stored if element equals expected
+static vobject* f_atomics_compareExchange(vscope* scope, const vector<vobject*>& args) {
+	SharedArray* array = array_arg(args, 4, L"compareExchange");
+	std::atomic<int64_t>& element = element_arg(array, args);
+	int64_t expected = array->to_bits(args[2]);
+	int64_t value    = array->to_bits(args[3]);
+	
+	if (!array->is_floating()) {
+		element.compare_exchange_strong(expected, value);
+		return new Int(expected);
+	}
+	
+	// Doubles are compared by value, so 0.0 matches -0.0
+	int64_t bits = element.load();
+	while (bits_double(bits) == bits_double(expected) && !element.compare_exchange_weak(bits, value));
+	
+	return array->from_bits(bits);
+};
+
+// wait(array, index, expected, timeout) -> 'ok', 'not-equal' or 'timed-out'
+static vobject* f_atomics_wait(vscope* scope, const vector<vobject*>& args) {
+	SharedArray* array = array_arg(args, 3, L"wait", 1);
+	std::atomic<int64_t>& element = element_arg(array, args);
+	int64_t expected = array->to_bits(args[2]);
+	
+	int64_t timeout = -1;
+	if (args.size() > 3 && args[3] && !args[3]->as_type<Undefined>())
+		timeout = args[3]->int_value();
+	
+	waiter_bucket& bucket = bucket_of(&element);
+	std::unique_lock<std::mutex> lk(bucket.mutex);
+	
+	// notify() takes bucket lock after changing the value, so it can not be missed
+	if (element.load() != expected)
+		return new String(L"not-equal");
+	
+	if (!timeout)
+		return new String(L"timed-out");
+	
+	element_waiter waiter;
+	waiter.address = &element;
+	bucket.waiters.push_back(&waiter);
+	
+	// Allow other threads to perform stop-the-world while waiting
+	GIL::instance()->io_block();
+	
+	bool notified = wait_blocked(lk, waiter.var, timeout, [&waiter]() -> bool {
+		return waiter.notified;
+	});
+	
+	// Notified waiter is removed by notify()
+	if (!notified)
+		for (int i = 0; i < bucket.waiters.size(); ++i)
+			if (bucket.waiters[i] == &waiter) {
+				bucket.waiters.erase(bucket.waiters.begin() + i);
+				break;
+			}
+	
+	lk.unlock();
+	GIL::instance()->io_unblock();
+	
+	return new String(notified ? L"ok" : L"timed-out");
+};
+
+// notify(array, index, count) -> amount of woken threads, wakes all if count is omitted
+static vobject* f_atomics_notify(vscope* scope, const vector<vobject*>& args) {
+	SharedArray* array = array_arg(args, 2, L"notify", 1);
+	std::atomic<int64_t>& element = element_arg(array, args);
+	
+	int64_t count = -1;
+	if (args.size() > 2 && args[2] && !args[2]->as_type<Undefined>())
+		count = args[2]->int_value();
+	
+	waiter_bucket& bucket = bucket_of(&element);
+	std::unique_lock<std::mutex> lk(bucket.mutex);
+	
+	// Waiters are woken in order of arrival
+	int64_t woken = 0;
+	for (int i = 0; i < bucket.waiters.size() && (count < 0 || woken < count);)
+		if (bucket.waiters[i]->address == &element) {
+			bucket.waiters[i]->notified = 1;
+			bucket.waiters[i]->var.notify_one();
+			bucket.waiters.erase(bucket.waiters.begin() + i);
+			++woken;
+		} else
+			++i;
+	
+	return new Int(woken);
+};
+
+vobject* SharedArray::create_atomics() {
+	Object* atomics = new Object();
+	atomics->Object::put(L"load",            new NativeFunction(f_atomics_load));
+	atomics->Object::put(L"store",           new NativeFunction(f_atomics_store));
+	atomics->Object::put(L"add",             new NativeFunction(f_atomics_add));
+	atomics->Object::put(L"sub",             new NativeFunction(f_atomics_sub));
+	atomics->Object::put(L"and",             new NativeFunction(f_atomics_and));
+	atomics->Object::put(L"or",              new NativeFunction(f_atomics_or));
+	atomics->Object::put(L"xor",             new NativeFunction(f_atomics_xor));
+	atomics->Object::put(L"exchange",        new NativeFunction(f_atomics_exchange));
+	atomics->Object::put(L"compareExchange", new NativeFunction(f_atomics_compareExchange));
+	atomics->Object::put(L"wait",            new NativeFunction(f_atomics_wait));
+	atomics->Object::put(L"notify",          new NativeFunction(f_atomics_notify));
+	
+	// Called at high rate from many threads, frozen to avoid field locking
+	atomics->freeze();
+	
+	return atomics;
+};
+
+
+SharedArray::SharedArray(int64_t length, bool floating) : length(length), floating(floating) {
+	data = new std::atomic<int64_t>[length]();
+};
+
+SharedArray::~SharedArray() {
+	delete[] data;
+};
+
+
+vobject* SharedArray::get(vscope* scope, const wstring& name) {
+	CallableObject* proto = floating ? SharedFloat64ArrayProto : SharedInt64ArrayProto;
+	
+	if (name == L"__proto")
+		return proto;
+	
+	// Element read does not lock
+	int64_t index;
+	if (parse_index(name, index))
+		return from_bits(at(index).load());
+	
+	vobject* ret = Object::get(name);
+	if (!ret && proto)
+		return proto->get(scope, name);
+	return ret;
+};
+
+void SharedArray::put(vscope* scope, const wstring& name, vobject* object) {
+	if (name == L"__proto")
+		return;
+	
+	int64_t index;
+	if (parse_index(name, index)) {
+		at(index).store(to_bits(object));
+		return;
+	}
+	
+	Object::put(name, object);
+};
+
+bool SharedArray::contains(vscope* scope, const wstring& name) {
+	CallableObject* proto = floating ? SharedFloat64ArrayProto : SharedInt64ArrayProto;
+	
+	int64_t index;
+	if (parse_index(name, index))
+		return -length <= index && index < length;
+	
+	return Object::contains(name) || (proto && proto->contains(scope, name));
+};
+
+bool SharedArray::remove(vscope* scope, const wstring& name) {
+	if (Object::remove(name))
+		return 1;
+	return 0;
+};
+
+vobject* SharedArray::call(vscope* scope, const vector<vobject*>& args) {
+	throw UnsupportedOperation(L"SharedArray is not callable");
+};
+
+
+void SharedArray::gc_trace(gc_visitor& visitor) {
+	Object::gc_trace(visitor);
+};
+
+void SharedArray::gc_finalize() {};
+
+// SharedArray functions only
+
+std::atomic<int64_t>& SharedArray::at(int64_t index) {
+	if (index < 0)
+		index += length;
+	
+	if (index < 0 || index >= length)
+		throw RangeError(L"SharedArray index out of range");
+	
+	return data[index];
+};
+
+int64_t SharedArray::to_bits(vobject* value) {
+	if (!value || !(value->as_type<Int>() || value->as_type<Double>()))
+		throw TypeError(L"SharedArray element expected Int or Double");
+	
+	if (!floating)
+		return value->int_value();
+	
+	if (value->as_type<Double>())
+		return double_bits(static_cast<Double*>(value)->value());
+	
+	return double_bits((double) static_cast<Int*>(value)->value());
+};
+
+vobject* SharedArray::from_bits(int64_t bits) {
+	if (floating)
+		return new Double(bits_double(bits));
+	
+	return new Int(bits);
+};
+
+// Must return integer representation of an object
+int64_t SharedArray::int_value() {
+	return (intptr_t) this;
+};
+
+// Must return string representation of an object
+std::wstring SharedArray::string_value() {
+	std::wstring result = L"[";
+	
+	for (int64_t i = 0; i < length; ++i) {
+		if (i)
+			result += L", ";
+		
+		int64_t bits = data[i].load(std::memory_order_relaxed);
+		result += floating ? std::to_wstring(bits_double(bits)) : std::to_wstring(bits);
+	}
+	
+	return result + L"]";
+};
@@ -520,9 +520,7 @@ vobject* String::call(ck_vobject::vscope* scope, const std::vector<vobject*>& ar
 	throw UnsupportedOperation(L"String is not callable");
 };
 
-void String::gc_mark() {
-	gc_reachable = 1;
-};
+void String::gc_trace(gc_visitor& visitor) {};
 
 void String::gc_finalize() {};
 
@@ -7,6 +7,7 @@
 #include "executer.h"
 #include "stack_locator.h"
 #include "ck_args.h"
+#include "event_loop.h"
 
 #include "objects/Object.h"
 #include "objects/Int.h"
@@ -36,19 +37,27 @@ static vobject* call_handler(vscope* scope, const vector<vobject*>& args) {
 	
 	vobject* StackSize = ThreadProto->Object::get(L"StackSize");
 	
-	Thread* t = new Thread(GIL::instance()->spawn_thread(StackSize ? StackSize->int_value() : 8 * 1024 * 1024, [scope, argv, backtrace]() -> void {
+	// Completed when runnable returns
+	Future* result = new Future();
+	
+	Thread* t = new Thread(GIL::instance()->spawn_thread(StackSize ? StackSize->int_value() : 8 * 1024 * 1024, [scope, argv, backtrace, result]() -> void {
+		
+		// Root scope, function and arguments to prevent delete
+		gc_handle_scope handles;
+		for (int i = 0; i < argv->size(); ++i)
+			handles.add((*argv)[i]);
+		handles.add(result);
 		
 		// Create new scope for this thread
 		vscope* nscope = new iscope(scope);
-		nscope->root();
+		handles.add(nscope);
 		
-		// Root function to prevent delete
 		vobject* runnable = (*argv)[0];
 		if (!runnable) {
+			result->resolve(Undefined::instance());
 			GIL::instance()->unlock();
 			return;
 		}
-		runnable->gc_make_root();
 		
 		// Unlock when entered this function call to be sure there 
 		//  was no priority race and arguments and score are still relevant
@@ -79,9 +88,18 @@ static vobject* call_handler(vscope* scope, const vector<vobject*>& args) {
 		while (1) {
 			try {
 				if (!cake_started) {
-					GIL::executer_instance()->call_object(runnable, nullptr, argso, L"<thread_runnable>", nscope);
+					vobject* value = GIL::executer_instance()->call_object(runnable, nullptr, argso, L"<thread_runnable>", nscope);
 					GIL::executer_instance()->restore_all();
 					GIL::current_thread()->clear_blocks();
+					
+					// Deliver asynchronous I/O started by thread before completing it
+					if (event_loop::exists()) {
+						handles.add(value);
+						event_loop::instance()->run();
+						GIL::executer_instance()->restore_all();
+					}
+					
+					result->resolve(value);
 				
 					// Finish execution loop on success
 					break;
@@ -90,6 +108,13 @@ static vobject* call_handler(vscope* scope, const vector<vobject*>& args) {
 					GIL::executer_instance()->restore_all();
 					cake_started = 0;
 					
+					// Write heap snapshot requested by allocator before OutOfMemory
+					if (GIL::gc_instance()->dump_pending())
+						GIL::gc_instance()->dump_pending_heap();
+					
+					// Joined threads receive the cake
+					result->reject(message.get_type_id() == cake_type::CK_OBJECT ? message.get_object() : new Cake(message));
+					
 					// On cake caught, call stack, windows stack and try stack are empty.
 					// Process cake by calling handler-function.
 					// __defcakehandler(exception)
@@ -142,12 +167,10 @@ static vobject* call_handler(vscope* scope, const vector<vobject*>& args) {
 				GIL::current_thread()->clear_blocks();
 			}
 		}
-		
-		nscope->unroot();
-		runnable->gc_make_unroot();
 	}));
 	
 	t->Object::put(L"runnable", args[0]);
+	t->bind_result(result);
 	
 	return t;
 };
@@ -282,6 +305,89 @@ vobject* Thread::create_proto() {
 			
 			return ret;
 		}));
+	// join(timeout) -> true if thread finished
+	// Waits for thread runnable to return, timeout in milliseconds, 
+	//  no timeout for infinite wait.
+	ThreadProto->Object::put(L"join", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Thread>())
+				return Undefined::instance();
+			
+			Thread* t = static_cast<Thread*>(__this);
+			
+			if (!t->get_result())
+				throw IllegalStateError(L"Thread can not be joined");
+			
+			if (t->get_id() == GIL::current_thread()->get_id())
+				throw IllegalStateError(L"Thread can not join itself");
+			
+			int64_t timeout = -1;
+			if (args.size() && args[0] && !args[0]->as_type<Undefined>())
+				timeout = args[0]->int_value();
+			
+			return Bool::instance(t->get_result()->wait(timeout));
+		}));
+	// Returns Future of runnable result
+	ThreadProto->Object::put(L"getFuture", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Thread>())
+				return Undefined::instance();
+			
+			Thread* t = static_cast<Thread*>(__this);
+			
+			if (!t->get_result())
+				return Undefined::instance();
+			return t->get_result();
+		}));
+	// post(callback, args...) -> true if callback was passed to running thread
+	ThreadProto->Object::put(L"post", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<Thread>())
+				return Undefined::instance();
+			
+			if (!args.size() || !args[0] || args[0]->as_type<Undefined>() || args[0]->as_type<Null>())
+				throw IllegalArgumentError(L"Thread.post expected callback");
+			
+			mail_item* item = new mail_item();
+			item->obj = args[0];
+			item->args.assign(args.begin() + 1, args.end());
+			
+			if (GIL::instance()->post_mail(static_cast<Thread*>(__this)->get_id(), item))
+				return Bool::True();
+			
+			delete item;
+			return Bool::False();
+		}));
+	// Static
+	// dispatch(timeout) waits for callbacks posted to current thread and runs them
+	ThreadProto->Object::put(L"dispatch", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			int64_t timeout = -1;
+			if (args.size() && args[0] && !args[0]->as_type<Undefined>())
+				timeout = args[0]->int_value();
+			
+			mailbox& mail = GIL::current_thread()->get_mailbox();
+			
+			if (mail.empty() && timeout != 0) {
+				// Allow other threads to perform stop-the-world while waiting
+				GIL::instance()->io_block();
+				mail.wait(timeout);
+				GIL::instance()->io_unblock();
+			}
+			
+			GIL::executer_instance()->run_late_calls();
+			
+			return Undefined::instance();
+		}));
 	ThreadProto->Object::put(L"getId", new NativeFunction(
 		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
 			// Validate __this
@@ -365,11 +471,10 @@ vobject* Thread::call(vscope* scope, const vector<vobject*>& args) {
 };
 
 
-void Thread::gc_mark() {
-	if (gc_reachable)
-		return;
+void Thread::gc_trace(gc_visitor& visitor) {
+	Object::gc_trace(visitor);
 	
-	Object::gc_mark();
+	visitor.visit(result);
 };
 
 void Thread::gc_finalize() {};
@@ -0,0 +1,441 @@
+#include "objects/ThreadPool.h"
+
+#include <string>
+#include <thread>
+
+#include "exceptions.h"
+#include "GIL2.h"
+#include "executer.h"
+#include "ck_args.h"
+
+#include "objects/Object.h"
+#include "objects/Int.h"
+#include "objects/Bool.h"
+#include "objects/Cake.h"
+#include "objects/NativeFunction.h"
+#include "objects/Undefined.h"
+#include "objects/Null.h"
+#include "objects/String.h"
+
+using namespace std;
+using namespace ck_exceptions;
+using namespace ck_vobject;
+using namespace ck_objects;
+using namespace ck_core;
+
+
+// Pool and deque index of the current worker thread
+static thread_local pool_state* current_pool   = nullptr;
+static thread_local int         current_worker = -1;
+
+// All pools with running workers, stopped on interpreter exit
+static std::mutex               pools_mutex;
+static std::vector<pool_state*> pools;
+
+
+static vobject* call_handler(vscope* scope, const vector<vobject*>& args) {
+	int size = std::thread::hardware_concurrency();
+	
+	if (args.size() && args[0] && !args[0]->as_type<Undefined>()) {
+		if (!args[0]->as_type<Int>() || args[0]->int_value() <= 0)
+			throw IllegalArgumentError(L"ThreadPool expected positive size");
+		
+		size = args[0]->int_value();
+	}
+	
+	if (size <= 0)
+		size = 1;
+	
+	return new ThreadPool(scope ? scope->get_root() : nullptr, size);
+};
+
+vobject* ThreadPool::create_proto() {
+	if (ThreadPoolProto != nullptr)
+		return ThreadPoolProto;
+	
+	ThreadPoolProto = new CallableObject(call_handler);
+	GIL::gc_instance()->attach_root(ThreadPoolProto);
+	
+	ThreadPoolProto->Object::put(L"__typename", new String(L"ThreadPool"));
+	
+	// submit(fn, args...) -> Future
+	ThreadPoolProto->Object::put(L"submit", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<ThreadPool>())
+				return Undefined::instance();
+			
+			if (!args.size() || !args[0] || args[0]->as_type<Undefined>() || args[0]->as_type<Null>())
+				throw IllegalArgumentError(L"ThreadPool.submit expected function");
+			
+			return static_cast<ThreadPool*>(__this)->submit(args[0], vector<vobject*>(args.begin() + 1, args.end()));
+		}));
+	ThreadPoolProto->Object::put(L"size", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<ThreadPool>())
+				return Undefined::instance();
+			
+			return new Int(static_cast<ThreadPool*>(__this)->size());
+		}));
+	ThreadPoolProto->Object::put(L"shutdown", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<ThreadPool>())
+				return Undefined::instance();
+			
+			static_cast<ThreadPool*>(__this)->shutdown();
+			return Undefined::instance();
+		}));
+	
+	return ThreadPoolProto;
+};
+
+
+ThreadPool::ThreadPool(vscope* scope, int size) : state(new pool_state()) {
+	state->scope = scope;
+	state->owner = this;
+	
+	{
+		std::unique_lock<std::mutex> lk(pools_mutex);
+		pools.push_back(state.get());
+	}
+	
+	for (int i = 0; i < size; ++i)
+		state->workers.push_back(new pool_worker());
+	
+	// Same stack size as for Thread
+	int64_t stack_size = 8 * 1024 * 1024;
+	if (ck_core::ck_args::has_option(L"THREAD_STACK_SIZE")) try { 
+		stack_size = std::stoll(ck_core::ck_args::get_option(L"THREAD_STACK_SIZE"));
+	} catch (...) {}
+	
+	// Workers reference only native part of the pool
+	std::shared_ptr<pool_state> worker_state = state;
+	
+	state->alive = size;
+	for (int i = 0; i < size; ++i)
+		GIL::instance()->spawn_thread(stack_size, [worker_state, i]() -> void {
+			worker_state->work(i);
+		});
+};
+
+ThreadPool::~ThreadPool() {};
+
+pool_state::~pool_state() {
+	for (int i = 0; i < workers.size(); ++i)
+		delete workers[i];
+};
+
+
+vobject* ThreadPool::get(vscope* scope, const wstring& name) {
+	vobject* ret = Object::get(name);
+	
+	if (!ret && ThreadPoolProto)
+		return ThreadPoolProto->get(scope, name);
+	return ret;
+};
+
+void ThreadPool::put(vscope* scope, const wstring& name, vobject* object) {
+	Object::put(name, object);
+};
+
+bool ThreadPool::contains(vscope* scope, const wstring& name) {
+	return Object::contains(name) || (ThreadPoolProto && ThreadPoolProto->contains(scope, name));
+};
+
+bool ThreadPool::remove(vscope* scope, const wstring& name) {
+	if (Object::remove(name))
+		return 1;
+	return 0;
+};
+
+vobject* ThreadPool::call(vscope* scope, const vector<vobject*>& args) {
+	throw UnsupportedOperation(L"ThreadPool is not callable");
+};
+
+
+void ThreadPool::gc_trace(gc_visitor& visitor) {
+	Object::gc_trace(visitor);
+	
+	visitor.visit(state->scope);
+	
+	// Queued tasks
+	for (int i = 0; i <= state->workers.size(); ++i) {
+		pool_worker* w = i < state->workers.size() ? state->workers[i] : &state->injected;
+		std::unique_lock<std::mutex> lk(w->mutex);
+		
+		for (const pool_task& task : w->tasks) {
+			visitor.visit(task.runnable);
+			visitor.visit(task.future);
+			for (int j = 0; j < task.args.size(); ++j)
+				visitor.visit(task.args[j]);
+		}
+	}
+};
+
+void ThreadPool::gc_finalize() {
+	// Pool is not busy, so workers are idle and exit on wake up
+	state->owner    = nullptr;
+	state->stopping = 1;
+	state->wake_all();
+};
+
+// ThreadPool functions only
+
+Future* ThreadPool::submit(vobject* runnable, const vector<vobject*>& args) {
+	if (state->stopping.load(std::memory_order_relaxed))
+		throw IllegalStateError(L"ThreadPool is shut down");
+	
+	pool_task task;
+	task.runnable = runnable;
+	task.args     = args;
+	task.future   = new Future();
+	
+	// Worker pushes to own deque, other threads use shared queue
+	pool_worker* w = current_pool == state.get() ? state->workers[current_worker] : &state->injected;
+	
+	state->acquire();
+	
+	{
+		std::unique_lock<std::mutex> lk(w->mutex);
+		w->tasks.push_back(task);
+	}
+	
+	state->pending++;
+	
+	{
+		std::unique_lock<std::mutex> lk(state->idle_mutex);
+	}
+	state->idle_var.notify_one();
+	
+	return task.future;
+};
+
+void pool_state::acquire() {
+	if (busy++ == 0)
+		GIL::gc_instance()->attach_root(owner);
+};
+
+void pool_state::release() {
+	if (--busy != 0)
+		return;
+	
+	// Waiting on mutex here would block stop-the-world, so task submitted 
+	//  concurrently is handled by rooting the pool again
+	GIL::gc_instance()->deattach_root(owner);
+	if (busy > 0)
+		GIL::gc_instance()->attach_root(owner);
+};
+
+bool pool_state::take(int index, pool_task& task) {
+	if (pending.load(std::memory_order_acquire) <= 0)
+		return 0;
+	
+	// Own tasks are taken from the back
+	{
+		pool_worker* w = workers[index];
+		std::unique_lock<std::mutex> lk(w->mutex);
+		
+		if (w->tasks.size()) {
+			task = w->tasks.back();
+			w->tasks.pop_back();
+			pending--;
+			return 1;
+		}
+	}
+	
+	// Tasks submitted from outside
+	{
+		std::unique_lock<std::mutex> lk(injected.mutex);
+		
+		if (injected.tasks.size()) {
+			task = injected.tasks.front();
+			injected.tasks.pop_front();
+			pending--;
+			return 1;
+		}
+	}
+	
+	// Steal oldest task of other workers
+	for (int i = 1; i < workers.size(); ++i) {
+		pool_worker* w = workers[(index + i) % workers.size()];
+		std::unique_lock<std::mutex> lk(w->mutex, std::try_to_lock);
+		
+		if (lk.owns_lock() && w->tasks.size()) {
+			task = w->tasks.front();
+			w->tasks.pop_front();
+			pending--;
+			return 1;
+		}
+	}
+	
+	return 0;
+};
+
+void pool_state::run(pool_task& task) {
+	
+	// Task is no longer referenced by queue
+	gc_handle_scope handles;
+	handles.add(task.runnable);
+	handles.add(task.future);
+	for (int i = 0; i < task.args.size(); ++i)
+		handles.add(task.args[i]);
+	
+	vobject* result;
+	cake     error;
+	
+	if (GIL::executer_instance()->try_call_object(result, error, task.runnable, nullptr, task.args, L"<pool_task>", new iscope(scope)))
+		task.future->resolve(result);
+	else
+		task.future->reject(error.get_type_id() == cake_type::CK_OBJECT ? error.get_object() : new Cake(error));
+	
+	release();
+};
+
+void pool_state::work(int index) {
+	current_pool   = this;
+	current_worker = index;
+	
+	// Workers do not keep interpreter alive
+	GIL::current_thread()->set_daemon(1);
+	
+	{
+		std::unique_lock<std::mutex> lk(pools_mutex);
+		workers[index]->thread = GIL::current_thread();
+	}
+	
+	GIL::instance()->unlock();
+	
+	while (1) {
+		if (terminating.load(std::memory_order_relaxed) || !GIL::current_thread()->is_running())
+			break;
+		
+		pool_task task;
+		if (take(index, task)) {
+			run(task);
+			continue;
+		}
+		
+		if (stopping.load(std::memory_order_relaxed))
+			break;
+		
+		// Sleep till new task is submitted.
+		// Thread is marked blocked to not delay stop-the-world.
+		GIL::instance()->io_block();
+		
+		{
+			std::unique_lock<std::mutex> lk(idle_mutex);
+			idle_var.wait(lk, [this]() -> bool {
+				return pending.load(std::memory_order_acquire) > 0 || stopping.load(std::memory_order_relaxed) || terminating.load(std::memory_order_relaxed) || !GIL::current_thread()->is_running();
+			});
+		}
+		
+		GIL::instance()->io_unblock();
+	}
+	
+	current_pool   = nullptr;
+	current_worker = -1;
+	
+	{
+		std::unique_lock<std::mutex> lk(pools_mutex);
+		workers[index]->thread = nullptr;
+	}
+	
+	// Last worker removes the pool from list
+	if (--alive == 0) {
+		std::unique_lock<std::mutex> lk(pools_mutex);
+		for (int i = 0; i < pools.size(); ++i)
+			if (pools[i] == this) {
+				pools.erase(pools.begin() + i);
+				break;
+			}
+	}
+};
+
+void pool_state::wake_all() {
+	{
+		std::unique_lock<std::mutex> lk(idle_mutex);
+	}
+	idle_var.notify_all();
+};
+
+void ThreadPool::shutdown() {
+	state->stopping = 1;
+	state->wake_all();
+};
+
+bool ThreadPool::help() {
+	if (!current_pool)
+		return 0;
+	
+	pool_task task;
+	if (!current_pool->take(current_worker, task))
+		return 0;
+	
+	current_pool->run(task);
+	return 1;
+};
+
+ThreadPool* ThreadPool::common(vscope* scope) {
+	static std::mutex               common_mutex;
+	static std::atomic<ThreadPool*> common_pool = { nullptr };
+	
+	ThreadPool* pool = common_pool.load(std::memory_order_acquire);
+	if (pool)
+		return pool;
+	
+	std::unique_lock<std::mutex> lk(common_mutex);
+	
+	pool = common_pool.load(std::memory_order_acquire);
+	if (pool)
+		return pool;
+	
+	int size = std::thread::hardware_concurrency();
+	if (size <= 0)
+		size = 1;
+	
+	pool = new ThreadPool(scope ? scope->get_root() : nullptr, size);
+	
+	// Referenced by static pointer. Locked, because root is dropped when pool is idle.
+	GIL::gc_instance()->lock(pool);
+	common_pool.store(pool, std::memory_order_release);
+	
+	return pool;
+};
+
+bool ThreadPool::is_worker() {
+	return current_pool;
+};
+
+void ThreadPool::shutdown_all() {
+	std::unique_lock<std::mutex> lk(pools_mutex);
+	
+	for (int i = 0; i < pools.size(); ++i) {
+		pools[i]->stopping    = 1;
+		pools[i]->terminating = 1;
+		
+		// Interrupt running tasks
+		for (int j = 0; j < pools[i]->workers.size(); ++j)
+			if (pools[i]->workers[j]->thread)
+				pools[i]->workers[j]->thread->set_running(0);
+		
+		pools[i]->wake_all();
+	}
+};
+
+// Must return integer representation of an object
+int64_t ThreadPool::int_value() {
+	return (intptr_t) this;
+};
+
+// Must return string representation of an object
+std::wstring ThreadPool::string_value() {
+	return std::wstring(L"[ThreadPool ") + std::to_wstring(size()) + std::wstring(L"]");
+};
@@ -0,0 +1,222 @@
+#include "objects/WeakMap.h"
+
+#include <string>
+
+#include "exceptions.h"
+#include "GIL2.h"
+
+#include "objects/Object.h"
+#include "objects/Bool.h"
+#include "objects/Int.h"
+#include "objects/NativeFunction.h"
+#include "objects/Undefined.h"
+#include "objects/Null.h"
+#include "objects/String.h"
+
+using namespace std;
+using namespace ck_exceptions;
+using namespace ck_vobject;
+using namespace ck_objects;
+using namespace ck_core;
+
+
+static vobject* call_handler(vscope* scope, const vector<vobject*>& args) {
+	return new WeakMap();
+};
+
+// Validates key of the map
+static vobject* check_key(vobject* key) {
+	if (!key || key->as_type<Undefined>() || key->as_type<Null>())
+		throw IllegalArgumentError(L"WeakMap expected object as key");
+	return key;
+};
+
+vobject* WeakMap::create_proto() {
+	if (WeakMapProto != nullptr)
+		return WeakMapProto;
+	
+	WeakMapProto = new CallableObject(call_handler);
+	GIL::gc_instance()->attach_root(WeakMapProto);
+	
+	WeakMapProto->Object::put(L"__typename", new String(L"WeakMap"));
+	
+	// Returns value by key or undefined
+	WeakMapProto->Object::put(L"get", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<WeakMap>())
+				return Undefined::instance();
+			
+			if (!args.size())
+				return Undefined::instance();
+			
+			vobject* value = static_cast<WeakMap*>(__this)->get_entry(args[0]);
+			return value ? value : Undefined::instance();
+		}));
+	WeakMapProto->Object::put(L"set", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<WeakMap>())
+				return Undefined::instance();
+			
+			if (args.size() < 2)
+				throw IllegalArgumentError(L"WeakMap.set expected key and value");
+			
+			static_cast<WeakMap*>(__this)->set_entry(check_key(args[0]), args[1]);
+			return __this;
+		}));
+	WeakMapProto->Object::put(L"has", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<WeakMap>())
+				return Undefined::instance();
+			
+			return Bool::instance(args.size() && static_cast<WeakMap*>(__this)->has_entry(args[0]));
+		}));
+	WeakMapProto->Object::put(L"delete", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<WeakMap>())
+				return Undefined::instance();
+			
+			return Bool::instance(args.size() && static_cast<WeakMap*>(__this)->remove_entry(args[0]));
+		}));
+	WeakMapProto->Object::put(L"clear", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<WeakMap>())
+				return Undefined::instance();
+			
+			static_cast<WeakMap*>(__this)->clear_entries();
+			return Undefined::instance();
+		}));
+	// Returns amount of entries that are still alive after last collection
+	WeakMapProto->Object::put(L"size", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<WeakMap>())
+				return Undefined::instance();
+			
+			return new Int(static_cast<WeakMap*>(__this)->size());
+		}));
+	
+	return WeakMapProto;
+};
+
+
+WeakMap::WeakMap() {
+	GIL::gc_instance()->attach_weak(this);
+};
+
+WeakMap::~WeakMap() {};
+
+
+vobject* WeakMap::get(vscope* scope, const wstring& name) {
+	vobject* ret = Object::get(name);
+	
+	if (!ret && WeakMapProto)
+		return WeakMapProto->get(scope, name);
+	return ret;
+};
+
+void WeakMap::put(vscope* scope, const wstring& name, vobject* object) {
+	Object::put(name, object);
+};
+
+bool WeakMap::contains(vscope* scope, const wstring& name) {
+	return Object::contains(name) || (WeakMapProto && WeakMapProto->contains(scope, name));
+};
+
+bool WeakMap::remove(vscope* scope, const wstring& name) {
+	if (Object::remove(name))
+		return 1;
+	return 0;
+};
+
+vobject* WeakMap::call(vscope* scope, const vector<vobject*>& args) {
+	throw UnsupportedOperation(L"WeakMap is not callable");
+};
+
+
+void WeakMap::gc_trace(gc_visitor& visitor) {
+	// Entries are traced by gc_trace_weak
+	Object::gc_trace(visitor);
+};
+
+void WeakMap::gc_finalize() {};
+
+void WeakMap::gc_trace_weak(gc_visitor& visitor) {
+	for (const auto& entry : entries)
+		if (entry.first->gc_is_reachable())
+			visitor.visit(entry.second);
+};
+
+void WeakMap::gc_clear_weak() {
+	for (auto it = entries.begin(); it != entries.end();)
+		if (!it->first->gc_is_reachable())
+			it = entries.erase(it);
+		else
+			++it;
+};
+
+
+// WeakMap functions only
+
+vobject* WeakMap::get_entry(vobject* key) {
+	vsobject::vslock lk(this);
+	
+	auto it = entries.find(key);
+	return it == entries.end() ? nullptr : it->second;
+};
+
+void WeakMap::set_entry(vobject* key, vobject* value) {
+	vsobject::vslock lk(this);
+	
+	entries[key] = value;
+};
+
+bool WeakMap::has_entry(vobject* key) {
+	vsobject::vslock lk(this);
+	
+	return entries.find(key) != entries.end();
+};
+
+bool WeakMap::remove_entry(vobject* key) {
+	vsobject::vslock lk(this);
+	
+	return entries.erase(key);
+};
+
+void WeakMap::clear_entries() {
+	vsobject::vslock lk(this);
+	
+	entries.clear();
+};
+
+int WeakMap::size() {
+	vsobject::vslock lk(this);
+	
+	return entries.size();
+};
+
+// Must return integer representation of an object
+int64_t WeakMap::int_value() { 
+	return size(); 
+};
+
+// Must return string representation of an object
+std::wstring WeakMap::string_value() { 
+	return std::wstring(L"[WeakMap ") + std::to_wstring(size()) + std::wstring(L"]"); 
+};
@@ -0,0 +1,146 @@
+#include "objects/WeakRef.h"
+
+#include <string>
+
+#include "exceptions.h"
+#include "GIL2.h"
+#include "executer.h"
+
+#include "objects/Object.h"
+#include "objects/Bool.h"
+#include "objects/NativeFunction.h"
+#include "objects/Undefined.h"
+#include "objects/Null.h"
+#include "objects/String.h"
+
+using namespace std;
+using namespace ck_exceptions;
+using namespace ck_vobject;
+using namespace ck_objects;
+using namespace ck_core;
+
+
+static vobject* call_handler(vscope* scope, const vector<vobject*>& args) {
+	if (!args.size() || !args[0] || args[0]->as_type<Undefined>() || args[0]->as_type<Null>())
+		throw IllegalArgumentError(L"WeakRef expected object as target");
+	
+	return new WeakRef(args[0], args.size() > 1 ? args[1] : nullptr);
+};
+
+vobject* WeakRef::create_proto() {
+	if (WeakRefProto != nullptr)
+		return WeakRefProto;
+	
+	WeakRefProto = new CallableObject(call_handler);
+	GIL::gc_instance()->attach_root(WeakRefProto);
+	
+	WeakRefProto->Object::put(L"__typename", new String(L"WeakRef"));
+	
+	// Returns target or undefined if it was collected
+	WeakRefProto->Object::put(L"get", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<WeakRef>())
+				return Undefined::instance();
+			
+			vobject* target = static_cast<WeakRef*>(__this)->get_target();
+			return target ? target : Undefined::instance();
+		}));
+	WeakRefProto->Object::put(L"isAlive", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<WeakRef>())
+				return Undefined::instance();
+			
+			return Bool::instance(static_cast<WeakRef*>(__this)->get_target());
+		}));
+	// Drops target, callback will not be called
+	WeakRefProto->Object::put(L"clear", new NativeFunction(
+		[](vscope* scope, const vector<vobject*>& args) -> vobject* {
+			// Validate __this
+			if (!scope) return Undefined::instance();
+			vobject* __this = scope->get(L"__this", 1);
+			if (!__this || !__this->as_type<WeakRef>())
+				return Undefined::instance();
+			
+			static_cast<WeakRef*>(__this)->clear();
+			return Undefined::instance();
+		}));
+	
+	return WeakRefProto;
+};
+
+
+WeakRef::WeakRef(vobject* target, vobject* callback) : target(target), callback(callback) {
+	GIL::gc_instance()->attach_weak(this);
+};
+
+WeakRef::~WeakRef() {};
+
+
+vobject* WeakRef::get(vscope* scope, const wstring& name) {
+	vobject* ret = Object::get(name);
+	
+	if (!ret && WeakRefProto)
+		return WeakRefProto->get(scope, name);
+	return ret;
+};
+
+void WeakRef::put(vscope* scope, const wstring& name, vobject* object) {
+	Object::put(name, object);
+};
+
+bool WeakRef::contains(vscope* scope, const wstring& name) {
+	return Object::contains(name) || (WeakRefProto && WeakRefProto->contains(scope, name));
+};
+
+bool WeakRef::remove(vscope* scope, const wstring& name) {
+	if (Object::remove(name))
+		return 1;
+	return 0;
+};
+
+vobject* WeakRef::call(vscope* scope, const vector<vobject*>& args) {
+	throw UnsupportedOperation(L"WeakRef is not callable");
+};
+
+
+void WeakRef::gc_trace(gc_visitor& visitor) {
+	Object::gc_trace(visitor);
+	
+	// target is not traced
+	visitor.visit(callback);
+};
+
+void WeakRef::gc_finalize() {};
+
+void WeakRef::gc_clear_weak() {
+	if (!target || target->gc_is_reachable())
+		return;
+	
+	target = nullptr;
+	
+	// Deliver callback on the collecting thread after collection is finished.
+	// Callback and this WeakRef are reachable, so they survive sweep and 
+	//  are marked by executer till the call.
+	if (callback) {
+		if (ck_executer* exec = GIL::executer_instance())
+			exec->late_call_object(callback, nullptr, { this }, L"<weakref_callback>");
+		
+		callback = nullptr;
+	}
+};
+
+// Must return integer representation of an object
+int64_t WeakRef::int_value() { 
+	return (intptr_t) this; 
+};
+
+// Must return string representation of an object
+std::wstring WeakRef::string_value() { 
+	return target ? L"[WeakRef]" : L"[WeakRef cleared]"; 
+};
@@ -0,0 +1,635 @@
+#include "event_loop.h"
+
+#include <thread>
+#include <algorithm>
+#include <tuple>
+#include <locale>
+#include <codecvt>
+#include <csignal>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#include "exceptions.h"
+#include "executer.h"
+
+#include "objects/Int.h"
+#include "objects/String.h"
+#include "objects/Undefined.h"
+#include "objects/Cake.h"
+#include "objects/Future.h"
+
+using namespace std;
+using namespace ck_core;
+using namespace ck_vobject;
+using namespace ck_objects;
+using namespace ck_exceptions;
+
+
+// Returns length of prefix of data without incomplete UTF-8 sequence at the end
+static size_t utf8_complete(const std::string& data) {
+	size_t size  = data.size();
+	size_t start = size;
+	
+	// Find start of the last sequence
+	for (int i = 0; i < 4 && start > 0; ++i) {
+		--start;
+		if ((data[start] & 0xC0) != 0x80)
+			break;
+	}
+	
+	if (start == size)
+		return size;
+	
+	unsigned char lead = data[start];
+	size_t length = 1;
+	if ((lead & 0xE0) == 0xC0)
+		length = 2;
+	else if ((lead & 0xF0) == 0xE0)
+		length = 3;
+	else if ((lead & 0xF8) == 0xF0)
+		length = 4;
+	
+	return start + length > size ? start : size;
+};
+
+// Converts received bytes to string, invalid sequences are passed as bytes
+static std::wstring utf8_decode(const std::string& data) {
+	try {
+		return std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>>().from_bytes(data);
+	} catch (const std::range_error&) {
+		std::wstring result;
+		for (int i = 0; i < data.size(); ++i)
+			result += (wchar_t) (unsigned char) data[i];
+		return result;
+	}
+};
+
+
+// E V E N T _ L O O P _ G C _ O B J E C T
+
+event_loop_gc_object::event_loop_gc_object(event_loop* loop) {
+	this->loop = loop;
+};
+
+event_loop_gc_object::~event_loop_gc_object() {};
+
+void event_loop_gc_object::gc_trace(gc_visitor& visitor) {
+	std::unique_lock<std::mutex> lk(loop->mutex);
+	
+	auto visit = [&visitor](io_request* request) {
+		if (!request)
+			return;
+		
+		visitor.visit(request->source);
+		visitor.visit(request->future);
+		visitor.visit(request->callback);
+		
+		for (int i = 0; i < request->args.size(); ++i)
+			visitor.visit(request->args[i]);
+	};
+	
+	for (auto& w : loop->watches) {
+		for (io_request* request : w.second.reads)
+			visit(request);
+		for (io_request* request : w.second.writes)
+			visit(request);
+	}
+	
+	for (auto& c : loop->completed)
+		for (int i = 0; i < c.second.size(); ++i)
+			visit(c.second[i]);
+	
+	for (auto& t : loop->timers)
+		visit(t.second);
+};
+
+void event_loop_gc_object::gc_finalize() {};
+
+
+// E V E N T _ L O O P
+
+std::atomic<event_loop*> event_loop::loop_instance = { nullptr };
+
+event_loop::event_loop() : start(std::chrono::steady_clock::now()) {
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd == -1)
+		throw IOError(std::wstring(L"epoll_create failed: ") + std::to_wstring(errno));
+	
+	wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	
+	epoll_event event;
+	event.events  = EPOLLIN;
+	event.data.fd = wake_fd;
+	epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event);
+	
+	// Will be disposed by GC.
+	gc_marker = new event_loop_gc_object(this);
+	GIL::gc_instance()->attach_root(gc_marker);
+};
+
+event_loop* event_loop::instance() {
+	event_loop* loop = loop_instance.load(std::memory_order_acquire);
+	if (loop)
+		return loop;
+	
+	static std::mutex init_mutex;
+	std::unique_lock<std::mutex> lk(init_mutex);
+	
+	loop = loop_instance.load(std::memory_order_acquire);
+	if (loop)
+		return loop;
+	
+	loop = new event_loop();
+	
+	// Reactor lives till the end of the process
+	std::thread(&event_loop::run_reactor, loop).detach();
+	
+	loop_instance.store(loop, std::memory_order_release);
+	return loop;
+};
+
+void event_loop::run_reactor() {
+	// XXX: Platform-dependent code
+	// Signals are handled by main thread, blocked SIGPIPE turns into EPIPE
+	sigset_t set;
+	sigfillset(&set);
+	pthread_sigmask(SIG_BLOCK, &set, NULL);
+	
+	epoll_event events[64];
+	
+	while (1) {
+		// Sleep till the next timer slot or I/O event
+		int64_t timeout;
+		{
+			std::unique_lock<std::mutex> lk(mutex);
+			
+			if (expire_timers())
+				completed_var.notify_all();
+			
+			timeout = wheel.next_timeout();
+		}
+		
+		int count = epoll_wait(epoll_fd, events, 64, timeout);
+		if (count < 0) {
+			if (errno == EINTR)
+				continue;
+			return;
+		}
+		
+		if (stopped.load(std::memory_order_acquire))
+			return;
+		
+		std::unique_lock<std::mutex> lk(mutex);
+		
+		bool notify = 0;
+		for (int i = 0; i < count; ++i) {
+			int fd = events[i].data.fd;
+			
+			// Timer was added, timeout is recalculated on the next iteration
+			if (fd == wake_fd) {
+				uint64_t value;
+				::read(wake_fd, &value, sizeof(value));
+				continue;
+			}
+			
+			auto it = watches.find(fd);
+			if (it == watches.end())
+				continue;
+			
+			fd_watch& watch = it->second;
+			uint32_t mask   = events[i].events;
+			
+			if (mask & (EPOLLIN | EPOLLHUP | EPOLLERR))
+				while (watch.reads.size() && perform(watch, watch.reads.front())) {
+					complete(watch.reads.front());
+					watch.reads.pop_front();
+					notify = 1;
+				}
+			
+			if (mask & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+				while (watch.writes.size() && perform(watch, watch.writes.front())) {
+					complete(watch.writes.front());
+					watch.writes.pop_front();
+					notify = 1;
+				}
+			
+			update(fd, watch);
+		}
+		
+		if (notify)
+			completed_var.notify_all();
+	}
+};
+
+bool event_loop::perform(fd_watch& watch, io_request* request) {
+	if (request->type == io_request::WRITE) {
+		while (request->offset < request->buffer.size()) {
+			ssize_t n = ::write(request->fd, request->buffer.data() + request->offset, request->buffer.size() - request->offset);
+			
+			if (n >= 0) {
+				request->offset += n;
+				continue;
+			}
+			
+			if (errno == EINTR)
+				continue;
+			
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			
+			request->error = errno;
+			return 1;
+		}
+		
+		return 1;
+	}
+	
+	char chunk[65536];
+	while (1) {
+		ssize_t n = ::read(request->fd, chunk, sizeof(chunk));
+		
+		if (n > 0) {
+			watch.carry.append(chunk, n);
+			
+			if (request->type == io_request::READ_ALL)
+				continue;
+			
+			// Deliver only complete characters, rest waits for the next chunk
+			size_t length = utf8_complete(watch.carry);
+			if (length == 0)
+				continue;
+			
+			request->buffer = watch.carry.substr(0, length);
+			watch.carry.erase(0, length);
+			return 1;
+		}
+		
+		// End of input, deliver everything left
+		if (n == 0) {
+			request->buffer.swap(watch.carry);
+			watch.carry.clear();
+			return 1;
+		}
+		
+		if (errno == EINTR)
+			continue;
+		
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+			return 0;
+		
+		request->error = errno;
+		return 1;
+	}
+};
+
+void event_loop::complete(io_request* request) {
+	completed[request->owner].push_back(request);
+	request->owner->request_poll(gil_thread::POLL_LATE_CALL);
+};
+
+uint64_t event_loop::now_tick() {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+};
+
+void event_loop::schedule(io_request* request, uint64_t deadline) {
+	request->timer.deadline = deadline;
+	request->timer.request  = request;
+	wheel.insert(&request->timer);
+	
+	uint64_t value = 1;
+	::write(wake_fd, &value, sizeof(value));
+};
+
+bool event_loop::expire_timers() {
+	std::vector<timer_entry*> expired;
+	wheel.advance(now_tick(), expired);
+	
+	for (int i = 0; i < expired.size(); ++i)
+		complete(expired[i]->request);
+	
+	return expired.size();
+};
+
+int event_loop::update(int fd, fd_watch& watch) {
+	uint32_t mask = 0;
+	if (watch.reads.size())
+		mask |= EPOLLIN;
+	if (watch.writes.size())
+		mask |= EPOLLOUT;
+	
+	if (!mask) {
+		if (watch.registered) {
+			epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+			watch.registered = 0;
+		}
+		
+		return 0;
+	}
+	
+	epoll_event event;
+	event.events  = mask;
+	event.data.fd = fd;
+	
+	if (epoll_ctl(epoll_fd, watch.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &event) == -1)
+		return errno;
+	
+	watch.registered = 1;
+	return 0;
+};
+
+void event_loop::submit(io_request* request) {
+	request->owner = GIL::current_thread();
+	
+	std::unique_lock<std::mutex> lk(mutex);
+	
+	fd_watch& watch = watches[request->fd];
+	std::deque<io_request*>& queue = request->type == io_request::WRITE ? watch.writes : watch.reads;
+	
+	++pending[request->owner];
+	queue.push_back(request);
+	
+	// Descriptor is already watched for this operation
+	if (queue.size() > 1)
+		return;
+	
+	int error = update(request->fd, watch);
+	if (!error)
+		return;
+	
+	queue.pop_back();
+	
+	// Regular files can not be polled and are always ready
+	if (error == EPERM)
+		while (!perform(watch, request));
+	else
+		request->error = error;
+	
+	complete(request);
+	update(request->fd, watch);
+};
+
+void event_loop::close(int fd) {
+	{
+		std::unique_lock<std::mutex> lk(mutex);
+		
+		auto it = watches.find(fd);
+		if (it == watches.end())
+			return;
+		
+		fd_watch& watch = it->second;
+		if (watch.registered)
+			epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+		
+		for (io_request* request : watch.reads) {
+			request->error = EBADF;
+			complete(request);
+		}
+		
+		for (io_request* request : watch.writes) {
+			request->error = EBADF;
+			complete(request);
+		}
+		
+		watches.erase(it);
+	}
+	
+	completed_var.notify_all();
+};
+
+bool event_loop::dispatch() {
+	gil_thread* thread = GIL::current_thread();
+	
+	// Keep values alive after removing requests from the list
+	gc_handle_scope handles;
+	std::vector<io_request*> requests;
+	
+	{
+		std::unique_lock<std::mutex> lk(mutex);
+		
+		auto it = completed.find(thread);
+		if (it == completed.end() || !it->second.size())
+			return 0;
+		
+		pending[thread] -= it->second.size();
+		
+		for (int i = 0; i < it->second.size(); ++i) {
+			io_request* request = it->second[i];
+			
+			// Timer was cleared after expiration
+			if (request->cancelled) {
+				delete request;
+				continue;
+			}
+			
+			handles.add(request->future);
+			handles.add(request->callback);
+			for (int j = 0; j < request->args.size(); ++j)
+				handles.add(request->args[j]);
+			
+			requests.push_back(request);
+		}
+		
+		it->second.clear();
+	}
+	
+	ck_executer* executer = GIL::executer_instance();
+	
+	// Late calls are executed from the back of the list,
+	//  so callbacks are queued in reverse order of completion.
+	std::vector<std::tuple<vobject*, std::vector<vobject*>, const wchar_t*>> callbacks;
+	std::vector<io_request*> fired;
+	
+	for (int i = 0; i < requests.size(); ++i) {
+		io_request* request = requests[i];
+		
+		if (request->type == io_request::TIMER) {
+			if (executer)
+				callbacks.push_back({ request->callback, request->args, L"<timer_callback>" });
+			
+			// Deleted or scheduled again after other requests are dispatched
+			fired.push_back(request);
+			continue;
+		}
+		
+		if (request->error) {
+			Cake* error = new Cake(IOError(utf8_decode(strerror(request->error))));
+			handles.add(error);
+			
+			if (request->future)
+				request->future->reject(error);
+		} else {
+			vobject* value;
+			if (request->type == io_request::WRITE)
+				value = new Int(request->offset);
+			else if (request->type == io_request::READ && !request->buffer.size())
+				value = Undefined::instance();
+			else
+				value = new String(utf8_decode(request->buffer));
+			handles.add(value);
+			
+			if (request->future)
+				request->future->resolve(value);
+			
+			if (request->callback && executer)
+				callbacks.push_back({ request->callback, { value }, L"<io_callback>" });
+		}
+		
+		delete request;
+	}
+	
+	if (fired.size()) {
+		std::unique_lock<std::mutex> lk(mutex);
+		
+		for (int i = 0; i < fired.size(); ++i) {
+			io_request* request = fired[i];
+			
+			if (request->interval > 0 && !request->cancelled) {
+				// Missed periods are skipped
+				uint64_t deadline = std::max(request->timer.deadline + request->interval, now_tick());
+				
+				++pending[thread];
+				schedule(request, deadline);
+				continue;
+			}
+			
+			if (!request->cancelled)
+				timers.erase(request->timer_id);
+			delete request;
+		}
+	}
+	
+	for (int i = callbacks.size() - 1; i >= 0; --i)
+		executer->late_call_object(std::get<0>(callbacks[i]), nullptr, std::get<1>(callbacks[i]), std::get<2>(callbacks[i]));
+	
+	return 1;
+};
+
+bool event_loop::has_pending() {
+	std::unique_lock<std::mutex> lk(mutex);
+	
+	auto it = pending.find(GIL::current_thread());
+	return it != pending.end() && it->second > 0;
+};
+
+void event_loop::wait(int64_t timeout) {
+	gil_thread* thread = GIL::current_thread();
+	
+	std::unique_lock<std::mutex> lk(mutex);
+	completed_var.wait_for(lk, std::chrono::milliseconds(timeout), [this, thread]() -> bool {
+		auto it = completed.find(thread);
+		return (it != completed.end() && it->second.size()) || !thread->is_running();
+	});
+};
+
+void event_loop::run() {
+	gil_thread*  thread   = GIL::current_thread();
+	ck_executer* executer = GIL::executer_instance();
+	
+	while (thread->is_running() && has_pending()) {
+		if (!dispatch()) {
+			// Allow other threads to perform stop-the-world while waiting
+			GIL::instance()->io_block();
+			wait(100);
+			GIL::instance()->io_unblock();
+			continue;
+		}
+		
+		executer->run_late_calls();
+	}
+};
+
+void event_loop::release(gil_thread* thread) {
+	std::unique_lock<std::mutex> lk(mutex);
+	
+	for (auto it = watches.begin(); it != watches.end(); ++it) {
+		fd_watch& watch = it->second;
+		
+		for (std::deque<io_request*>* queue : { &watch.reads, &watch.writes })
+			for (auto r = queue->begin(); r != queue->end();)
+				if ((*r)->owner == thread) {
+					delete *r;
+					r = queue->erase(r);
+				} else
+					++r;
+		
+		update(it->first, watch);
+	}
+	
+	// Expired timers are deleted with completed requests
+	for (auto t = timers.begin(); t != timers.end();)
+		if (t->second->owner == thread) {
+			if (t->second->timer.slot) {
+				wheel.remove(&t->second->timer);
+				delete t->second;
+			}
+			
+			t = timers.erase(t);
+		} else
+			++t;
+	
+	auto it = completed.find(thread);
+	if (it != completed.end()) {
+		for (int i = 0; i < it->second.size(); ++i)
+			delete it->second[i];
+		completed.erase(it);
+	}
+	
+	pending.erase(thread);
+};
+
+uint64_t event_loop::set_timer(int64_t delay, int64_t interval, vobject* callback, const std::vector<vobject*>& args) {
+	io_request* request = new io_request();
+	request->type     = io_request::TIMER;
+	request->fd       = -1;
+	request->owner    = GIL::current_thread();
+	request->callback = callback;
+	request->interval = interval;
+	request->args     = args;
+	
+	std::unique_lock<std::mutex> lk(mutex);
+	
+	request->timer_id = ++timer_counter;
+	timers[request->timer_id] = request;
+	++pending[request->owner];
+	
+	schedule(request, now_tick() + std::max(delay, (int64_t) 0));
+	
+	return request->timer_id;
+};
+
+bool event_loop::clear_timer(uint64_t id) {
+	std::unique_lock<std::mutex> lk(mutex);
+	
+	auto it = timers.find(id);
+	if (it == timers.end())
+		return 0;
+	
+	io_request* request = it->second;
+	timers.erase(it);
+	
+	if (request->timer.slot) {
+		wheel.remove(&request->timer);
+		--pending[request->owner];
+		delete request;
+	} else
+		// Expired and waiting for dispatch
+		request->cancelled = 1;
+	
+	return 1;
+};
+
+void event_loop::shutdown() {
+	event_loop* loop = loop_instance.load(std::memory_order_acquire);
+	if (!loop)
+		return;
+	
+	// Reactor thread is detached and must not keep process alive
+	loop->stopped.store(1, std::memory_order_release);
+	
+	uint64_t value = 1;
+	::write(loop->wake_fd, &value, sizeof(value));
+};
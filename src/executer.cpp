@@ -8,6 +8,7 @@
 #include "script.h"
 #include "translator.h"
 #include "stack_locator.h"
+#include "event_loop.h"
 
 #include "vscope.h"
 #include "objects/Object.h"
@@ -21,6 +22,8 @@
 #include "objects/BytecodeFunction.h"
 #include "objects/NativeFunction.h"
 #include "objects/Cake.h"
+#include "objects/Generator.h"
+#include "objects/Mutex.h"
 
 
 // #define DEBUG_OUTPUT
@@ -56,30 +59,28 @@ ck_executer_gc_object::ck_executer_gc_object(ck_executer* exec_instance) {
 
 ck_executer_gc_object::~ck_executer_gc_object() {};
 
-void ck_executer_gc_object::gc_mark() {
+void ck_executer_gc_object::gc_trace(gc_visitor& visitor) {
 	if (!exec_instance)
 		return;
 	
 	for (int i = 0; i < exec_instance->scopes.size(); ++i)
-		if (exec_instance->scopes[i] && !exec_instance->scopes[i]->gc_reachable)
-			exec_instance->scopes[i]->gc_mark();
+		visitor.visit(exec_instance->scopes[i]);
 	for (int i = 0; i < exec_instance->objects.size(); ++i)
-		if (exec_instance->objects[i] && !exec_instance->objects[i]->gc_reachable)
-			exec_instance->objects[i]->gc_mark();
+		visitor.visit(exec_instance->objects[i]);
+	for (int i = 0; i < exec_instance->try_stack.size(); ++i)
+		visitor.visit(exec_instance->try_stack[i].monitor);
+	
+	exec_instance->thread->get_mailbox().gc_trace(visitor);
 		
 	vector<late_call_instance>& late_call = exec_instance->late_call;
 		
 	for (int i = 0; i < late_call.size(); ++i) {
-		if (late_call[i].obj && !late_call[i].obj->gc_reachable)
-			late_call[i].obj->gc_mark();
-		if (late_call[i].ref && !late_call[i].ref->gc_reachable)
-			late_call[i].ref->gc_mark();
-		if (late_call[i].scope && !late_call[i].scope->gc_reachable)
-			late_call[i].scope->gc_mark();
+		visitor.visit(late_call[i].obj);
+		visitor.visit(late_call[i].ref);
+		visitor.visit(late_call[i].scope);
 		
 		for (int j = 0; j < late_call[i].args.size(); ++j)
-			if (late_call[i].args[j] && !late_call[i].args[j]->gc_reachable)
-				late_call[i].args[j]->gc_mark();
+			visitor.visit(late_call[i].args[j]);
 	}
 };
 
@@ -92,6 +93,8 @@ ck_executer::ck_executer() {
 	// Will be disposed by GC.
 	gc_marker = new ck_executer_gc_object(this);
 	GIL::gc_instance()->attach_root(gc_marker);
+	
+	thread = GIL::current_thread();
 };
 
 ck_executer::~ck_executer() {
@@ -234,9 +237,6 @@ void ck_executer::restore_try_frame(int restored_frame_id) {
 			if (window_stack[i].scope_id + 1 > scope_id 
 			&& window_stack[i].scope_id + 1 < scopes.size()
 			&& scopes[window_stack[i].scope_id + 1] != nullptr) {
-				if (window_stack[i].own_scope)
-					scopes[window_stack[i].scope_id + 1]->unroot();
-				
 				scopes[window_stack[i].scope_id + 1] = nullptr;
 			}
 	
@@ -247,21 +247,12 @@ void ck_executer::restore_try_frame(int restored_frame_id) {
 			if (call_stack[i].scope_id + 1 > scope_id 
 			&& call_stack[i].scope_id + 1 < scopes.size()
 			&& scopes[call_stack[i].scope_id + 1] != nullptr) {
-				if (call_stack[i].own_scope)
-					scopes[call_stack[i].scope_id + 1]->unroot();
-				
 				scopes[call_stack[i].scope_id + 1] = nullptr;
 			}
 		}
-			
-	// Clear all scopes untill scope_id value and .unroot() them.
-	// All resting scopes (except scope_id+1 is created by VSTATE_PUSH_SCOPE
-	//  and marked as root by default).
-	for (int i = scopes.size() - 1; i > scope_id + 1; --i)
-		if (scopes[i])
-			scopes[i]->unroot();
 	
 	// Restore stacks position
+	release_monitors(try_id + 1);
 	window_stack.resize(window_id + 1);
 	call_stack.resize(call_id + 1);
 	try_stack.resize(try_id + 1);
@@ -299,9 +290,6 @@ void ck_executer::restore_call_frame(int restored_frame_id) {
 			if (window_stack[i].scope_id + 1 > scope_id 
 			&& window_stack[i].scope_id + 1 < scopes.size()
 			&& scopes[window_stack[i].scope_id + 1] != nullptr) {
-				if (window_stack[i].own_scope)
-					scopes[window_stack[i].scope_id + 1]->unroot();
-				
 				scopes[window_stack[i].scope_id + 1] = nullptr;
 			}
 	
@@ -312,21 +300,12 @@ void ck_executer::restore_call_frame(int restored_frame_id) {
 			if (call_stack[i].scope_id + 1 > scope_id 
 			&& call_stack[i].scope_id + 1 < scopes.size()
 			&& scopes[call_stack[i].scope_id + 1] != nullptr) {
-				if (call_stack[i].own_scope)
-					scopes[call_stack[i].scope_id + 1]->unroot();
-				
 				scopes[call_stack[i].scope_id + 1] = nullptr;
 			}
 		}
-			
-	// Clear all scopes untill scope_id value and .unroot() them.
-	// All resting scopes (except scope_id+1 is created by VSTATE_PUSH_SCOPE
-	//  and marked as root by default).
-	for (int i = scopes.size() - 1; i > scope_id + 1; --i)
-		if (scopes[i])
-			scopes[i]->unroot();
 	
 	// Restore stacks position
+	release_monitors(try_id + 1);
 	window_stack.resize(window_id + 1);
 	call_stack.resize(call_id + 1);
 	try_stack.resize(try_id + 1);
@@ -364,9 +343,6 @@ void ck_executer::restore_window_frame(int restored_frame_id) {
 			if (window_stack[i].scope_id + 1 > scope_id 
 			&& window_stack[i].scope_id + 1 < scopes.size()
 			&& scopes[window_stack[i].scope_id + 1] != nullptr) {
-				if (window_stack[i].own_scope)
-					scopes[window_stack[i].scope_id + 1]->unroot();
-				
 				scopes[window_stack[i].scope_id + 1] = nullptr;
 			}
 	
@@ -377,21 +353,12 @@ void ck_executer::restore_window_frame(int restored_frame_id) {
 			if (call_stack[i].scope_id + 1 > scope_id 
 			&& call_stack[i].scope_id + 1 < scopes.size()
 			&& scopes[call_stack[i].scope_id + 1] != nullptr) {
-				if (call_stack[i].own_scope)
-					scopes[call_stack[i].scope_id + 1]->unroot();
-				
 				scopes[call_stack[i].scope_id + 1] = nullptr;
 			}
 		}
-			
-	// Clear all scopes untill scope_id value and .unroot() them.
-	// All resting scopes (except scope_id+1 is created by VSTATE_PUSH_SCOPE
-	//  and marked as root by default).
-	for (int i = scopes.size() - 1; i > scope_id + 1; --i)
-		if (scopes[i])
-			scopes[i]->unroot();
 	
 	// Restore stacks position
+	release_monitors(try_id + 1);
 	window_stack.resize(window_id + 1);
 	call_stack.resize(call_id + 1);
 	try_stack.resize(try_id + 1);
@@ -410,9 +377,6 @@ void ck_executer::restore_all() {
 	if (window_stack.size())
 		for (int i = window_stack.size() - 1; i > 0; --i)
 			if (window_stack[i].scope_id + 1 < scopes.size() && scopes[window_stack[i].scope_id + 1] != nullptr) {
-				if (window_stack[i].own_scope)
-					scopes[window_stack[i].scope_id + 1]->unroot();
-				
 				scopes[window_stack[i].scope_id + 1] = nullptr;
 			}
 	
@@ -421,19 +385,12 @@ void ck_executer::restore_all() {
 	if (call_stack.size())
 		for (int i = call_stack.size() - 1; i > 0; --i) {
 			if (call_stack[i].scope_id + 1 < scopes.size() && scopes[call_stack[i].scope_id + 1] != nullptr) {
-				if (call_stack[i].own_scope)
-					scopes[call_stack[i].scope_id + 1]->unroot();
-				
 				scopes[call_stack[i].scope_id + 1] = nullptr;
 			}
 		}
-		
-	// Erase all resting scope that are made by VSTATE_PUSH_SCOPE
-	for (int i = 0; i < scopes.size(); ++i)
-		if (scopes[i])
-			scopes[i]->unroot();
 	
 	// Erase all
+	release_monitors(0);
 	window_stack.resize(0);
 	call_stack.resize(0);
 	try_stack.resize(0);
@@ -443,6 +400,14 @@ void ck_executer::restore_all() {
 	objects.resize(0);
 };
 
+void ck_executer::release_monitors(int try_size) {
+	for (int i = (int) try_stack.size() - 1; i >= try_size && i >= 0; --i)
+		if (try_stack[i].try_type == ck_bytecodes::TRY_MONITOR && try_stack[i].monitor) {
+			Mutex::exit(try_stack[i].monitor);
+			try_stack[i].monitor = nullptr;
+		}
+};
+
 void ck_executer::follow_exception(const cake& msg) { 
 	
 	if (try_stack.size() == 0) { // No try-catch, rethrow upwards
@@ -456,6 +421,17 @@ void ck_executer::follow_exception(const cake& msg) {
 		throw copy;	
 	}
 	
+	// Leave synchronized block and pass exception to the enclosing frame
+	if (try_stack.back().try_type == ck_bytecodes::TRY_MONITOR) {
+		cake copy(msg);
+		if (!copy.has_backtrace() && copy.get_type_id() != cake_type::CK_OBJECT) 
+			copy.collect_backtrace();
+		
+		restore_try_frame(try_stack.size() - 1);
+		
+		throw copy;
+	}
+	
 	int type          = try_stack.back().try_type;
 	int catch_address = try_stack.back().catch_node;
 	int window_id     = try_stack.back().window_id;
@@ -479,7 +455,6 @@ void ck_executer::follow_exception(const cake& msg) {
 					throw StackCorruption(L"scopes stack corrupted");
 				
 				vscope* scope = new iscope(scopes.back());
-				scope->root();
 				scope->put(handler, msg.get_type_id() == cake_type::CK_OBJECT ? msg.get_object() : new Cake(msg), 0, 1);
 				scopes.push_back(scope);
 				goto_address(catch_address); 
@@ -504,7 +479,6 @@ void ck_executer::follow_exception(const cake& msg) {
 					throw StackCorruption(L"scopes stack corrupted");
 				
 				vscope* scope = new iscope(scopes.back());
-				scope->root();
 				scope->put(handler, copy.get_type_id() == cake_type::CK_OBJECT ? copy.get_object() : new Cake(copy), 0, 1);
 				scopes.push_back(scope);
 				goto_address(catch_address); 
@@ -515,37 +489,111 @@ void ck_executer::follow_exception(const cake& msg) {
 };
 
 
-vobject* ck_executer::exec_bytecode() { 
-
-	while (!is_eof()) {
-		
-		// Check if thread is dead (suspended or anything else)
-		if (!GIL::current_thread()->is_running())
-			return nullptr;
+bool ck_executer::poll_safepoint() {
+	uint32_t bits = thread->take_poll();
+	
+	// Respond to GIL requests
+	if (bits & gil_thread::POLL_STOP)
+		GIL::instance()->accept_lock();
+	
+	// Perform GC collection if allocator requested it
+	if (bits & gil_thread::POLL_GC) {
+		if (GIL::gc_instance()->dump_pending())
+			GIL::gc_instance()->dump_pending_heap();
 		
-		// Check for pending late calls
-		while (late_call.size()) {
-			
-			late_call_instance instance = late_call.back();
-			
-			// Restore root ownership
-			if (instance.own_obj)
-				instance.obj->gc_make_unroot();
+		if (GIL::gc_instance()->collect_pending())
+			GIL::gc_instance()->collect();
+	}
+	
+	// Check if thread is dead (suspended or anything else)
+	if (!thread->is_running()) {
+		// Keep request for the outer frames
+		thread->request_poll(gil_thread::POLL_TERMINATE);
+		return 0;
+	}
+	
+	// Check for pending late calls
+	if (bits & gil_thread::POLL_LATE_CALL) {
+		// Completed asynchronous I/O requests queue their callbacks as late calls
+		if (event_loop::exists())
+			event_loop::instance()->dispatch();
 			
-			if (instance.own_ref)
-				instance.ref->gc_make_unroot();
+		// Running call is not interrupted, rest of the list is executed after it
+		if (!in_late_call)
+			run_late_calls();
+	}
+	
+	return 1;
+};
+
+int ck_executer::receive_mail() {
+	int count = 0;
+	
+	// Newest item is the head, so the oldest is pushed last and runs first
+	mail_item* item = thread->get_mailbox().take();
+	while (item) {
+		late_call_object(item->obj, nullptr, item->args, L"<posted_callback>");
+		
+		mail_item* next = item->next;
+		delete item;
+		item = next;
+		++count;
+	}
+	
+	return count;
+};
 			
-			for (int i = 0; i < instance.args.size(); ++i)
-				if (instance.own_args[i]) 
-					instance.args[i]->gc_make_unroot();
+void ck_executer::run_late_calls() {
+	// Whole list is executed here, so entry of the called function
+	//  does not start executing the rest of list out of order.
+	thread->clear_poll(gil_thread::POLL_LATE_CALL);
 			
-			// Remove call from the list
-			late_call.pop_back();
+	bool outer_late_call = in_late_call;
+	in_late_call = 1;
 			
-			// Exceptions automatically rethrown up
+	// Callbacks posted by other threads are received after the list is empty
+	while (late_call.size() || receive_mail()) {
+		
+		late_call_instance instance = late_call.back();
+		
+		// Keep values alive after removing from the list
+		gc_handle_scope handles;
+		handles.add(instance.obj);
+		handles.add(instance.ref);
+		handles.add(instance.scope);
+		for (int i = 0; i < instance.args.size(); ++i)
+			handles.add(instance.args[i]);
+		
+		// Remove call from the list
+		late_call.pop_back();
+		
+		// Exceptions automatically rethrown up
+		try {
 			call_object(instance.obj, instance.ref, instance.args, instance.name, instance.scope, instance.use_scope_without_wrap);
+		} catch (...) {
+			in_late_call = outer_late_call;
+			throw;
 		}
+	}
+	
+	in_late_call = outer_late_call;
+};
+
+vobject* ck_executer::exec_bytecode() { 
+	
+	// Set on backward jumps, calls and returns. 
+	// Entering the frame is a safepoint too.
+	bool safepoint = 1;
+	
+	while (!is_eof()) {
 		
+		if (safepoint) {
+			safepoint = 0;
+			
+			if (thread->poll() && !poll_safepoint())
+				return nullptr;
+		}
+
 #ifdef DEBUG_OUTPUT
 		wcout << "[" << pointer << "] ";
 #endif
@@ -769,6 +817,10 @@ vobject* ck_executer::exec_bytecode() {
 					args.push_back(objects.rbegin()[argc-k-1 + 1]);
 				
 				vobject* obj = call_object(objects.rbegin()[0], nullptr, args, L"");
+				
+				// Returning from call is a safepoint
+				safepoint = 1;
+				
 				for (int k = 0; k < argc + 1; ++k)
 					objects.pop_back();
 				vpush(obj);
@@ -807,6 +859,10 @@ vobject* ck_executer::exec_bytecode() {
 					args.push_back(objects.rbegin()[argc-k-1 + 2]);
 				
 				vobject* obj = call_object(objects.back(), objects.rbegin()[1], args, str);
+				
+				// Returning from call is a safepoint
+				safepoint = 1;
+				
 				for (int k = 0; k < argc + 2; ++k)
 					objects.pop_back();
 				vpush(obj);
@@ -843,6 +899,10 @@ vobject* ck_executer::exec_bytecode() {
 					args.push_back(objects.rbegin()[argc-k-1 + 1]);
 				
 				vobject* obj = call_object(objects.rbegin()[0], scopes.back(), args, str);
+				
+				// Returning from call is a safepoint
+				safepoint = 1;
+				
 				for (int k = 0; k < argc + 1; ++k)
 					objects.pop_back();
 				vpush(obj);
@@ -885,6 +945,10 @@ vobject* ck_executer::exec_bytecode() {
 					args.push_back(objects.rbegin()[argc-k-1 + 3]);
 				
 				vobject* obj = call_object(objects.rbegin()[0], objects.rbegin()[2], args, L"[" + key + L"]");
+				
+				// Returning from call is a safepoint
+				safepoint = 1;
+				
 				for (int k = 0; k < argc + 3; ++k)
 					objects.pop_back();
 				vpush(obj);
@@ -1164,9 +1228,7 @@ vobject* ck_executer::exec_bytecode() {
 				if (scopes.size() == 0)
 					throw StackCorruption(L"scopes stack corrupted");
 				
-				vscope* s = new iscope(scopes.back());
-				GIL::gc_instance()->attach_root(s);
-				scopes.push_back(s);
+				scopes.push_back(new iscope(scopes.back()));
 				break;
 			}
 			
@@ -1178,8 +1240,6 @@ vobject* ck_executer::exec_bytecode() {
 				// Check for scope
 				validate_scope();	
 				
-				vscope* s = scopes.back();
-				GIL::gc_instance()->deattach_root(s);
 				scopes.pop_back();
 				break;
 			}
@@ -1193,8 +1253,11 @@ vobject* ck_executer::exec_bytecode() {
 #endif
 				
 				vobject* o = vpop();
-				if (o == nullptr || o->int_value() == 0)
+				if (o == nullptr || o->int_value() == 0) {
+					// Backward jump is a safepoint
+					safepoint = i <= pointer;
 					goto_address(i);
+				}
 				break;
 			}
 			
@@ -1207,8 +1270,11 @@ vobject* ck_executer::exec_bytecode() {
 #endif
 				
 				vobject* o = vpop();
-				if (o != nullptr && o->int_value() != 0)
+				if (o != nullptr && o->int_value() != 0) {
+					// Backward jump is a safepoint
+					safepoint = i <= pointer;
 					goto_address(i);
+				}
 				break;
 			}
 			
@@ -1220,6 +1286,8 @@ vobject* ck_executer::exec_bytecode() {
 				wcout << "> JMP [" << i << ']' << endl;
 #endif
 				
+				// Backward jump is a safepoint
+				safepoint = i <= pointer;
 				goto_address(i);
 				break;
 			}
@@ -1297,11 +1365,14 @@ vobject* ck_executer::exec_bytecode() {
 				break;
 			}
 			
-			case ck_bytecodes::PUSH_CONST_FUNCTION: {
+			case ck_bytecodes::PUSH_CONST_FUNCTION: 
+			case ck_bytecodes::PUSH_CONST_GENERATOR: {
 				
 				// Check for scope
 				validate_scope();		
 				
+				bool is_generator = scripts.back()->bytecode.bytemap[pointer - 1] == ck_bytecodes::PUSH_CONST_GENERATOR;
+				
 				int argc; 
 				read(sizeof(int), &argc);
 #ifdef DEBUG_OUTPUT
@@ -1381,7 +1452,7 @@ vobject* ck_executer::exec_bytecode() {
 				
 				pointer += sizeof_block;
 				
-				vpush(new BytecodeFunction(scopes.back(), script, argn));
+				vpush(new BytecodeFunction(scopes.back(), script, argn, is_generator));
 				
 				break;
 			}
@@ -1451,34 +1522,64 @@ vobject* ck_executer::exec_bytecode() {
 				if (ck_core::stack_locator::get_stack_remaining() < 4 * 1024 * 1024)
 					throw StackOverflow(L"stack overflow");
 				
-				try {
-					ck_vobject::vobject* result = exec_bytecode();
-					
-					GIL::current_thread()->clear_blocks();
-					
-					// Reached bytecode end
-					if (result)
-						return result;
-					
-					break;
-					
-				} catch(const ck_exceptions::cake& msg) {
-					GIL::current_thread()->clear_blocks();
+				ck_vobject::vobject* result = exec_try_block();
+				
+				// Reached bytecode end
+				if (result)
+					return result;
+				
+				break;
+			}
+			
+			case ck_bytecodes::VSTATE_PUSH_MONITOR: {
+#ifdef DEBUG_OUTPUT
+				wcout << "> VSTATE_PUSH_MONITOR" << endl;
+#endif
 					
-					follow_exception(msg);
-				} catch (const std::exception& ex) {
-					GIL::current_thread()->clear_blocks();
+				// Object stays on the stack while waiting, so it is traced 
+				//  if collection is performed before the monitor is acquired
+				vobject* object = vpeek();
+				if (!object || object->as_type<Undefined>() || object->as_type<Null>())
+					throw TypeError(L"synchronized on undefined");
 					
-					follow_exception(NativeException(ex));
-				} catch (...) {
-					GIL::current_thread()->clear_blocks();
+				// Blocks till monitor is free, thread is marked blocked while waiting
+				Mutex::enter(object);
+				vpop();
 					
-					follow_exception(UnknownException());
-				} 
+				store_try_frame(L"");
+				try_stack.back().try_type = ck_bytecodes::TRY_MONITOR;
+				try_stack.back().monitor  = object;
+				
+				// Limit rest of stack by 4 Mb
+				if (ck_core::stack_locator::get_stack_remaining() < 4 * 1024 * 1024)
+					throw StackOverflow(L"stack overflow");
+				
+				ck_vobject::vobject* result = exec_try_block();
+				
+				// Reached bytecode end
+				if (result)
+					return result;
 				
 				break;
 			}
 			
+			case ck_bytecodes::VSTATE_POP_MONITOR: {
+				if (try_stack.size() == 0 || try_stack.back().try_type != ck_bytecodes::TRY_MONITOR)
+					throw StackCorruption(L"try stack corrupted");
+				
+				// Popping the frame releases monitor
+				int pointer_tmp = pointer;
+				restore_try_frame(try_stack.size() - 1);
+				pointer = pointer_tmp;
+
+#ifdef DEBUG_OUTPUT
+				wcout << "> VSTATE_POP_MONITOR" << endl;
+#endif
+				
+				// Return from containing synchronized
+				return nullptr;
+			}
+			
 			case ck_bytecodes::PUSH_THIS: {
 #ifdef DEBUG_OUTPUT
 				wcout << "> PUSH_THIS" << endl;
@@ -1517,20 +1618,94 @@ vobject* ck_executer::exec_bytecode() {
 				break;
 			}
 			
+			case ck_bytecodes::YIELD: {
+#ifdef DEBUG_OUTPUT
+				wcout << "> YIELD" << endl;
+#endif
+				
+				// Generator frame must be the last call frame
+				if (!generator || generator->frame_id != call_stack.size() - 1)
+					throw IllegalStateError(L"yield outside of generator");
+				
+				vobject* value = vpop();
+				
+				// Save everything pushed by generator body above it's call frame.
+				// Frame itself is popped by resume_generator().
+				stack_frame& base = call_stack.back();
+				generator_frame& frame = generator->frame;
+				
+				frame.objects.assign(objects.begin() + base.object_id + 1, objects.end());
+				frame.scopes.assign(scopes.begin() + base.scope_id + 2, scopes.end());
+				
+				frame.tries.clear();
+				for (int i = base.try_id + 1; i < try_stack.size(); ++i) {
+					stack_frame t = try_stack[i];
+					t.window_id -= base.window_id;
+					t.try_id    -= base.try_id;
+					t.call_id   -= base.call_id;
+					t.script_id -= base.script_id;
+					t.scope_id  -= base.scope_id;
+					t.object_id -= base.object_id;
+					
+					frame.tries.push_back(t);
+				}
+				
+				frame.pointer = pointer;
+				
+				// Unwind try blocks up to resume_generator()
+				yielding = 1;
+				return value ? value : Undefined::instance();
+			}
+			
 			default: throw IllegalStateError(L"invalid bytecode [" + to_wstring(scripts.back()->bytecode.bytemap[pointer-1]) + L"]");
 		}
-		
-		// Respond to GIL requests
+	}
+	
+	return nullptr;
+};
 
-		GIL::instance()->accept_lock();
 
-		// Perform GC collection ?
-		GIL::gc_instance()->collect();
+vobject* ck_executer::exec_try_block(const std::vector<stack_frame>* tries, int level) {
+	try {
+		ck_vobject::vobject* result = tries ? resume_try_frame(*tries, level) : exec_bytecode();
+		
+		GIL::current_thread()->clear_blocks();
+		
+		return result;
+		
+	} catch(const ck_exceptions::cake& msg) {
+		GIL::current_thread()->clear_blocks();
+		
+		follow_exception(msg);
+	} catch (const std::exception& ex) {
+		GIL::current_thread()->clear_blocks();
+		
+		follow_exception(NativeException(ex));
+	} catch (...) {
+		GIL::current_thread()->clear_blocks();
+		
+		follow_exception(UnknownException());
 	}
 	
 	return nullptr;
 };
 
+vobject* ck_executer::resume_try_frame(const std::vector<stack_frame>& tries, int level) {
+	
+	// Innermost block containing yield
+	if (level == tries.size())
+		return exec_bytecode();
+	
+	try_stack.push_back(tries[level]);
+	
+	ck_vobject::vobject* result = exec_try_block(&tries, level + 1);
+	
+	if (result)
+		return result;
+	
+	// Continue enclosing block same as after VSTATE_PUSH_TRY
+	return exec_bytecode();
+};
 
 void ck_executer::execute(ck_core::ck_script* scr, ck_vobject::vscope* scope, std::vector<std::wstring>* argn, std::vector<ck_vobject::vobject*>* argv) {
 	
@@ -1541,10 +1716,8 @@ void ck_executer::execute(ck_core::ck_script* scr, ck_vobject::vscope* scope, st
 	bool own_scope = scope == nullptr;
 	
 	// Apply new scope
-	if (scope == nullptr) {
+	if (scope == nullptr)
 		scope = new iscope();
-		scope->root();
-	}
 	
 	// Overwrite __this to avoid access to the super-parent __this value
 	scope->put(L"__this", Undefined::instance());
@@ -1592,7 +1765,6 @@ ck_vobject::vobject* ck_executer::call_bytecode(ck_core::ck_script* scr, ck_vobj
 	// Construct scope
 	// vscope* scope = nullptr;
 	bool own_scope = 0;
-	bool scope_is_root = scope && scope->gc_is_root();
 	
 	// Pass given scope as proxy to avoid overwritting of __this value.
 	if (!scope && !use_scope_without_wrap) {
@@ -1602,11 +1774,7 @@ ck_vobject::vobject* ck_executer::call_bytecode(ck_core::ck_script* scr, ck_vobj
 			throw StackCorruption(L"scopes stack corrupted");
 		else
 			scope = new iscope(scopes.back());
-	}
 	
-	// Apply root
-	if (!scope_is_root) {
-		scope->root();
 		own_scope = 1;
 	}
 	
@@ -1667,7 +1835,6 @@ ck_vobject::vobject* ck_executer::call_object(ck_vobject::vobject* obj, ck_vobje
 	// Construct scope
 	// vscope* scope = nullptr;
 	bool own_scope = 0;
-	bool scope_is_root = scope && scope->gc_is_root();
 	
 	if (obj->as_type<BytecodeFunction>()) {
 		// Apply new scope
@@ -1679,6 +1846,15 @@ ck_vobject::vobject* ck_executer::call_object(ck_vobject::vobject* obj, ck_vobje
 			
 			// Apply this & args on scope
 			scope = f->apply(ref, args); // XXX: Remove apply and use something else.
+			own_scope = 1;
+		}
+		
+		// Body of generator is executed by Generator.next()
+		if (((BytecodeFunction*) obj)->is_generator()) {
+			if (ref != nullptr)
+				scope->put(L"__this", ref);
+			
+			return new Generator((BytecodeFunction*) obj, scope, name);
 		}
 	} else {
 		// Pass given scope as proxy to avoid overwritting of __this value.
@@ -1689,15 +1865,11 @@ ck_vobject::vobject* ck_executer::call_object(ck_vobject::vobject* obj, ck_vobje
 				throw StackCorruption(L"scopes stack corrupted");
 			else
 				scope = new iscope(scopes.back());
+			
+			own_scope = 1;
 		}
 	}
 	
-	// Apply root
-	if (!scope_is_root) {
-		scope->root();
-		own_scope = 1;
-	}
-	
 	// Apply __this bind
 	if (ref != nullptr)
 		scope->put(L"__this", ref);
@@ -1749,7 +1921,142 @@ ck_vobject::vobject* ck_executer::call_object(ck_vobject::vobject* obj, ck_vobje
 
 	if (!obj && return_non_null)
 		return Undefined::instance();
+	
+	return obj;
+};
+
+bool ck_executer::try_call_object(ck_vobject::vobject*& result, cake& error, ck_vobject::vobject* obj, ck_vobject::vobject* ref, const std::vector<ck_vobject::vobject*>& args, const std::wstring& name, vscope* scope) {
+	
+	// Frame marks executer state before the call
+	store_call_frame(L"<native>", 0);
+	int call_id = call_stack.size() - 1;
+	
+	try {
+		result = call_object(obj, ref, args, name, scope);
+		
+		restore_call_frame(call_id);
+		return 1;
+	} catch (const cake& msg) {
+		error = msg;
+	} catch (const std::exception& ex) {
+		error = NativeException(ex);
+	} catch (...) {
+		error = UnknownException();
+	}
+	
+	// Backtrace points to the failed call
+	if (!error.has_backtrace())
+		error.collect_backtrace();
+	
+	GIL::current_thread()->clear_blocks();
+	restore_call_frame(call_id);
+	
+	result = nullptr;
+	return 0;
+};
 
+vobject* ck_executer::resume_generator(Generator* g, vobject* value, bool& done) {
+	
+	// Limit rest of stack by 4 Mb
+	if (ck_core::stack_locator::get_stack_remaining() < 4 * 1024 * 1024)
+		throw StackOverflow(L"stack overflow");
+	
+	int state = g->state.load(std::memory_order_acquire);
+	
+	if (state == Generator::DONE) {
+		done = 1;
+		return Undefined::instance();
+	}
+	
+	if (state == Generator::RUNNING || !g->state.compare_exchange_strong(state, Generator::RUNNING))
+		throw IllegalStateError(L"Generator is already running");
+	
+	// Push call frame and mark own scope
+	store_call_frame(g->name, 1);
+	
+	// Push scope
+	scopes.push_back(g->scope);
+	
+	// Apply script
+	scripts.push_back(g->function->get_script());
+	
+	// Save expected call id
+	int call_id = call_stack.size() - 1;
+	
+	Generator* previous = generator;
+	generator = g;
+	g->frame_id = call_id;
+	
+	ck_vobject::vobject* obj = nullptr;
+	
+	try {
+		if (state == Generator::CREATED) {
+			// Reset pointer to 0 and start
+			goto_address(0);
+			
+			obj = exec_bytecode();
+		} else {
+			generator_frame& frame = g->frame;
+			stack_frame& base = call_stack.back();
+			
+			// Rebase saved try frames on the new call frame
+			std::vector<stack_frame> tries = frame.tries;
+			for (int i = 0; i < tries.size(); ++i) {
+				tries[i].window_id += base.window_id;
+				tries[i].try_id    += base.try_id;
+				tries[i].call_id   += base.call_id;
+				tries[i].script_id += base.script_id;
+				tries[i].scope_id  += base.scope_id;
+				tries[i].object_id += base.object_id;
+			}
+			
+			objects.insert(objects.end(), frame.objects.begin(), frame.objects.end());
+			scopes.insert(scopes.end(), frame.scopes.begin(), frame.scopes.end());
+			pointer = frame.pointer;
+			
+			frame.objects.clear();
+			frame.scopes.clear();
+			frame.tries.clear();
+			
+			// Result of the suspended yield
+			vpush(value ? value : Undefined::instance());
+			
+			obj = tries.size() ? resume_try_frame(tries, 0) : exec_bytecode();
+		}
+	} catch (...) {
+		// Exception thrown out of generator body finishes it
+		generator = previous;
+		yielding  = 0;
+		g->frame_id = -1;
+		g->state.store(Generator::DONE, std::memory_order_release);
+		
+		throw;
+	}
+	
+	GIL::current_thread()->clear_blocks();
+	
+	generator = previous;
+	g->frame_id = -1;
+	
+	if (yielding) {
+		yielding = 0;
+		done = 0;
+		
+		g->state.store(Generator::SUSPENDED, std::memory_order_release);
+	} else {
+		done = 1;
+		
+		g->frame.objects.clear();
+		g->frame.scopes.clear();
+		g->state.store(Generator::DONE, std::memory_order_release);
+	}
+	
+	// Try to restore frame
+	restore_call_frame(call_id);
+	
+	if (!obj)
+		return Undefined::instance();
+	
 	return obj;
 };
 
@@ -1762,29 +2069,11 @@ void ck_executer::late_call_object(ck_vobject::vobject* obj, ck_vobject::vobject
 	instance.scope = exec_scope;
 	instance.use_scope_without_wrap = use_scope_without_wrap;
 	
-	// Record root ownership
-	if (obj && !obj->gc_is_root()) {
-		obj->gc_make_root();
-		instance.own_obj = 1;
-	} else
-		instance.own_obj = 0;
-	
-	if (ref && !ref->gc_is_root()) {
-		ref->gc_make_root();
-		instance.own_ref = 1;
-	} else
-		instance.own_ref = 0;
-	
-	instance.own_args.resize(args.size());
-	for (int i = 0; i < args.size(); ++i) {	
-		if (args[i] && !args[i]->gc_is_root()) {
-			args[i]->gc_make_root();
-			instance.own_args[i] = 1;
-		} else
-			instance.own_args[i] = 0;
-	}
-	
+	// All values are marked by gc_marker while instance is in the list
 	late_call.push_back(instance);
+	
+	// Executed on the next safepoint
+	thread->request_poll(gil_thread::POLL_LATE_CALL);
 };
 
 void ck_executer::goto_address(int bytecode_address) {
@@ -1848,9 +2137,6 @@ void ck_executer::clear() {
 	for (int i = window_stack.size() - 1; i >= 0; --i) {
 		if (window_stack.back().scope_id >= 0 && window_stack.back().scope_id < scopes.size()) 
 			if (scopes[window_stack.back().scope_id]) {
-				if (window_stack.back().own_scope)
-						scopes[window_stack.back().scope_id]->unroot();
-				
 				scopes[window_stack.back().scope_id] = nullptr;
 			}
 		
@@ -1860,23 +2146,16 @@ void ck_executer::clear() {
 	for (int i = call_stack.size() - 1; i >= 0; --i) {
 		if (call_stack.back().scope_id >= 0 && call_stack.back().scope_id < scopes.size()) 
 			if (scopes[call_stack.back().scope_id]) {
-				if (call_stack.back().own_scope)
-						scopes[call_stack.back().scope_id]->unroot();
-				
 				scopes[call_stack.back().scope_id] = nullptr;
 			}
 		
 		call_stack.pop_back();
 	}
 	
+	release_monitors(0);
 	try_stack.clear();
 	
-	for (int i = scopes.size() - 1; i >= 0; --i) {
-		if (scopes[i])
-			scopes[i]->unroot();
-		
-		scopes.pop_back();
-	}
+	scopes.clear();
 	
 	for (int i = objects.size() - 1; i >= 0; --i) 
 		objects.pop_back();
@@ -2,6 +2,11 @@
 
 #include <cstdlib>
 #include <iostream>
+#include <codecvt>
+#include <locale>
+#include <chrono>
+#include <thread>
+#include <algorithm>
 
 #include "GIL2.h"
 #include "executer.h"
@@ -10,6 +15,7 @@
 #include "translator.h"
 #include "script.h"
 #include "ast.h"
+#include "event_loop.h"
 
 #include "vscope.h"
 #include "objects/Object.h"
@@ -24,8 +30,21 @@
 #include "objects/Cake.h"
 #include "objects/NativeFunction.h"
 #include "objects/Thread.h"
+#include "objects/WeakRef.h"
+#include "objects/WeakMap.h"
+#include "objects/Future.h"
+#include "objects/ThreadPool.h"
+#include "objects/Channel.h"
+#include "objects/Generator.h"
 #include "objects/Native.h"
 #include "objects/File.h"
+#include "objects/IO.h"
+#include "objects/Isolate.h"
+#include "objects/Mutex.h"
+#include "objects/Condition.h"
+#include "objects/RWLock.h"
+#include "objects/AtomicInt.h"
+#include "objects/SharedArray.h"
 
 using namespace std;
 using namespace ck_core;
@@ -155,6 +174,71 @@ static vobject* f_exit(vscope* scope, const vector<vobject*>& args) {
 	return Undefined::instance();
 };
 
+// Parks current thread for args[0] milliseconds.
+// Thread is marked as blocked and does not delay GC and GIL requests.
+static vobject* f_sleep(vscope* scope, const vector<vobject*>& args) {
+	int64_t timeout = args.size() && args[0] ? args[0]->int_value() : 0;
+	if (timeout <= 0)
+		return Undefined::instance();
+	
+	std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+	
+	GIL::instance()->io_block();
+	
+	// Wake up periodically to notice termination
+	while (GIL::current_thread()->is_running()) {
+		int64_t left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+		if (left <= 0)
+			break;
+		
+		std::this_thread::sleep_for(std::chrono::milliseconds(std::min(left, (int64_t) 100)));
+	}
+	
+	GIL::instance()->io_unblock();
+	
+	return Undefined::instance();
+};
+
+// Common part of setTimeout and setInterval.
+// args[0] - callback, args[1] - delay, rest are passed to callback.
+static vobject* set_timer(const vector<vobject*>& args, bool repeat) {
+	if (!args.size() || !args[0] || args[0]->as_type<Undefined>())
+		throw ck_exceptions::IllegalArgumentError(repeat ? L"setInterval expected callback" : L"setTimeout expected callback");
+	
+	int64_t delay = args.size() > 1 && args[1] && !args[1]->as_type<Undefined>() ? args[1]->int_value() : 0;
+	if (repeat && delay <= 0)
+		throw ck_exceptions::IllegalArgumentError(L"setInterval expected positive interval");
+	
+	vector<vobject*> cargs;
+	for (int i = 2; i < args.size(); ++i)
+		cargs.push_back(args[i]);
+	
+	return new Int(event_loop::instance()->set_timer(delay, repeat ? delay : 0, args[0], cargs));
+};
+
+// setTimeout(callback, delay, args...)
+// Calls callback with args on the current thread after delay milliseconds.
+// Returns id of timer.
+static vobject* f_setTimeout(vscope* scope, const vector<vobject*>& args) {
+	return set_timer(args, 0);
+};
+
+// setInterval(callback, interval, args...)
+// Calls callback with args on the current thread each interval milliseconds.
+// Returns id of timer.
+static vobject* f_setInterval(vscope* scope, const vector<vobject*>& args) {
+	return set_timer(args, 1);
+};
+
+// clearTimeout(id), clearInterval(id)
+// Cancels timer, returns false if timer was not found.
+static vobject* f_clearTimeout(vscope* scope, const vector<vobject*>& args) {
+	if (!args.size() || !args[0] || !args[0]->as_type<Int>() || !event_loop::exists())
+		return Bool::instance(0);
+	
+	return Bool::instance(event_loop::instance()->clear_timer(args[0]->int_value()));
+};
+
 // Perform parsing of argument as a code string.
 // args[0] - source string for the code.
 // args[1] - variable names used in the new code function.
@@ -201,7 +285,7 @@ static vobject* f_parse(vscope* scope, const vector<vobject*>& args) {
 	ck_core::ck_script* main_script = new ck_script();
 	main_script->directory = GIL::executer_instance()->get_script()->directory;
 	main_script->filename  = GIL::executer_instance()->get_script()->filename;
-	ck_translator::translate_function(main_script->bytecode.bytemap, main_script->bytecode.lineno_table, n);
+	bool generator = ck_translator::translate_function(main_script->bytecode.bytemap, main_script->bytecode.lineno_table, n);
 	
 	// Free up memory
 	delete n;
@@ -213,7 +297,7 @@ static vobject* f_parse(vscope* scope, const vector<vobject*>& args) {
 			argn.push_back(args[i]->string_value());
 	
 	// Return result
-	return new BytecodeFunction(scope, main_script, argn);
+	return new BytecodeFunction(scope, main_script, argn, generator);
 };
 
 // Performs parsing of input script source and executing it as expression.
@@ -271,10 +355,10 @@ static vobject* f_eval(vscope* scope, const vector<vobject*>& args) {
 		else
 			scope = new ck_vobject::xscope(args[1], scope);
 	
-	// Record if passed scope was the root scope
-	bool scope_was_root = func_scope->gc_is_root();
-	if (!scope_was_root)
-		func_scope->gc_make_root();
+	// Keep scopes alive between evaluated nodes
+	gc_handle_scope handles;
+	handles.add(func_scope);
+	handles.add(scope);
 	
 	// Iterate over all child nodes & execute each node as function, return last non-null value
 	ck_ast::ASTNode* root_node = new ck_ast::ASTNode(0, ck_token::ASTROOT);
@@ -313,8 +397,6 @@ static vobject* f_eval(vscope* scope, const vector<vobject*>& args) {
 			
 		} catch(const ck_exceptions::cake& msg) {
 			// Dispose context
-			if (!scope_was_root)
-				func_scope->gc_make_unroot();
 			root_node->left = nullptr;
 			delete main_script;
 			delete root_node;
@@ -323,8 +405,6 @@ static vobject* f_eval(vscope* scope, const vector<vobject*>& args) {
 			throw msg;
 		} catch (const std::exception& ex) {
 			// Dispose context
-			if (!scope_was_root)
-				func_scope->gc_make_unroot();
 			root_node->left = nullptr;
 			delete main_script;
 			delete root_node;
@@ -333,8 +413,6 @@ static vobject* f_eval(vscope* scope, const vector<vobject*>& args) {
 			throw ck_exceptions::NativeException(ex);
 		} catch (...) {
 			// Dispose context
-			if (!scope_was_root)
-				func_scope->gc_make_unroot();
 			root_node->left = nullptr;
 			delete main_script;
 			delete root_node;
@@ -347,8 +425,6 @@ static vobject* f_eval(vscope* scope, const vector<vobject*>& args) {
 	}
 	
 	// Dispose context
-	if (!scope_was_root)
-		func_scope->gc_make_unroot();
 	root_node->left = nullptr;
 	delete root_node;
 	delete n;
@@ -378,12 +454,98 @@ static vobject* f_gc_getLocksCount(vscope* scope, const vector<vobject*>& args)
 	return new Int(GIL::gc_instance()->locks_count());
 };
 
+// Performs full collection
+static vobject* f_gc_collect(vscope* scope, const vector<vobject*>& args) {
+	GIL::gc_instance()->collect(1);
+	return Undefined::instance();
+};
+
+// Disables automatic collection till GC.resume()
+static vobject* f_gc_pause(vscope* scope, const vector<vobject*>& args) {
+	GIL::gc_instance()->pause();
+	return Undefined::instance();
+};
+
+// Returns false if GC was not paused
+static vobject* f_gc_resume(vscope* scope, const vector<vobject*>& args) {
+	return Bool::instance(GIL::gc_instance()->resume());
+};
+
+static vobject* f_gc_isPaused(vscope* scope, const vector<vobject*>& args) {
+	return Bool::instance(GIL::gc_instance()->is_paused());
+};
+
+// GC.setHeapLimit(bytes), minimal is 8Mb
+static vobject* f_gc_setHeapLimit(vscope* scope, const vector<vobject*>& args) {
+	if (args.size() == 0 || !args[0] || !(args[0]->as_type<Int>() || args[0]->as_type<Double>()))
+		throw ck_exceptions::TypeError(L"GC.setHeapLimit expects heap size in bytes");
+	
+	GC::set_heap_limit(args[0]->int_value());
+	return new Int(GC::MAX_HEAP_SIZE);
+};
+
+static vobject* f_gc_getHeapLimit(vscope* scope, const vector<vobject*>& args) {
+	return new Int(GC::MAX_HEAP_SIZE);
+};
+
+static vobject* f_gc_getCollectThreshold(vscope* scope, const vector<vobject*>& args) {
+	return new Int(GIL::gc_instance()->get_collect_threshold());
+};
+
+// Returns fraction of free memory between used blocks of the heap
+static vobject* f_gc_getFragmentation(vscope* scope, const vector<vobject*>& args) {
+	return new Double(GC::measure_fragmentation());
+};
+
+// Releases free heap pages to the system
+static vobject* f_gc_trim(vscope* scope, const vector<vobject*>& args) {
+	return Bool::instance(GC::release_free_memory());
+};
+
+// GC.dumpHeap(path), writes heap snapshot in JSON format, see heap_snapshot.md
+static vobject* f_gc_dumpHeap(vscope* scope, const vector<vobject*>& args) {
+	if (args.size() == 0 || !args[0])
+		throw ck_exceptions::TypeError(L"GC.dumpHeap expects file path");
+	
+	std::string path = std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>>().to_bytes(args[0]->string_value());
+	return Bool::instance(GIL::gc_instance()->dump_heap(path));
+};
+
+// Returns array of [{ type, count, bytes }] sorted by bytes
+static vobject* f_gc_census(vscope* scope, const vector<vobject*>& args) {
+	vector<gc_census_entry> census = GIL::gc_instance()->census();
+	
+	Array* result = new Array();
+	
+	for (int i = 0; i < census.size(); ++i) {
+		Object* entry = new Object();
+		result->items().push_back(entry);
+		
+		entry->Object::put(L"type",  new String(std::wstring(census[i].type.begin(), census[i].type.end())));
+		entry->Object::put(L"count", new Int(census[i].count));
+		entry->Object::put(L"bytes", new Int(census[i].bytes));
+	}
+	
+	return result;
+};
+
 static vobject* c_gc() {
 	Object* gc_object = new Object();
 	gc_object->Object::put(L"getUsedMemory",  new NativeFunction(f_gc_getUsedMemory));
 	gc_object->Object::put(L"getObjectCount", new NativeFunction(f_gc_getObjectCount));
 	gc_object->Object::put(L"getRootsCount",  new NativeFunction(f_gc_getRootsCount));
 	gc_object->Object::put(L"getLocksCount",  new NativeFunction(f_gc_getLocksCount));
+	gc_object->Object::put(L"collect",        new NativeFunction(f_gc_collect));
+	gc_object->Object::put(L"pause",          new NativeFunction(f_gc_pause));
+	gc_object->Object::put(L"resume",         new NativeFunction(f_gc_resume));
+	gc_object->Object::put(L"isPaused",       new NativeFunction(f_gc_isPaused));
+	gc_object->Object::put(L"setHeapLimit",   new NativeFunction(f_gc_setHeapLimit));
+	gc_object->Object::put(L"getHeapLimit",   new NativeFunction(f_gc_getHeapLimit));
+	gc_object->Object::put(L"getCollectThreshold", new NativeFunction(f_gc_getCollectThreshold));
+	gc_object->Object::put(L"getFragmentation",    new NativeFunction(f_gc_getFragmentation));
+	gc_object->Object::put(L"trim",                new NativeFunction(f_gc_trim));
+	gc_object->Object::put(L"dumpHeap",            new NativeFunction(f_gc_dumpHeap));
+	gc_object->Object::put(L"census",              new NativeFunction(f_gc_census));
 	
 	return gc_object;
 };
@@ -431,11 +593,35 @@ vscope* ck_objects::init_default() {
 	scope->put(L"Array",            Array           ::create_proto());
 	scope->put(L"Cake",             Cake            ::create_proto());
 	scope->put(L"Thread",           Thread          ::create_proto());
+	scope->put(L"WeakRef",          WeakRef         ::create_proto());
+	scope->put(L"WeakMap",          WeakMap         ::create_proto());
+	scope->put(L"Future",           Future          ::create_proto());
+	scope->put(L"ThreadPool",       ThreadPool      ::create_proto());
+	scope->put(L"Channel",          Channel         ::create_proto());
+	scope->put(L"Generator",        Generator       ::create_proto());
 	scope->put(L"Native",           Native          ::create_proto());
 	scope->put(L"File",             File            ::create_proto());
+	scope->put(L"IO",               IO              ::create_proto());
+	scope->put(L"Isolate",          Isolate         ::create_proto());
+	scope->put(L"Mutex",            Mutex           ::create_proto());
+	scope->put(L"Condition",        Condition       ::create_proto());
+	scope->put(L"RWLock",           RWLock          ::create_proto());
+	scope->put(L"AtomicInt",        AtomicInt       ::create_proto());
+	scope->put(L"SharedInt64Array",   SharedArray   ::create_int64_proto());
+	scope->put(L"SharedFloat64Array", SharedArray   ::create_float64_proto());
+	
+	// Builtin prototypes are shared by all threads and read on each method call.
+	// They are frozen to avoid locking, script can call unfreeze() on 
+	//  prototype to patch it before starting threads.
+	for (const wchar_t* proto : { L"Object", L"NativeFunction", L"Function", L"Scope", L"XScope", L"Undefined", L"Null", L"Int", L"Bool", L"Double", L"String", L"Array", L"Cake", L"Thread", L"WeakRef", L"WeakMap", L"Future", L"ThreadPool", L"Channel", L"Generator", L"Native", L"File", L"IO", L"Isolate", L"Mutex", L"Condition", L"RWLock", L"AtomicInt", L"SharedInt64Array", L"SharedFloat64Array" }) {
+		vobject* o = scope->get(proto);
+		if (o && o->as_type<Object>())
+			static_cast<Object*>(o)->freeze();
+	}
 	
 	// O B J E C T S
 	scope->put(L"GC", c_gc());
+	scope->put(L"Atomics", SharedArray::create_atomics());
 	// O B J E C T S
 	scope->put(L"Platform", c_platform());
 	
@@ -448,6 +634,13 @@ vscope* ck_objects::init_default() {
 	
 	// P R O C E S S
 	scope->put(L"exit",    new NativeFunction(f_exit));
+	scope->put(L"sleep",   new NativeFunction(f_sleep));
+	
+	// T I M E R S
+	scope->put(L"setTimeout",    new NativeFunction(f_setTimeout));
+	scope->put(L"setInterval",   new NativeFunction(f_setInterval));
+	scope->put(L"clearTimeout",  new NativeFunction(f_clearTimeout));
+	scope->put(L"clearInterval", new NativeFunction(f_clearTimeout));
 	
 	// P A R S E
 	scope->put(L"parse",   new NativeFunction(f_parse));
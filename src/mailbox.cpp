@@ -0,0 +1,88 @@
+#include "mailbox.h"
+
+#include <chrono>
+
+#include "GIL2.h"
+#include "vobject.h"
+
+using namespace std;
+using namespace ck_core;
+
+
+mailbox::~mailbox() {
+	close();
+};
+
+bool mailbox::post(mail_item* item) {
+	if (closed.load(std::memory_order_acquire))
+		return 0;
+	
+	mail_item* top = head.load(std::memory_order_relaxed);
+	do
+		item->next = top;
+	while (!head.compare_exchange_weak(top, item, std::memory_order_seq_cst, std::memory_order_relaxed));
+	
+	// Owner checks for items after raising waiting, so either it sees the 
+	//  item or this thread sees it waiting
+	if (waiting.load()) {
+		std::unique_lock<std::mutex> lk(wait_mutex);
+		wait_var.notify_one();
+	}
+	
+	return 1;
+};
+
+mail_item* mailbox::take() {
+	if (empty())
+		return nullptr;
+	
+	return head.exchange(nullptr, std::memory_order_acquire);
+};
+
+void mailbox::wait(int64_t timeout) {
+	gil_thread* thread = GIL::current_thread();
+	
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout < 0 ? 0 : timeout);
+	
+	std::unique_lock<std::mutex> lk(wait_mutex);
+	waiting = 1;
+	
+	while (head.load() == nullptr && !closed && thread->is_running()) {
+		// Wait in short periods to respond to thread stop
+		auto until = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+		
+		if (timeout >= 0) {
+			if (std::chrono::steady_clock::now() >= deadline)
+				break;
+			if (deadline < until)
+				until = deadline;
+		}
+		
+		wait_var.wait_until(lk, until);
+	}
+	
+	waiting = 0;
+};
+
+void mailbox::close() {
+	closed = 1;
+	
+	mail_item* item = head.exchange(nullptr, std::memory_order_acquire);
+	while (item) {
+		mail_item* next = item->next;
+		delete item;
+		item = next;
+	}
+	
+	std::unique_lock<std::mutex> lk(wait_mutex);
+	wait_var.notify_all();
+};
+
+void mailbox::gc_trace(gc_visitor& visitor) {
+	for (mail_item* item = head.load(std::memory_order_acquire); item; item = item->next) {
+		visitor.visit(item->obj);
+		
+		for (int i = 0; i < item->args.size(); ++i)
+			visitor.visit(item->args[i]);
+	}
+};
@@ -14,6 +14,7 @@
 #include "exit_listener.h"
 #include "ck_args.h"
 #include "stack_locator.h"
+#include "event_loop.h"
 
 #include "ASTPrinter.h"
 
@@ -26,6 +27,7 @@
 #include "objects/Null.h"
 #include "objects/Array.h"
 #include "objects/String.h"
+#include "objects/ThreadPool.h"
 
 using namespace std;
 using namespace ck_token;
@@ -55,6 +57,7 @@ using namespace ck_objects;
 // Optional build flags: 
 // -DCK_SINGLETHREAD - disable multithreading feature, disable locks / unlocks, block queue, 
 //  GIL2 synchronization and runs in a single thread.
+//  Without this flag interpreter still skips synchronization till the first Thread is spawned.
 // -DDEBUG_OUTPUT - enables debug oytput of parsed AST, bytecode with captions and line 
 //  numbers table.
 
@@ -296,6 +299,12 @@ void wrap_main(int argc, void** argv) {
 				GIL::executer_instance()->execute(main_script, root_scope);
 				GIL::executer_instance()->restore_all();
 				GIL::current_thread()->clear_blocks();
+				
+				// Deliver asynchronous I/O started by script
+				if (event_loop::exists()) {
+					event_loop::instance()->run();
+					GIL::executer_instance()->restore_all();
+				}
 			
 				// Finish execution loop on success
 				break;
@@ -305,6 +314,10 @@ void wrap_main(int argc, void** argv) {
 				GIL::executer_instance()->restore_all();
 				exception_processing = 0;
 				
+				// Write heap snapshot requested by allocator before OutOfMemory
+				if (GIL::gc_instance()->dump_pending())
+					GIL::gc_instance()->dump_pending_heap();
+				
 				// On cake caught, call stack, windows stack and try stack are empty.
 				// Process cake by calling handler-function.
 				// __defcakehandler(exception)
@@ -394,7 +407,7 @@ void wrap_main(int argc, void** argv) {
 			
 			bool universe_is_dead = 1;
 			for (int i = 1; i < GIL::instance()->get_threads().size() && universe_is_dead; ++i) // loop from 1 because main thread index is 0
-				if (GIL::instance()->get_threads()[i]->is_running()) {
+				if (GIL::instance()->get_threads()[i]->is_running() && !GIL::instance()->get_threads()[i]->is_daemon()) {
 					universe_is_dead = 0;
 					break;
 				}
@@ -496,6 +509,12 @@ void wrap_main(int argc, void** argv) {
 	
 	// W A I T _ F O R _ T E R M I N A T E
 	
+	// Stop daemon workers, queued tasks are dropped
+	ck_objects::ThreadPool::shutdown_all();
+	
+	// Stop I/O reactor, pending requests are dropped
+	event_loop::shutdown();
+	
 	// Main thread locks the GIL
 	GIL::instance()->lock();
 	
@@ -511,7 +530,7 @@ void wrap_main(int argc, void** argv) {
 		
 		bool universe_is_dead = 1;
 		for (int i = 1; i < GIL::instance()->get_threads().size() && universe_is_dead; ++i) // loop from 1 because main thread index is 0
-			if (!GIL::instance()->get_threads()[i]->is_running()) {
+			if (!GIL::instance()->get_threads()[i]->is_running() || GIL::instance()->get_threads()[i]->is_daemon()) {
 				universe_is_dead = 0;
 				break;
 			}
@@ -522,6 +541,28 @@ void wrap_main(int argc, void** argv) {
 	GIL::instance()->unlock();
 }
 
+// Parses size with optional suffix K, M, G (Kb, Mb, Gb), case-insensitive.
+// Throws on invalid input.
+static int64_t parse_size(const std::wstring& value) {
+	size_t end = 0;
+	int64_t size = std::stoll(value, &end);
+	
+	std::wstring suffix = value.substr(end);
+	if (suffix.size() == 2 && (suffix[1] == L'b' || suffix[1] == L'B'))
+		suffix.pop_back();
+	
+	if (suffix.size() == 0)
+		return size;
+	if (suffix == L"k" || suffix == L"K")
+		return size * 1024;
+	if (suffix == L"m" || suffix == L"M")
+		return size * 1024 * 1024;
+	if (suffix == L"g" || suffix == L"G")
+		return size * 1024 * 1024 * 1024;
+	
+	throw std::invalid_argument("invalid size suffix");
+};
+
 int main(int argc, const char** argv, const char** envp) {
 	
 	// S E T _ U P _ L O C A L E S
@@ -566,7 +607,16 @@ int main(int argc, const char** argv, const char** envp) {
 		std::wcout << "--CK::STACK_SIZE=<size> Specify new stack size in bytes (> 8Mb)" << std::endl;
 		std::wcout << "--CK::THREAD_STACK_SIZE=<size> Specify new stack size for threads in bytes (> 8Mb)" << std::endl;
 		std::wcout << "--CK::MAX_HEAP_SIZE=<size> Limit heap size per current process, default is 512Mb, minimal is 8Mb" << std::endl;
+		std::wcout << "--CK::heap-max=<size> Same as MAX_HEAP_SIZE, accepts K, M, G suffixes (--CK::heap-max=4G)" << std::endl;
 		std::wcout << "--CK::MIN_GC_INTERVAL=<amount> Minimal amount of objects to be created before gc call, default is 64" << std::endl;
+		std::wcout << "--CK::gc-interval=<amount> Same as MIN_GC_INTERVAL" << std::endl;
+		std::wcout << "--CK::gc-min-trigger=<size> Minimal heap size that triggers collection, default is 4Mb" << std::endl;
+		std::wcout << "--CK::gc-growth-min=<factor> Minimal heap growth between collections, default is 1.5" << std::endl;
+		std::wcout << "--CK::gc-growth-max=<factor> Maximal heap growth between collections, default is 4.0" << std::endl;
+		std::wcout << "--CK::gc-time-ratio=<fraction> Target fraction of time spent in marking, default is 0.05" << std::endl;
+		std::wcout << "--CK::gc-emergency-ratio=<fraction> Fraction of heap limit that forces collection even when GC is paused, default is 0.9" << std::endl;
+		std::wcout << "--CK::gc-trim-ratio=<fraction> Heap fragmentation that makes GC release free pages to the system, default is 0.25, 0 to disable" << std::endl;
+		std::wcout << "--CK::heap-dump-on-oom=<path> Write heap snapshot to the given file when heap limit is reached" << std::endl;
 		std::wcout << "--CK::PRINT_BYTECODE Debug output bytecode" << std::endl;
 		std::wcout << "--CK::PRINT_AST Debug output AST for input script" << std::endl;
 		std::wcout << std::endl;
@@ -598,14 +648,19 @@ int main(int argc, const char** argv, const char** envp) {
 	
 	if (ck_core::ck_args::has_option(L"MAX_HEAP_SIZE")) try { 
 		// Check for valid integer
-		int new_heap_size = std::stol(ck_core::ck_args::get_option(L"MAX_HEAP_SIZE"));
-		
-		GC::MAX_HEAP_SIZE = new_heap_size < 8 * 1024 * 1024 ? 8 * 1024 * 1024 : new_heap_size;
+		GC::set_heap_limit(parse_size(ck_core::ck_args::get_option(L"MAX_HEAP_SIZE")));
 	} catch (...) {
 		std::wcout << "Invalid value for option --CK::MAX_HEAP_SIZE (" << ck_core::ck_args::get_option(L"MAX_HEAP_SIZE") << std::endl;
 		return 0;
 	}
 	
+	if (ck_core::ck_args::has_option(L"heap-max")) try { 
+		GC::set_heap_limit(parse_size(ck_core::ck_args::get_option(L"heap-max")));
+	} catch (...) {
+		std::wcout << "Invalid value for option --CK::heap-max (" << ck_core::ck_args::get_option(L"heap-max") << std::endl;
+		return 0;
+	}
+	
 	if (ck_core::ck_args::has_option(L"MIN_GC_INTERVAL")) try { 
 		// Check for valid integer
 		int new_gc_interval = std::stoi(ck_core::ck_args::get_option(L"MIN_GC_INTERVAL"));
@@ -616,6 +671,70 @@ int main(int argc, const char** argv, const char** envp) {
 		return 0;
 	}
 	
+	if (ck_core::ck_args::has_option(L"gc-interval")) try { 
+		int new_gc_interval = std::stoi(ck_core::ck_args::get_option(L"gc-interval"));
+		
+		GC::MIN_GC_INTERVAL = new_gc_interval < 0 ? 0 : new_gc_interval;
+	} catch (...) {
+		std::wcout << "Invalid value for option --CK::gc-interval (" << ck_core::ck_args::get_option(L"gc-interval") << std::endl;
+		return 0;
+	}
+	
+	if (ck_core::ck_args::has_option(L"gc-min-trigger")) try { 
+		GC::set_min_heap_trigger(parse_size(ck_core::ck_args::get_option(L"gc-min-trigger")));
+	} catch (...) {
+		std::wcout << "Invalid value for option --CK::gc-min-trigger (" << ck_core::ck_args::get_option(L"gc-min-trigger") << std::endl;
+		return 0;
+	}
+	
+	if (ck_core::ck_args::has_option(L"gc-growth-min")) try { 
+		double growth = std::stod(ck_core::ck_args::get_option(L"gc-growth-min"));
+		
+		GC::MIN_HEAP_GROWTH = growth < 1.0 ? 1.0 : growth;
+	} catch (...) {
+		std::wcout << "Invalid value for option --CK::gc-growth-min (" << ck_core::ck_args::get_option(L"gc-growth-min") << std::endl;
+		return 0;
+	}
+	
+	if (ck_core::ck_args::has_option(L"gc-growth-max")) try { 
+		double growth = std::stod(ck_core::ck_args::get_option(L"gc-growth-max"));
+		
+		GC::MAX_HEAP_GROWTH = growth < GC::MIN_HEAP_GROWTH ? GC::MIN_HEAP_GROWTH : growth;
+	} catch (...) {
+		std::wcout << "Invalid value for option --CK::gc-growth-max (" << ck_core::ck_args::get_option(L"gc-growth-max") << std::endl;
+		return 0;
+	}
+	
+	if (ck_core::ck_args::has_option(L"gc-time-ratio")) try { 
+		double ratio = std::stod(ck_core::ck_args::get_option(L"gc-time-ratio"));
+		
+		GC::GC_TIME_RATIO = ratio < 0.0 ? 0.0 : ratio;
+	} catch (...) {
+		std::wcout << "Invalid value for option --CK::gc-time-ratio (" << ck_core::ck_args::get_option(L"gc-time-ratio") << std::endl;
+		return 0;
+	}
+	
+	if (ck_core::ck_args::has_option(L"gc-emergency-ratio")) try { 
+		double ratio = std::stod(ck_core::ck_args::get_option(L"gc-emergency-ratio"));
+		
+		GC::EMERGENCY_RATIO = ratio < 0.1 ? 0.1 : ratio > 1.0 ? 1.0 : ratio;
+	} catch (...) {
+		std::wcout << "Invalid value for option --CK::gc-emergency-ratio (" << ck_core::ck_args::get_option(L"gc-emergency-ratio") << std::endl;
+		return 0;
+	}
+	
+	if (ck_core::ck_args::has_option(L"gc-trim-ratio")) try { 
+		double ratio = std::stod(ck_core::ck_args::get_option(L"gc-trim-ratio"));
+		
+		GC::TRIM_RATIO = ratio < 0.0 ? 0.0 : ratio;
+	} catch (...) {
+		std::wcout << "Invalid value for option --CK::gc-trim-ratio (" << ck_core::ck_args::get_option(L"gc-trim-ratio") << std::endl;
+		return 0;
+	}
+	
+	if (ck_core::ck_args::has_option(L"heap-dump-on-oom"))
+		GC::HEAP_DUMP_ON_OOM = std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>>().to_bytes(ck_core::ck_args::get_option(L"heap-dump-on-oom"));
+	
 	// P A R S E _ I N P U T
 	
 	// Process filename
@@ -0,0 +1,92 @@
+#include "monitor.h"
+
+using namespace std;
+using namespace ck_core;
+
+
+bool monitor::lock(int64_t timeout) {
+	gil_thread* self = GIL::current_thread();
+	
+	std::unique_lock<std::mutex> lk(mutex);
+	
+	if (owner == self) {
+		++count;
+		return 1;
+	}
+	
+	if (!owner) {
+		owner = self;
+		count = 1;
+		return 1;
+	}
+	
+	if (!timeout)
+		return 0;
+	
+	// Allow other threads to perform stop-the-world while waiting
+	GIL::instance()->io_block();
+	
+	bool acquired = wait_blocked(lk, released, timeout, [this]() -> bool {
+		return !owner;
+	});
+	
+	if (acquired) {
+		owner = self;
+		count = 1;
+	}
+	
+	// Accepting GIL lock may block, so mutex is released before
+	lk.unlock();
+	GIL::instance()->io_unblock();
+	
+	return acquired;
+};
+
+bool monitor::unlock() {
+	std::unique_lock<std::mutex> lk(mutex);
+	
+	if (owner != GIL::current_thread())
+		return 0;
+	
+	if (--count == 0) {
+		owner = nullptr;
+		released.notify_one();
+	}
+	
+	return 1;
+};
+
+int monitor::unlock_all() {
+	std::unique_lock<std::mutex> lk(mutex);
+	
+	if (owner != GIL::current_thread())
+		return 0;
+	
+	int depth = count;
+	
+	owner = nullptr;
+	count = 0;
+	released.notify_one();
+	
+	return depth;
+};
+
+bool monitor::relock(int depth) {
+	if (!lock())
+		return 0;
+	
+	std::unique_lock<std::mutex> lk(mutex);
+	count = depth;
+	
+	return 1;
+};
+
+bool monitor::is_locked() {
+	std::unique_lock<std::mutex> lk(mutex);
+	return owner != nullptr;
+};
+
+bool monitor::is_owned() {
+	std::unique_lock<std::mutex> lk(mutex);
+	return owner == GIL::current_thread();
+};
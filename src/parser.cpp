@@ -47,6 +47,8 @@ std::wstring ck_parser::token_to_string(int token) {
 		 case TYPEOF        : return L"typeof";
 		 case ISTYPEOF      : return L"istypeof";
 		 case AS            : return L"as";
+		 case YIELD         : return L"yield";
+		 case SYNCHRONIZED  : return L"synchronized";
 		 case ASSIGN        : return L"=";
 		 case HOOK          : return L"?";
 		 case COLON         : return L":";
@@ -370,6 +372,10 @@ int tokenizer::next_token() {
 			return put(ISTYPEOF);
 		if (svref == L"in")
 			return put(IN);
+		if (svref == L"yield")
+			return put(YIELD);
+		if (svref == L"synchronized")
+			return put(SYNCHRONIZED);
 
 		return put(NAME);
 	}
@@ -1250,6 +1256,38 @@ ASTNode *parser::unary_expression() {
 		expr->addChild(exp);
 		
 		return expr;						
+	} else if (match(YIELD)) {
+		// yield EXP | yield
+		
+		ASTNode *expr = new ASTNode(get(-1)->lineno, YIELD);
+		
+		// Value can be omitted
+		if (peekStatementWithoutSemicolon()
+			||
+			get(0)->token == SEMICOLON
+			||
+			get(0)->token == RP
+			||
+			get(0)->token == RB
+			||
+			get(0)->token == RC
+			||
+			get(0)->token == COMMA
+			||
+			get(0)->token == COLON
+			||
+			get(0)->token == TEOF)
+			return expr;
+		
+		ASTNode *exp = expression();
+		if (checkNullExpression(exp)) {
+			delete expr;
+			return NULL;
+		}
+		
+		expr->addChild(exp);
+		
+		return expr;
 	} else if (match(INC) || match(DEC)) {
 		// ++ EXP
 		
@@ -1915,6 +1953,8 @@ bool parser::peekStatementWithoutSemicolon() {
 			||
 			get(0)->token == TRY
 			||
+			get(0)->token == SYNCHRONIZED
+			||
 			get(0)->token == VAR
 			||
 			get(0)->token == SAFE
@@ -2377,6 +2417,43 @@ ASTNode *parser::statement_with_semicolons() {
 		return tryexpect;
 	}
 	
+	else if (match(SYNCHRONIZED)) {
+		// FRAME:
+		// monitor object
+		// BODY node
+		
+		ASTNode *sync = new ASTNode(get(-1)->lineno, SYNCHRONIZED);
+		
+		if (!match(LP)) {
+			delete sync;
+			PARSER_ERROR_RETURN(L"Expected (", get(0)->lineno, get(0)->charno);
+		}
+		
+		// Check for NULL expressin and ommit memory leak
+		ASTNode *object = checkNotNullExpression();
+		if (error_) {
+			delete sync;
+			return NULL;
+		}
+		
+		sync->addChild(object);
+		
+		if (!match(RP)) {
+			delete sync;
+			PARSER_ERROR_RETURN(L"Expected )", get(0)->lineno, get(0)->charno);
+		}
+		
+		ASTNode *bodynode = statement();
+		if (!bodynode) {
+			delete sync;
+			return NULL;
+		}
+		
+		sync->addChild(bodynode);
+		
+		return sync;
+	}
+	
 	else
 		return initializerstatement();
 };
@@ -1,5 +1,115 @@
 #include "stack_locator.h"
 
+#include <map>
+#include <mutex>
+
 #include "ck_platform.h"
 
-thread_local std::vector<ck_core::stack_locator::stack_descriptor> ck_core::stack_locator::descriptors;
\ No newline at end of file
+#ifdef POSIX
+	#include <sys/mman.h>
+	#include <unistd.h>
+#endif
+
+thread_local std::vector<ck_core::stack_locator::stack_descriptor> ck_core::stack_locator::descriptors;
+
+using namespace ck_core::stack_locator;
+
+
+// Released stacks mapped by their size
+static std::mutex pool_mutex;
+static std::multimap<type_int, stack_descriptor> stack_pool;
+
+// Top part of pooled stack that keeps it's pages
+static const size_t hot_size = 256 * 1024;
+
+static size_t page_size() {
+#ifdef POSIX
+	static size_t size = (size_t) sysconf(_SC_PAGESIZE);
+	return size;
+#else
+	return 4096;
+#endif
+};
+
+bool ck_core::stack_locator::allocate_stack(stack_descriptor& descriptor, size_t stack_size) {
+	size_t page = page_size();
+	stack_size  = (stack_size + page - 1) / page * page;
+	
+	{
+		std::unique_lock<std::mutex> lk(pool_mutex);
+		
+		auto it = stack_pool.find((type_int) stack_size);
+		if (it != stack_pool.end()) {
+			descriptor.new_stack = it->second.new_stack;
+			descriptor.new_size  = it->second.new_size;
+			descriptor.map_size  = it->second.map_size;
+			
+			stack_pool.erase(it);
+			return 1;
+		}
+	}
+
+#ifdef POSIX
+	size_t map_size = stack_size + guard_size;
+	
+	// Reserve address space only, pages are committed on first touch
+	void* map = mmap(nullptr, map_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (map == MAP_FAILED)
+		return 0;
+	
+	// Stack grows down, so guard area is left at the bottom
+	if (mprotect((char*) map + guard_size, stack_size, PROT_READ | PROT_WRITE)) {
+		munmap(map, map_size);
+		return 0;
+	}
+	
+	descriptor.new_stack = (type_int) (uintptr_t) map + guard_size;
+	descriptor.new_size  = stack_size;
+	descriptor.map_size  = map_size;
+#else
+	void* map = malloc(stack_size);
+	if (!map)
+		return 0;
+	
+	descriptor.new_stack = (type_int) (uintptr_t) map;
+	descriptor.new_size  = stack_size;
+	descriptor.map_size  = stack_size;
+#endif
+	
+	return 1;
+};
+
+void ck_core::stack_locator::release_stack(const stack_descriptor& descriptor) {
+	// Size before alignment of stack top
+#ifdef POSIX
+	type_int stack_size = descriptor.map_size - guard_size;
+#else
+	type_int stack_size = descriptor.map_size;
+#endif
+	
+	stack_descriptor pooled;
+	pooled.new_stack = descriptor.new_stack;
+	pooled.new_size  = stack_size;
+	pooled.map_size  = descriptor.map_size;
+	
+	{
+		std::unique_lock<std::mutex> lk(pool_mutex);
+		
+		if (stack_pool.size() < pool_limit) {
+#ifdef POSIX
+			// Drop pages touched by deep recursion, keep the top
+			if (stack_size > hot_size)
+				madvise((void*) (uintptr_t) pooled.new_stack, stack_size - hot_size, MADV_DONTNEED);
+#endif
+			
+			stack_pool.emplace(stack_size, pooled);
+			return;
+		}
+	}
+
+#ifdef POSIX
+	munmap((void*) (uintptr_t) (pooled.new_stack - guard_size), pooled.map_size);
+#else
+	free((void*) (uintptr_t) pooled.new_stack);
+#endif
+};
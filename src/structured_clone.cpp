@@ -0,0 +1,277 @@
+#include "structured_clone.h"
+
+#include <map>
+#include <vector>
+#include <cstring>
+#include <locale>
+#include <codecvt>
+#include <typeinfo>
+
+#include "exceptions.h"
+
+#include "objects/Object.h"
+#include "objects/Array.h"
+#include "objects/Int.h"
+#include "objects/Double.h"
+#include "objects/Bool.h"
+#include "objects/String.h"
+#include "objects/Null.h"
+#include "objects/Undefined.h"
+
+using namespace std;
+using namespace ck_exceptions;
+using namespace ck_vobject;
+using namespace ck_objects;
+using namespace ck_core;
+
+
+// Value tags of encoded stream
+enum clone_tag : char {
+	TAG_UNDEFINED = 'U',
+	TAG_NULL      = 'N',
+	TAG_TRUE      = 'T',
+	TAG_FALSE     = 'F',
+	TAG_INT       = 'I',
+	TAG_DOUBLE    = 'D',
+	TAG_STRING    = 'S',
+	TAG_ARRAY     = 'A',
+	TAG_OBJECT    = 'O',
+	// Reference to already encoded Array or Object by it's index
+	TAG_REF       = 'R'
+};
+
+namespace {
+	
+	class writer {
+		
+		std::string& out;
+		
+		// Encoded containers and their indices
+		std::map<vobject*, uint32_t> seen;
+		
+		void put_u32(uint32_t value) {
+			char bytes[4];
+			for (int i = 0; i < 4; ++i)
+				bytes[i] = (value >> (8 * i)) & 0xFF;
+			out.append(bytes, 4);
+		};
+		
+		void put_u64(uint64_t value) {
+			char bytes[8];
+			for (int i = 0; i < 8; ++i)
+				bytes[i] = (value >> (8 * i)) & 0xFF;
+			out.append(bytes, 8);
+		};
+		
+		void put_string(const std::wstring& value) {
+			std::string bytes = std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>>().to_bytes(value);
+			put_u32(bytes.size());
+			out += bytes;
+		};
+		
+		// Returns 1 if container was already encoded and reference was written
+		bool put_ref(vobject* value) {
+			auto it = seen.find(value);
+			if (it != seen.end()) {
+				out += TAG_REF;
+				put_u32(it->second);
+				return 1;
+			}
+			
+			uint32_t index = seen.size();
+			seen[value] = index;
+			return 0;
+		};
+		
+	public:
+		
+		writer(std::string& out) : out(out) {};
+		
+		void put(vobject* value) {
+			if (!value || value->as_type<Undefined>()) {
+				out += TAG_UNDEFINED;
+			} else if (value->as_type<Null>()) {
+				out += TAG_NULL;
+			} else if (value->as_type<Bool>()) {
+				out += value->int_value() ? TAG_TRUE : TAG_FALSE;
+			} else if (value->as_type<Int>()) {
+				out += TAG_INT;
+				put_u64(static_cast<Int*>(value)->value());
+			} else if (value->as_type<Double>()) {
+				double number = static_cast<Double*>(value)->value();
+				uint64_t bits;
+				memcpy(&bits, &number, sizeof(bits));
+				
+				out += TAG_DOUBLE;
+				put_u64(bits);
+			} else if (value->as_type<String>()) {
+				out += TAG_STRING;
+				put_string(static_cast<String*>(value)->value());
+			} else if (value->as_type<Array>()) {
+				if (put_ref(value))
+					return;
+				
+				// Copy items to avoid holding lock of this array while locking nested values
+				std::vector<vobject*> items;
+				{
+					vsobject::vslock lk(static_cast<Array*>(value));
+					items = static_cast<Array*>(value)->items();
+				}
+				
+				out += TAG_ARRAY;
+				put_u32(items.size());
+				for (vobject* item : items)
+					put(item);
+			} else if (typeid(*value) == typeid(Object)) {
+				if (put_ref(value))
+					return;
+				
+				std::vector<std::pair<std::wstring, vobject*>> fields;
+				{
+					Object* object = static_cast<Object*>(value);
+					vsobject::vslock lk(object);
+					for (const std::wstring& key : object->keys())
+						fields.push_back({ key, object->Object::get(key) });
+				}
+				
+				out += TAG_OBJECT;
+				put_u32(fields.size());
+				for (const auto& field : fields) {
+					put_string(field.first);
+					put(field.second);
+				}
+			} else
+				throw TypeError(L"can not clone " + value->string_value());
+		};
+	};
+	
+	class reader {
+		
+		const std::string& in;
+		size_t position = 0;
+		
+		// Decoded containers in order of appearance
+		std::vector<vobject*> seen;
+		
+		void need(size_t amount) {
+			if (in.size() - position < amount)
+				throw TypeError(L"malformed cloned value");
+		};
+		
+		uint32_t get_u32() {
+			need(4);
+			uint32_t value = 0;
+			for (int i = 0; i < 4; ++i)
+				value |= (uint32_t) (unsigned char) in[position++] << (8 * i);
+			return value;
+		};
+		
+		uint64_t get_u64() {
+			need(8);
+			uint64_t value = 0;
+			for (int i = 0; i < 8; ++i)
+				value |= (uint64_t) (unsigned char) in[position++] << (8 * i);
+			return value;
+		};
+		
+		std::wstring get_string() {
+			uint32_t size = get_u32();
+			need(size);
+			
+			std::string bytes = in.substr(position, size);
+			position += size;
+			
+			return std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>>().from_bytes(bytes);
+		};
+		
+	public:
+		
+		reader(const std::string& in) : in(in) {};
+		
+		vobject* get() {
+			need(1);
+			char tag = in[position++];
+			
+			switch (tag) {
+				case TAG_UNDEFINED:
+					return Undefined::instance();
+				
+				case TAG_NULL:
+					return Null::instance();
+				
+				case TAG_TRUE:
+					return Bool::True();
+				
+				case TAG_FALSE:
+					return Bool::False();
+				
+				case TAG_INT:
+					return new Int((int64_t) get_u64());
+				
+				case TAG_DOUBLE: {
+					uint64_t bits = get_u64();
+					double number;
+					memcpy(&number, &bits, sizeof(number));
+					return new Double(number);
+				}
+				
+				case TAG_STRING:
+					return new String(get_string());
+				
+				case TAG_ARRAY: {
+					uint32_t size = get_u32();
+					
+					Array* array = new Array();
+					seen.push_back(array);
+					
+					for (uint32_t i = 0; i < size; ++i)
+						array->items().push_back(get());
+					
+					return array;
+				}
+				
+				case TAG_OBJECT: {
+					uint32_t size = get_u32();
+					
+					Object* object = new Object();
+					seen.push_back(object);
+					
+					for (uint32_t i = 0; i < size; ++i) {
+						std::wstring key = get_string();
+						object->Object::put(key, get());
+					}
+					
+					return object;
+				}
+				
+				case TAG_REF: {
+					uint32_t index = get_u32();
+					if (index >= seen.size())
+						throw TypeError(L"malformed cloned value");
+					return seen[index];
+				}
+				
+				default:
+					throw TypeError(L"malformed cloned value");
+			}
+		};
+		
+		inline bool finished() { return position == in.size(); };
+	};
+};
+
+std::string structured_clone::serialize(vobject* value) {
+	std::string out;
+	writer(out).put(value);
+	return out;
+};
+
+vobject* structured_clone::deserialize(const std::string& data) {
+	reader in(data);
+	vobject* value = in.get();
+	
+	if (!in.finished())
+		throw TypeError(L"malformed cloned value");
+	
+	return value;
+};
@@ -0,0 +1,130 @@
+#include "timer_wheel.h"
+
+using namespace std;
+using namespace ck_core;
+
+
+void timer_wheel::insert(timer_entry* entry) {
+	uint64_t deadline = entry->deadline;
+	if (deadline <= current)
+		deadline = current + 1;
+	
+	uint64_t delta = deadline - current;
+	
+	int level = 0;
+	while (level < LEVELS - 1 && delta >= ((uint64_t) 1 << (LEVEL_BITS * (level + 1))))
+		++level;
+	
+	// Timers out of range are placed in the furthest slot of the last level
+	//  and are cascaded again when it is reached.
+	uint64_t range = (uint64_t) 1 << (LEVEL_BITS * LEVELS);
+	if (delta >= range)
+		deadline = current + range - 1;
+	
+	int index = (deadline >> (LEVEL_BITS * level)) & (SLOTS - 1);
+	
+	timer_entry** slot = &slots[level][index];
+	entry->slot = slot;
+	entry->prev = nullptr;
+	entry->next = *slot;
+	if (*slot)
+		(*slot)->prev = entry;
+	*slot = entry;
+	
+	++count;
+};
+
+void timer_wheel::remove(timer_entry* entry) {
+	if (!entry->slot)
+		return;
+	
+	if (entry->prev)
+		entry->prev->next = entry->next;
+	else
+		*entry->slot = entry->next;
+	
+	if (entry->next)
+		entry->next->prev = entry->prev;
+	
+	entry->slot = nullptr;
+	entry->prev = nullptr;
+	entry->next = nullptr;
+	
+	--count;
+};
+
+void timer_wheel::cascade(int level, int index) {
+	timer_entry* entry = slots[level][index];
+	slots[level][index] = nullptr;
+	
+	while (entry) {
+		timer_entry* next = entry->next;
+		
+		entry->slot = nullptr;
+		--count;
+		insert(entry);
+		
+		entry = next;
+	}
+};
+
+void timer_wheel::advance(uint64_t now, vector<timer_entry*>& expired) {
+	// Nothing to process, jump straight to now
+	if (!count) {
+		if (now > current)
+			current = now;
+		return;
+	}
+	
+	while (current < now) {
+		++current;
+		
+		// Lower level finished it's round, move timers of upper level slot down
+		for (int level = 1; level < LEVELS; ++level) {
+			if (current & (((uint64_t) 1 << (LEVEL_BITS * level)) - 1))
+				break;
+			
+			cascade(level, (current >> (LEVEL_BITS * level)) & (SLOTS - 1));
+		}
+		
+		timer_entry** slot = &slots[0][current & (SLOTS - 1)];
+		while (*slot) {
+			timer_entry* entry = *slot;
+			remove(entry);
+			expired.push_back(entry);
+		}
+		
+		if (!count) {
+			current = now;
+			break;
+		}
+	}
+};
+
+int64_t timer_wheel::next_timeout() {
+	if (!count)
+		return -1;
+	
+	int64_t timeout = -1;
+	
+	for (int level = 0; level < LEVELS; ++level) {
+		int      shift = LEVEL_BITS * level;
+		uint64_t base  = current >> shift;
+		
+		for (int index = 0; index < SLOTS; ++index) {
+			if (!slots[level][index])
+				continue;
+			
+			// Amount of slot steps till this slot is processed
+			uint64_t steps = (index - base) & (SLOTS - 1);
+			if (!steps)
+				steps = SLOTS;
+			
+			int64_t ticks = (int64_t) (((base + steps) << shift) - current);
+			if (timeout < 0 || ticks < timeout)
+				timeout = ticks;
+		}
+	}
+	
+	return timeout;
+};
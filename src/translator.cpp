@@ -68,6 +68,7 @@ const int BREAK_PLACEMENT_LOOP     =  2; // Loops: while, for
 const int BREAK_PLACEMENT_SWCASE   =  3; // Switch/case
 const int BREAK_PLACEMENT_FUNCTION =  4; // Function return statements
 const int BREAK_PLACEMENT_BLOCK    =  5; // Indicate that current step is inside of the block to properly clear scopes
+const int BREAK_PLACEMENT_MONITOR  =  6; // Synchronized block, break & continue have to release it's monitor
 
 #define VISIT(x) visit (bytemap, lineno_table, x)
 
@@ -79,6 +80,9 @@ struct address_template {
 	vector<int>* jmp_1 = nullptr;
 	vector<int>* jmp_2 = nullptr;
 	
+	// Set by yield in function body
+	bool generator     = 0;
+	
 	address_template() {};
 	address_template(int type) : placement_type(type) {};
 };
@@ -1299,12 +1303,16 @@ void visit(vector<unsigned char>& bytemap, vector<int>& lineno_table, ASTNode* n
 			if (at.placement_type == BREAK_PLACEMENT_NONE) 
 				push_raise(bytemap, L"break outside of the loop or case");
 			else {
-				// Clear all block's scopes
+				// Leave all synchronized blocks & clear all block's scopes
 				int num_blocks = 0;
 				for (int i = placement_address.size() - 1; i >= 0; --i)
 					if (placement_address[i].placement_type == BREAK_PLACEMENT_BLOCK)
 						++num_blocks;
-					else
+					else if (placement_address[i].placement_type == BREAK_PLACEMENT_MONITOR) {
+						// Scopes of synchronized body are restored with it's frame
+						push_byte(bytemap, ck_bytecodes::VSTATE_POP_MONITOR);
+						num_blocks = 0;
+					} else
 						break;
 				
 				if (num_blocks) 
@@ -1333,12 +1341,16 @@ void visit(vector<unsigned char>& bytemap, vector<int>& lineno_table, ASTNode* n
 			if (at.placement_type == BREAK_PLACEMENT_NONE) 
 				push_raise(bytemap, L"continue outside of the loop or case");
 			else {
-				// Clear all block's scopes
+				// Leave all synchronized blocks & clear all block's scopes
 				int num_blocks = 0;
 				for (int i = placement_address.size() - 1; i >= 0; --i)
 					if (placement_address[i].placement_type == BREAK_PLACEMENT_BLOCK)
 						++num_blocks;
-					else
+					else if (placement_address[i].placement_type == BREAK_PLACEMENT_MONITOR) {
+						// Scopes of synchronized body are restored with it's frame
+						push_byte(bytemap, ck_bytecodes::VSTATE_POP_MONITOR);
+						num_blocks = 0;
+					} else
 						break;
 				
 				if (num_blocks) 
@@ -1449,12 +1461,14 @@ void visit(vector<unsigned char>& bytemap, vector<int>& lineno_table, ASTNode* n
 			}
 			
 			// BYTECODE:
-			// PUSH_CONST_FUNCTION
+			// PUSH_CONST_FUNCTION / PUSH_CONST_GENERATOR
 			// [argc]
 			// [arg names]
 			// [size of block]
 			// [block]
 			
+			// Replaced by PUSH_CONST_GENERATOR if body contains yield
+			int start_of_function = absolute_address(bytemap);
 			push_byte(bytemap, ck_bytecodes::PUSH_CONST_FUNCTION);
 			push(bytemap, sizeof(int), &argc);
 			
@@ -1487,6 +1501,9 @@ void visit(vector<unsigned char>& bytemap, vector<int>& lineno_table, ASTNode* n
 			// push_byte(bytemap, ck_bytecodes::PUSH_CONST_UNDEFINED);
 			// push_byte(bytemap, ck_bytecodes::RETURN_VALUE);
 			
+			if (placement_address.back().generator)
+				bytemap[start_of_function] = ck_bytecodes::PUSH_CONST_GENERATOR;
+			
 			pop_address(bytemap, 0, 0);
 			
 			jump_address_offset += function;
@@ -2007,6 +2024,59 @@ void visit(vector<unsigned char>& bytemap, vector<int>& lineno_table, ASTNode* n
 				wchar_t c = s[i];
 				push(bytemap, sizeof(wchar_t), &c);
 			}
+			
+			break;
+		}
+		
+		case YIELD: {
+			// PUSH value
+			// YIELD
+			
+			address_template& at = lookup_address(BREAK_PLACEMENT_FUNCTION);
+			if (at.placement_type == BREAK_PLACEMENT_NONE) 
+				push_raise(bytemap, L"yield outside of the function");
+			else {
+				// Containing function becomes generator
+				at.generator = 1;
+				
+				// Monitor can not be held by suspended generator
+				bool in_monitor = 0;
+				for (int i = placement_address.size() - 1; i >= 0 && placement_address[i].placement_type != BREAK_PLACEMENT_FUNCTION; --i)
+					if (placement_address[i].placement_type == BREAK_PLACEMENT_MONITOR)
+						in_monitor = 1;
+				
+				if (in_monitor)
+					push_raise(bytemap, L"yield inside of synchronized block");
+				else if (n->left != nullptr)
+					VISIT(n->left);
+				else
+					push_byte(bytemap, ck_bytecodes::PUSH_CONST_UNDEFINED);
+				
+				// Resumed generator pushes value passed to next()
+				if (!in_monitor)
+					push_byte(bytemap, ck_bytecodes::YIELD);
+			}
+			
+			break;
+		}
+		
+		case SYNCHRONIZED: {
+			// <object>
+			// VSTATE_PUSH_MONITOR
+			//  ...
+			// VSTATE_POP_MONITOR
+			
+			VISIT(n->left);
+			
+			push_byte(bytemap, ck_bytecodes::VSTATE_PUSH_MONITOR);
+			push_address(BREAK_PLACEMENT_MONITOR, 0, nullptr, nullptr);
+			
+			VISIT(n->left->next);
+			
+			pop_address();
+			push_byte(bytemap, ck_bytecodes::VSTATE_POP_MONITOR);
+			
+			break;
 		}
 	}
 };
@@ -2034,11 +2104,11 @@ void ck_translator::translate(vector<unsigned char>& bytemap, vector<int>& linen
 	lineno_table.push_back(last_lineno_addr);
 };
 
-void ck_translator::translate_function(ck_bytecode& bytecode, ASTNode* n) {
-	translate_function(bytecode.bytemap, bytecode.lineno_table, n);
+bool ck_translator::translate_function(ck_bytecode& bytecode, ASTNode* n) {
+	return translate_function(bytecode.bytemap, bytecode.lineno_table, n);
 };
 
-void ck_translator::translate_function(vector<unsigned char>& bytemap, vector<int>& lineno_table, ASTNode* n) {
+bool ck_translator::translate_function(vector<unsigned char>& bytemap, vector<int>& lineno_table, ASTNode* n) {
 	// lineno_table - Table of Line Numbers
 	// Provides range of commands mapped to a single line number
 	// [lineno, start_cmd]
@@ -2046,17 +2116,20 @@ void ck_translator::translate_function(vector<unsigned char>& bytemap, vector<in
 	// bytemap - the resulting bytemap
 	
 	if (!(n && n->type != TERR))
-		return;
+		return 0;
 	
 	// Translate bytecode inside "fake" function body
 	push_address(BREAK_PLACEMENT_FUNCTION, 0, nullptr, nullptr);
 	visit(bytemap, lineno_table, n);
+	bool generator = placement_address.back().generator;
 	pop_address(bytemap, 0, 0);
 	
 	last_lineno = -1;
 	lineno_table.push_back(last_lineno);
 	last_lineno_addr = bytemap.size();
 	lineno_table.push_back(last_lineno_addr);
+	
+	return generator;
 };
 
 bool read(vector<unsigned char>& bytemap, int& index, int size, void* p) {
@@ -2410,10 +2483,16 @@ void ck_translator::print(vector<unsigned char>& bytemap, int off, int offset, i
 				break;
 			}
 			
-			case ck_bytecodes::PUSH_CONST_FUNCTION: {
+			case ck_bytecodes::YIELD: {
+				wcout << "> YIELD" << endl;
+				break;
+			}
+			
+			case ck_bytecodes::PUSH_CONST_FUNCTION: 
+			case ck_bytecodes::PUSH_CONST_GENERATOR: {
 				int argc; 
 				read(bytemap, k, sizeof(int), &argc);
-				wcout << "> PUSH_CONST_FUNCTION (" << argc << ") (";
+				wcout << (bytemap[k - sizeof(int) - 1] == ck_bytecodes::PUSH_CONST_GENERATOR ? "> PUSH_CONST_GENERATOR (" : "> PUSH_CONST_FUNCTION (") << argc << ") (";
 				
 				for (int i = 0; i < argc; ++i) {
 					int ssize = 0;
@@ -2443,6 +2522,16 @@ void ck_translator::print(vector<unsigned char>& bytemap, int off, int offset, i
 				wcout << "> VSTATE_POP_TRY" << endl;
 				break;
 			}
+			
+			case ck_bytecodes::VSTATE_PUSH_MONITOR: {
+				wcout << "> VSTATE_PUSH_MONITOR" << endl;
+				break;
+			}
+			
+			case ck_bytecodes::VSTATE_POP_MONITOR: {
+				wcout << "> VSTATE_POP_MONITOR" << endl;
+				break;
+			}
 
 			case ck_bytecodes::VSTATE_PUSH_TRY: {
 				unsigned char type;
@@ -13,6 +13,9 @@
 #endif
 
 #include <typeinfo>
+#include <mutex>
+#include <thread>
+#include <chrono>
 
 #include "GC.h"
 #include "vscope.h"
@@ -32,7 +35,7 @@ bool     vobject::contains(vscope* scope, const std::wstring& name)
 bool     vobject::remove  (vscope* scope, const std::wstring& name)               { return 0; };
 vobject* vobject::call    (vscope* scope, const std::vector<vobject*>& args)      { return nullptr; };
 
-void vobject::gc_mark()     { ck_core::gc_object::gc_reachable = 1; };
+void vobject::gc_trace(ck_core::gc_visitor& visitor) {};
 void vobject::gc_finalize() {};
 
 // Must return integer representation of an object
@@ -44,3 +47,88 @@ int64_t vobject::int_value() {
 std::wstring vobject::string_value() { 
 	return std::wstring(L"[vobject ") + std::to_wstring((intptr_t) this) + std::wstring(L"]"); 
 };
+
+
+// V S O B J E C T
+
+#ifndef CK_SINGLETHREAD
+
+thread_local uint64_t vsobject::lock_token = 0;
+
+// Source of thread tokens, 0 is reserved for unlocked state
+static std::atomic<uint64_t> lock_token_counter(1);
+
+vsobject::~vsobject() {
+	uint64_t word = lock_word.load(std::memory_order_relaxed);
+	if (word & LOCK_INFLATED)
+		delete (std::recursive_mutex*) (word & ~LOCK_INFLATED);
+};
+
+uint64_t vsobject::lock_owner() {
+	if (lock_token == 0)
+		lock_token = lock_token_counter++;
+	
+	return lock_token << LOCK_OWNER_SHIFT;
+};
+
+void vsobject::inflate(uint64_t word) {
+	std::recursive_mutex* monitor = new std::recursive_mutex();
+	
+	// Transfer recursion depth of thin lock to the monitor
+	for (uint64_t count = (word & LOCK_COUNT_MASK) >> 1; count; --count)
+		monitor->lock();
+	
+	// Only owner changes owned word, waiters can only CAS it from 0
+	lock_word.store((uint64_t) monitor | LOCK_INFLATED, std::memory_order_release);
+};
+
+void vsobject::lock_slow() {
+	uint64_t owner = lock_owner();
+	
+	uint64_t word = lock_word.load(std::memory_order_acquire);
+	
+	// Recursive lock
+	if (!(word & LOCK_INFLATED) && (word & ~LOCK_COUNT_MASK) == owner) {
+		if ((word & LOCK_COUNT_MASK) == LOCK_COUNT_MASK) {
+			// Recursion depth overflow
+			inflate(word);
+			((std::recursive_mutex*) (lock_word.load(std::memory_order_relaxed) & ~LOCK_INFLATED))->lock();
+		} else
+			lock_word.store(word + LOCK_COUNT_ONE, std::memory_order_relaxed);
+		return;
+	}
+	
+	// Wait till thin lock is released or inflated
+	for (int spin = 0;; ++spin) {
+		if (word & LOCK_INFLATED) {
+			((std::recursive_mutex*) (word & ~LOCK_INFLATED))->lock();
+			return;
+		}
+		
+		if (word == 0 && lock_word.compare_exchange_weak(word, owner | LOCK_COUNT_ONE, std::memory_order_acquire, std::memory_order_acquire)) {
+			// Object is contended, let next waiters sleep on monitor
+			inflate(owner | LOCK_COUNT_ONE);
+			return;
+		}
+		
+		if (spin < 64)
+			;
+		else if (spin < 1024)
+			std::this_thread::yield();
+		else
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+		
+		word = lock_word.load(std::memory_order_acquire);
+	}
+};
+
+void vsobject::unlock_slow() {
+	uint64_t word = lock_word.load(std::memory_order_relaxed);
+	
+	if (word & LOCK_INFLATED)
+		((std::recursive_mutex*) (word & ~LOCK_INFLATED))->unlock();
+	else if (word & LOCK_COUNT_MASK)
+		lock_word.store(word - LOCK_COUNT_ONE, std::memory_order_release);
+};
+
+#endif
@@ -406,18 +406,11 @@ void iscope::unroot() {
 	GIL::gc_instance()->deattach_root(this);
 };
 
-void iscope::gc_mark() {
-	if (gc_reachable)
-		return;
-	
-	gc_reach();
-	
+void iscope::gc_trace(gc_visitor& visitor) {
 	for (const auto& any : objects) 
-		if (any.second && !any.second->gc_reachable)
-			any.second->gc_mark();
+		visitor.visit(any.second);
 	
-	if (parent != nullptr)
-		parent->gc_mark();
+	visitor.visit(parent);
 };
 
 void iscope::gc_finalize() {};
@@ -592,17 +585,10 @@ void xscope::unroot() {
 	GIL::gc_instance()->deattach_root(this);
 };
 
-void xscope::gc_mark() {
-	if (gc_reachable)
-		return;
-	
-	gc_reach();
-	
-	if (proxy && !proxy->gc_reachable)
-		proxy->gc_mark();
-	
-	if (parent != nullptr)
-		parent->gc_mark();
+void xscope::gc_trace(gc_visitor& visitor) {
+	visitor.visit(proxy);
+	visitor.visit(__this);
+	visitor.visit(parent);
 };
 
 void xscope::gc_finalize() {};